@@ -0,0 +1,246 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/alpha_blender.cc
+ *  @brief AlphaBlender class.
+ */
+
+#include "alpha_blender.h"
+#include "dcpomatic_assert.h"
+
+#ifdef DCPOMATIC_X86
+#include <emmintrin.h>
+#endif
+
+/** @return The fastest kernel that this CPU can use */
+AlphaBlender::Kernel
+AlphaBlender::best_kernel ()
+{
+	return SIMDKernels::best_kernel (KERNEL_SSE2);
+}
+
+/** Blend a row of overlay pixels onto a row of another image.
+ *  @param target First pixel to blend onto.
+ *  @param layout Layout of the target's pixels.
+ *  @param overlay First overlay pixel, 4 bytes per pixel with alpha last.
+ *  @param overlay_bgra true if the overlay is BGRA, false if it is RGBA.
+ *  @param width Number of pixels.
+ *  @param kernel Kernel to use, which must be supported().
+ */
+void
+AlphaBlender::blend (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width, Kernel kernel)
+{
+	DCPOMATIC_ASSERT (supported (kernel));
+
+	switch (kernel) {
+	case KERNEL_SCALAR:
+		blend_scalar (target, layout, overlay, overlay_bgra, width);
+		break;
+	case KERNEL_SSE2:
+	case KERNEL_AVX2:
+		blend_sse2 (target, layout, overlay, overlay_bgra, width);
+		break;
+	}
+}
+
+/** @param overlay First overlay pixel, 4 bytes per pixel with alpha last.
+ *  @param width Number of pixels.
+ *  @param kernel Kernel to use, which must be supported().
+ *  @return Number of fully-transparent pixels at the start of the overlay.
+ */
+int
+AlphaBlender::transparent (uint8_t const * overlay, int width, Kernel kernel)
+{
+	DCPOMATIC_ASSERT (supported (kernel));
+
+	int n = 0;
+	if (kernel >= KERNEL_SSE2) {
+		n = transparent_sse2 (overlay, width);
+	}
+
+	while (n < width && overlay[n * 4 + 3] == 0) {
+		++n;
+	}
+
+	return n;
+}
+
+void
+AlphaBlender::blend_scalar (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width)
+{
+	int const red = overlay_bgra ? 2 : 0;
+	int const blue = overlay_bgra ? 0 : 2;
+
+	for (int i = 0; i < width; ++i) {
+		uint8_t const * op = overlay + i * 4;
+		if (op[3] == 0) {
+			/* This would leave the target as it is */
+			continue;
+		}
+
+		uint8_t* tp = target + i * layout.bpp;
+		float const alpha = float (op[3]) / 255;
+		tp[layout.red] = op[red] * alpha + tp[layout.red] * (1 - alpha);
+		tp[layout.green] = op[1] * alpha + tp[layout.green] * (1 - alpha);
+		tp[layout.blue] = op[blue] * alpha + tp[layout.blue] * (1 - alpha);
+		if (layout.alpha >= 0) {
+			tp[layout.alpha] = op[3] * alpha + tp[layout.alpha] * (1 - alpha);
+		}
+	}
+}
+
+/* The SSE2 versions below do the same single-precision sums as blend_scalar() and truncate
+   the results to integers in the same way (see SIMDKernels).
+*/
+
+#ifdef DCPOMATIC_X86
+
+/** @param o Overlay component values as 32-bit integers.
+ *  @param t Target component values as 32-bit integers.
+ *  @return Blended component values.
+ */
+__attribute__((target("sse2")))
+static inline __m128i
+blend_components (__m128i o, __m128i t, __m128 alpha)
+{
+	__m128 const sum = _mm_add_ps (
+		_mm_mul_ps (_mm_cvtepi32_ps (o), alpha),
+		_mm_mul_ps (_mm_cvtepi32_ps (t), _mm_sub_ps (_mm_set1_ps (1), alpha))
+		);
+	return _mm_cvttps_epi32 (sum);
+}
+
+/** Blend one component of 4 consecutive target pixels.
+ *  @param t First pixel's component.
+ *  @param bpp Bytes per target pixel.
+ *  @param o Overlay values for the component as 32-bit integers.
+ */
+__attribute__((target("sse2")))
+static inline void
+blend_component (uint8_t* t, int bpp, __m128i o, __m128 alpha)
+{
+	union {
+		__m128i v;
+		int32_t i[4];
+	} r;
+
+	r.v = blend_components (o, _mm_setr_epi32 (t[0], t[bpp], t[bpp * 2], t[bpp * 3]), alpha);
+	t[0] = r.i[0];
+	t[bpp] = r.i[1];
+	t[bpp * 2] = r.i[2];
+	t[bpp * 3] = r.i[3];
+}
+
+__attribute__((target("sse2")))
+int
+AlphaBlender::transparent_sse2 (uint8_t const * overlay, int width)
+{
+	__m128i const alpha_mask = _mm_set1_epi32 (static_cast<int> (0xff000000));
+	__m128i const zero = _mm_setzero_si128 ();
+
+	int n = 0;
+	for (; n + 4 <= width; n += 4) {
+		__m128i const o = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (overlay + n * 4));
+		if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_and_si128 (o, alpha_mask), zero)) != 0xffff) {
+			break;
+		}
+	}
+
+	return n;
+}
+
+__attribute__((target("sse2")))
+void
+AlphaBlender::blend_sse2 (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width)
+{
+	int const red = overlay_bgra ? 2 : 0;
+	int const blue = overlay_bgra ? 0 : 2;
+
+	__m128i const alpha_mask = _mm_set1_epi32 (static_cast<int> (0xff000000));
+	__m128i const byte_mask = _mm_set1_epi32 (0xff);
+	__m128i const zero = _mm_setzero_si128 ();
+	__m128 const max_alpha = _mm_set1_ps (255);
+
+	/* 4-byte targets with alpha last (BGRA and RGBA) can be blended a register at a time */
+	bool const whole = layout.bpp == 4 && layout.green == 1 && layout.alpha == 3 && (layout.red + layout.blue) == 2 && (layout.red * layout.blue) == 0;
+	bool const swap = layout.red != red;
+
+	int i = 0;
+	for (; i + 4 <= width; i += 4) {
+		__m128i const o = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (overlay + i * 4));
+		if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_and_si128 (o, alpha_mask), zero)) == 0xffff) {
+			/* All 4 pixels are transparent */
+			continue;
+		}
+
+		uint8_t* tp = target + i * layout.bpp;
+
+		if (whole) {
+			__m128i const t = _mm_loadu_si128 (reinterpret_cast<__m128i const *> (tp));
+			__m128i o16[2] = { _mm_unpacklo_epi8 (o, zero), _mm_unpackhi_epi8 (o, zero) };
+			__m128i const t16[2] = { _mm_unpacklo_epi8 (t, zero), _mm_unpackhi_epi8 (t, zero) };
+			__m128i r16[2];
+			for (int j = 0; j < 2; ++j) {
+				if (swap) {
+					o16[j] = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (o16[j], _MM_SHUFFLE (3, 0, 1, 2)), _MM_SHUFFLE (3, 0, 1, 2));
+				}
+				/* One pixel in each of these */
+				__m128i const o_lo = _mm_unpacklo_epi16 (o16[j], zero);
+				__m128i const o_hi = _mm_unpackhi_epi16 (o16[j], zero);
+				__m128 const o_lo_f = _mm_cvtepi32_ps (o_lo);
+				__m128 const o_hi_f = _mm_cvtepi32_ps (o_hi);
+				__m128 const alpha_lo = _mm_div_ps (_mm_shuffle_ps (o_lo_f, o_lo_f, _MM_SHUFFLE (3, 3, 3, 3)), max_alpha);
+				__m128 const alpha_hi = _mm_div_ps (_mm_shuffle_ps (o_hi_f, o_hi_f, _MM_SHUFFLE (3, 3, 3, 3)), max_alpha);
+				r16[j] = _mm_packs_epi32 (
+					blend_components (o_lo, _mm_unpacklo_epi16 (t16[j], zero), alpha_lo),
+					blend_components (o_hi, _mm_unpackhi_epi16 (t16[j], zero), alpha_hi)
+					);
+			}
+			_mm_storeu_si128 (reinterpret_cast<__m128i*> (tp), _mm_packus_epi16 (r16[0], r16[1]));
+		} else {
+			/* Blend each component of the 4 pixels in turn */
+			__m128 const alpha = _mm_div_ps (_mm_cvtepi32_ps (_mm_srli_epi32 (o, 24)), max_alpha);
+			blend_component (tp + layout.red, layout.bpp, _mm_and_si128 (_mm_srli_epi32 (o, red * 8), byte_mask), alpha);
+			blend_component (tp + layout.green, layout.bpp, _mm_and_si128 (_mm_srli_epi32 (o, 8), byte_mask), alpha);
+			blend_component (tp + layout.blue, layout.bpp, _mm_and_si128 (_mm_srli_epi32 (o, blue * 8), byte_mask), alpha);
+			if (layout.alpha >= 0) {
+				blend_component (tp + layout.alpha, layout.bpp, _mm_srli_epi32 (o, 24), alpha);
+			}
+		}
+	}
+
+	blend_scalar (target + i * layout.bpp, layout, overlay + i * 4, overlay_bgra, width - i);
+}
+
+#else
+
+int
+AlphaBlender::transparent_sse2 (uint8_t const *, int)
+{
+	return 0;
+}
+
+void
+AlphaBlender::blend_sse2 (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width)
+{
+	blend_scalar (target, layout, overlay, overlay_bgra, width);
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_ALPHA_BLENDER_H
+#define DCPOMATIC_ALPHA_BLENDER_H
+
+/** @file  src/lib/alpha_blender.h
+ *  @brief AlphaBlender class.
+ */
+
+#include "simd_kernels.h"
+#include <stdint.h>
+
+/** @class AlphaBlender
+ *  @brief Blending of rows of RGBA or BGRA overlay pixels onto rows of other images, for Image::alpha_blend.
+ *
+ *  Runs of fully-transparent overlay pixels are skipped, and the rest are blended using SSE2
+ *  where the CPU has it.
+ */
+class AlphaBlender : public SIMDKernels
+{
+public:
+	/** Description of where the 8-bit components of a pixel are in an image that is being blended onto */
+	struct Layout
+	{
+		Layout (int bpp_, int red_, int green_, int blue_, int alpha_)
+			: bpp (bpp_)
+			, red (red_)
+			, green (green_)
+			, blue (blue_)
+			, alpha (alpha_)
+		{}
+
+		int bpp;   ///< bytes per pixel
+		int red;   ///< offset of the red byte within the pixel
+		int green; ///< offset of the green byte within the pixel
+		int blue;  ///< offset of the blue byte within the pixel
+		int alpha; ///< offset of the alpha byte within the pixel, or -1 if there is no alpha
+	};
+
+	static void blend (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width, Kernel kernel = best_kernel());
+	static int transparent (uint8_t const * overlay, int width, Kernel kernel = best_kernel());
+
+	static Kernel best_kernel ();
+
+private:
+	static void blend_scalar (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width);
+	static void blend_sse2 (uint8_t* target, Layout layout, uint8_t const * overlay, bool overlay_bgra, int width);
+	static int transparent_sse2 (uint8_t const * overlay, int width);
+};
+
+#endif
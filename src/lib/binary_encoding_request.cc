@@ -0,0 +1,249 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/binary_encoding_request.cc
+ *  @brief BinaryEncodingRequest class.
+ */
+
+#include "binary_encoding_request.h"
+#include "dcpomatic_assert.h"
+#include "exceptions.h"
+#include "compose.hpp"
+#include <cstring>
+
+uint32_t const BinaryEncodingRequest::flag = 0x80000000;
+uint32_t const BinaryEncodingRequest::compressed_flag = 0x40000000;
+uint32_t const BinaryEncodingRequest::layout_version = 1;
+int const BinaryEncodingRequest::length;
+
+BinaryEncodingRequest::BinaryEncodingRequest ()
+	: index (0)
+	, frames_per_second (0)
+	, j2k_bandwidth (0)
+	, resolution (0)
+	, crop_left (0)
+	, crop_right (0)
+	, crop_top (0)
+	, crop_bottom (0)
+	, has_fade (false)
+	, fade (0)
+	, inter_width (0)
+	, inter_height (0)
+	, out_width (0)
+	, out_height (0)
+	, eyes (0)
+	, part (0)
+	, has_colour_conversion (false)
+	, input_transfer_function (TRANSFER_FUNCTION_NONE)
+	, yuv_to_rgb (0)
+	, has_adjusted_white (false)
+	, has_output_gamma (false)
+	, output_gamma (0)
+	, image_width (0)
+	, image_height (0)
+	, image_pixel_format (0)
+	, has_text (false)
+	, text_x (0)
+	, text_y (0)
+	, text_width (0)
+	, text_height (0)
+	, compressed (false)
+{
+	for (int i = 0; i < 4; ++i) {
+		input_transfer_parameters[i] = 0;
+	}
+	for (int i = 0; i < 8; ++i) {
+		chromaticities[i] = 0;
+	}
+	adjusted_white[0] = adjusted_white[1] = 0;
+}
+
+static void
+put_uint32 (uint8_t*& p, uint32_t v)
+{
+	*p++ = (v >> 24) & 0xff;
+	*p++ = (v >> 16) & 0xff;
+	*p++ = (v >> 8) & 0xff;
+	*p++ = v & 0xff;
+}
+
+static void
+put_int32 (uint8_t*& p, int32_t v)
+{
+	put_uint32 (p, static_cast<uint32_t> (v));
+}
+
+static void
+put_bool (uint8_t*& p, bool v)
+{
+	*p++ = v ? 1 : 0;
+}
+
+static void
+put_double (uint8_t*& p, double v)
+{
+	uint64_t bits;
+	memcpy (&bits, &v, sizeof (bits));
+	put_uint32 (p, bits >> 32);
+	put_uint32 (p, bits & 0xffffffff);
+}
+
+static uint32_t
+get_uint32 (uint8_t const *& p)
+{
+	uint32_t const v = (uint32_t (p[0]) << 24) | (uint32_t (p[1]) << 16) | (uint32_t (p[2]) << 8) | uint32_t (p[3]);
+	p += 4;
+	return v;
+}
+
+static int32_t
+get_int32 (uint8_t const *& p)
+{
+	return static_cast<int32_t> (get_uint32 (p));
+}
+
+static bool
+get_bool (uint8_t const *& p)
+{
+	return *p++ != 0;
+}
+
+static double
+get_double (uint8_t const *& p)
+{
+	uint64_t bits = uint64_t (get_uint32 (p)) << 32;
+	bits |= get_uint32 (p);
+	double v;
+	memcpy (&v, &bits, sizeof (v));
+	return v;
+}
+
+/** @param buffer Buffer of at least `length' bytes */
+void
+BinaryEncodingRequest::write (uint8_t* buffer) const
+{
+	uint8_t* p = buffer;
+
+	put_uint32 (p, layout_version);
+
+	put_int32 (p, index);
+	put_int32 (p, frames_per_second);
+	put_int32 (p, j2k_bandwidth);
+	put_int32 (p, resolution);
+
+	put_int32 (p, crop_left);
+	put_int32 (p, crop_right);
+	put_int32 (p, crop_top);
+	put_int32 (p, crop_bottom);
+	put_bool (p, has_fade);
+	put_double (p, fade);
+	put_int32 (p, inter_width);
+	put_int32 (p, inter_height);
+	put_int32 (p, out_width);
+	put_int32 (p, out_height);
+	put_int32 (p, eyes);
+	put_int32 (p, part);
+
+	put_bool (p, has_colour_conversion);
+	put_int32 (p, input_transfer_function);
+	for (int i = 0; i < 4; ++i) {
+		put_double (p, input_transfer_parameters[i]);
+	}
+	put_int32 (p, yuv_to_rgb);
+	for (int i = 0; i < 8; ++i) {
+		put_double (p, chromaticities[i]);
+	}
+	put_bool (p, has_adjusted_white);
+	put_double (p, adjusted_white[0]);
+	put_double (p, adjusted_white[1]);
+	put_bool (p, has_output_gamma);
+	put_double (p, output_gamma);
+
+	put_int32 (p, image_width);
+	put_int32 (p, image_height);
+	put_int32 (p, image_pixel_format);
+
+	put_bool (p, has_text);
+	put_int32 (p, text_x);
+	put_int32 (p, text_y);
+	put_int32 (p, text_width);
+	put_int32 (p, text_height);
+
+	DCPOMATIC_ASSERT ((p - buffer) == length);
+}
+
+/** Fill in this request from a buffer written by write(); nothing is allocated here.
+ *  @param buffer Buffer of `length' bytes.
+ */
+void
+BinaryEncodingRequest::read (uint8_t const * buffer)
+{
+	uint8_t const * p = buffer;
+
+	uint32_t const layout = get_uint32 (p);
+	if (layout != layout_version) {
+		throw NetworkError (String::compose ("Unknown binary encoding request layout %1", layout));
+	}
+
+	index = get_int32 (p);
+	frames_per_second = get_int32 (p);
+	j2k_bandwidth = get_int32 (p);
+	resolution = get_int32 (p);
+
+	crop_left = get_int32 (p);
+	crop_right = get_int32 (p);
+	crop_top = get_int32 (p);
+	crop_bottom = get_int32 (p);
+	has_fade = get_bool (p);
+	fade = get_double (p);
+	inter_width = get_int32 (p);
+	inter_height = get_int32 (p);
+	out_width = get_int32 (p);
+	out_height = get_int32 (p);
+	eyes = get_int32 (p);
+	part = get_int32 (p);
+
+	has_colour_conversion = get_bool (p);
+	input_transfer_function = get_int32 (p);
+	for (int i = 0; i < 4; ++i) {
+		input_transfer_parameters[i] = get_double (p);
+	}
+	yuv_to_rgb = get_int32 (p);
+	for (int i = 0; i < 8; ++i) {
+		chromaticities[i] = get_double (p);
+	}
+	has_adjusted_white = get_bool (p);
+	adjusted_white[0] = get_double (p);
+	adjusted_white[1] = get_double (p);
+	has_output_gamma = get_bool (p);
+	output_gamma = get_double (p);
+
+	image_width = get_int32 (p);
+	image_height = get_int32 (p);
+	image_pixel_format = get_int32 (p);
+
+	has_text = get_bool (p);
+	text_x = get_int32 (p);
+	text_y = get_int32 (p);
+	text_width = get_int32 (p);
+	text_height = get_int32 (p);
+
+	DCPOMATIC_ASSERT ((p - buffer) == length);
+}
@@ -0,0 +1,117 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_BINARY_ENCODING_REQUEST_H
+#define DCPOMATIC_BINARY_ENCODING_REQUEST_H
+
+/** @file  src/lib/binary_encoding_request.h
+ *  @brief BinaryEncodingRequest class.
+ */
+
+#include <stdint.h>
+
+/** @class BinaryEncodingRequest
+ *  @brief The description of a frame that is sent to an encode server, in a
+ *  fixed binary layout.
+ *
+ *  This is used instead of an XML EncodingRequest when the server's link version is
+ *  at least SERVER_LINK_VERSION_BINARY_REQUEST and the frame's image can be described
+ *  this way (at the moment that means it comes from a RawImageProxy).  On the wire
+ *  it is a uint32 of (length | flag) followed by length bytes; an XML request's length
+ *  can never have `flag' set.  If `compressed_flag' is also set the images which follow
+ *  the request are sent with Image::write_compressed_to_socket().  Everything is big-endian, and doubles are sent as the
+ *  bits of their IEEE 754 representation.
+ */
+class BinaryEncodingRequest
+{
+public:
+	BinaryEncodingRequest ();
+
+	void write (uint8_t* buffer) const;
+	void read (uint8_t const * buffer);
+
+	/** Set in the length word of a request that is in this format */
+	static uint32_t const flag;
+	/** Set in the length word of a request whose images are compressed */
+	static uint32_t const compressed_flag;
+	/** Version of the layout, which is the first thing in the buffer */
+	static uint32_t const layout_version;
+	/** Length of the buffer */
+	static int const length = 229;
+
+	enum TransferFunction {
+		TRANSFER_FUNCTION_NONE,
+		TRANSFER_FUNCTION_GAMMA,
+		TRANSFER_FUNCTION_MODIFIED_GAMMA,
+		TRANSFER_FUNCTION_S_GAMUT3
+	};
+
+	/* DCPVideo */
+	int32_t index;
+	int32_t frames_per_second;
+	int32_t j2k_bandwidth;
+	int32_t resolution;
+
+	/* PlayerVideo */
+	int32_t crop_left;
+	int32_t crop_right;
+	int32_t crop_top;
+	int32_t crop_bottom;
+	bool has_fade;
+	double fade;
+	int32_t inter_width;
+	int32_t inter_height;
+	int32_t out_width;
+	int32_t out_height;
+	int32_t eyes;
+	int32_t part;
+
+	/* ColourConversion */
+	bool has_colour_conversion;
+	int32_t input_transfer_function;
+	/** gamma, or power, threshold, A and B for a modified gamma function */
+	double input_transfer_parameters[4];
+	int32_t yuv_to_rgb;
+	/** x and y of the red, green, blue and white chromaticities */
+	double chromaticities[8];
+	bool has_adjusted_white;
+	double adjusted_white[2];
+	bool has_output_gamma;
+	double output_gamma;
+
+	/* RawImageProxy */
+	int32_t image_width;
+	int32_t image_height;
+	int32_t image_pixel_format;
+
+	/* Subtitle image, which is sent as BGRA after the source image */
+	bool has_text;
+	int32_t text_x;
+	int32_t text_y;
+	int32_t text_width;
+	int32_t text_height;
+
+	/** true if the images are compressed; this is carried in the length word,
+	 *  not in the buffer.
+	 */
+	bool compressed;
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "colour_conversion.h"
 #include "util.h"
 #include "digester.h"
+#include "binary_encoding_request.h"
 #include <dcp/raw_convert.h>
 #include <dcp/chromaticity.h>
 #include <dcp/gamma_transfer_function.h>
@@ -182,6 +183,99 @@ ColourConversion::as_xml (xmlpp::Node* node) const
 	}
 }
 
+/** Describe this conversion in a BinaryEncodingRequest */
+void
+ColourConversion::as_binary (BinaryEncodingRequest& request) const
+{
+	request.has_colour_conversion = true;
+
+	if (dynamic_pointer_cast<const dcp::GammaTransferFunction> (_in)) {
+		shared_ptr<const dcp::GammaTransferFunction> tf = dynamic_pointer_cast<const dcp::GammaTransferFunction> (_in);
+		request.input_transfer_function = BinaryEncodingRequest::TRANSFER_FUNCTION_GAMMA;
+		request.input_transfer_parameters[0] = tf->gamma ();
+	} else if (dynamic_pointer_cast<const dcp::ModifiedGammaTransferFunction> (_in)) {
+		shared_ptr<const dcp::ModifiedGammaTransferFunction> tf = dynamic_pointer_cast<const dcp::ModifiedGammaTransferFunction> (_in);
+		request.input_transfer_function = BinaryEncodingRequest::TRANSFER_FUNCTION_MODIFIED_GAMMA;
+		request.input_transfer_parameters[0] = tf->power ();
+		request.input_transfer_parameters[1] = tf->threshold ();
+		request.input_transfer_parameters[2] = tf->A ();
+		request.input_transfer_parameters[3] = tf->B ();
+	} else if (dynamic_pointer_cast<const dcp::SGamut3TransferFunction> (_in)) {
+		request.input_transfer_function = BinaryEncodingRequest::TRANSFER_FUNCTION_S_GAMUT3;
+	} else {
+		request.input_transfer_function = BinaryEncodingRequest::TRANSFER_FUNCTION_NONE;
+	}
+
+	request.yuv_to_rgb = static_cast<int> (_yuv_to_rgb);
+	request.chromaticities[0] = _red.x;
+	request.chromaticities[1] = _red.y;
+	request.chromaticities[2] = _green.x;
+	request.chromaticities[3] = _green.y;
+	request.chromaticities[4] = _blue.x;
+	request.chromaticities[5] = _blue.y;
+	request.chromaticities[6] = _white.x;
+	request.chromaticities[7] = _white.y;
+
+	request.has_adjusted_white = static_cast<bool> (_adjusted_white);
+	if (_adjusted_white) {
+		request.adjusted_white[0] = _adjusted_white.get().x;
+		request.adjusted_white[1] = _adjusted_white.get().y;
+	}
+
+	shared_ptr<const dcp::GammaTransferFunction> gf = dynamic_pointer_cast<const dcp::GammaTransferFunction> (_out);
+	request.has_output_gamma = static_cast<bool> (gf);
+	if (gf) {
+		request.output_gamma = gf->gamma ();
+	}
+}
+
+/** @return Conversion described by a BinaryEncodingRequest, if it has one */
+optional<ColourConversion>
+ColourConversion::from_binary (BinaryEncodingRequest const & request)
+{
+	if (!request.has_colour_conversion) {
+		return optional<ColourConversion> ();
+	}
+
+	ColourConversion c;
+
+	double const * p = request.input_transfer_parameters;
+	switch (request.input_transfer_function) {
+	case BinaryEncodingRequest::TRANSFER_FUNCTION_GAMMA:
+		c._in.reset (new dcp::GammaTransferFunction (p[0]));
+		break;
+	case BinaryEncodingRequest::TRANSFER_FUNCTION_MODIFIED_GAMMA:
+		c._in.reset (new dcp::ModifiedGammaTransferFunction (p[0], p[1], p[2], p[3]));
+		break;
+	case BinaryEncodingRequest::TRANSFER_FUNCTION_S_GAMUT3:
+		c._in.reset (new dcp::SGamut3TransferFunction ());
+		break;
+	default:
+		c._in.reset ();
+		break;
+	}
+
+	c._yuv_to_rgb = static_cast<dcp::YUVToRGB> (request.yuv_to_rgb);
+	c._red = dcp::Chromaticity (request.chromaticities[0], request.chromaticities[1]);
+	c._green = dcp::Chromaticity (request.chromaticities[2], request.chromaticities[3]);
+	c._blue = dcp::Chromaticity (request.chromaticities[4], request.chromaticities[5]);
+	c._white = dcp::Chromaticity (request.chromaticities[6], request.chromaticities[7]);
+
+	if (request.has_adjusted_white) {
+		c._adjusted_white = dcp::Chromaticity (request.adjusted_white[0], request.adjusted_white[1]);
+	} else {
+		c._adjusted_white = optional<dcp::Chromaticity> ();
+	}
+
+	if (request.has_output_gamma) {
+		c._out.reset (new dcp::GammaTransferFunction (request.output_gamma));
+	} else {
+		c._out.reset (new dcp::IdentityTransferFunction ());
+	}
+
+	return c;
+}
+
 optional<size_t>
 ColourConversion::preset () const
 {
@@ -33,6 +33,8 @@ namespace xmlpp {
 	class Node;
 }
 
+class BinaryEncodingRequest;
+
 class ColourConversion : public dcp::ColourConversion
 {
 public:
@@ -42,11 +44,13 @@ public:
 	virtual ~ColourConversion () {}
 
 	virtual void as_xml (xmlpp::Node *) const;
+	void as_binary (BinaryEncodingRequest& request) const;
 	std::string identifier () const;
 
 	boost::optional<size_t> preset () const;
 
 	static boost::optional<ColourConversion> from_xml (cxml::NodePtr, int version);
+	static boost::optional<ColourConversion> from_binary (BinaryEncodingRequest const & request);
 };
 
 class PresetColourConversion
@@ -88,6 +88,7 @@ Config::set_defaults ()
 	_use_any_servers = true;
 	_servers.clear ();
 	_only_servers_encode = false;
+	_compress_frames_for_servers = true;
 	_tms_protocol = FILE_TRANSFER_PROTOCOL_SCP;
 	_tms_ip = "";
 	_tms_path = ".";
@@ -154,6 +155,9 @@ Config::set_defaults ()
 	*/
 	_frames_in_memory_multiplier = 3;
 	_decode_reduction = optional<int>();
+	_j2k_cache_size = 0;
+	_j2k_cache_directory = boost::none;
+	_image_buffer_pool_size = 512;
 	_default_notify = false;
 	for (int i = 0; i < NOTIFICATION_COUNT; ++i) {
 		_notification[i] = false;
@@ -286,6 +290,7 @@ try
 	}
 
 	_only_servers_encode = f.optional_bool_child ("OnlyServersEncode").get_value_or (false);
+	_compress_frames_for_servers = f.optional_bool_child ("CompressFramesForServers").get_value_or (true);
 	_tms_protocol = static_cast<FileTransferProtocol>(f.optional_number_child<int>("TMSProtocol").get_value_or(static_cast<int>(FILE_TRANSFER_PROTOCOL_SCP)));
 	_tms_ip = f.string_child ("TMSIP");
 	_tms_path = f.string_child ("TMSPath");
@@ -535,6 +540,9 @@ try
 	}
 	_frames_in_memory_multiplier = f.optional_number_child<int>("FramesInMemoryMultiplier").get_value_or(3);
 	_decode_reduction = f.optional_number_child<int>("DecodeReduction");
+	_j2k_cache_size = f.optional_number_child<int>("J2KCacheSize").get_value_or(0);
+	_j2k_cache_directory = f.optional_string_child("J2KCacheDirectory");
+	_image_buffer_pool_size = f.optional_number_child<int>("ImageBufferPoolSize").get_value_or(512);
 	_default_notify = f.optional_bool_child("DefaultNotify").get_value_or(false);
 
 	BOOST_FOREACH (cxml::NodePtr i, f.node_children("Notification")) {
@@ -663,6 +671,10 @@ Config::write_config () const
 	   is done by the encoding servers.  0 to set the master to do some encoding as well as coordinating the job.
 	*/
 	root->add_child("OnlyServersEncode")->add_child_text (_only_servers_encode ? "1" : "0");
+	/* [XML] CompressFramesForServers 1 to losslessly compress uncompressed frames before sending them to encoding
+	   servers that can accept them, 0 to send them uncompressed.
+	*/
+	root->add_child("CompressFramesForServers")->add_child_text (_compress_frames_for_servers ? "1" : "0");
 	/* [XML] TMSProtocol Protocol to use to copy files to a TMS; 0 to use SCP, 1 for FTP. */
 	root->add_child("TMSProtocol")->add_child_text (raw_convert<string> (static_cast<int> (_tms_protocol)));
 	/* [XML] TMSIP IP address of TMS. */
@@ -932,6 +944,19 @@ Config::write_config () const
 		root->add_child("DecodeReduction")->add_child_text(raw_convert<string>(_decode_reduction.get()));
 	}
 
+	/* [XML] J2KCacheSize Maximum size in GB of the cache of encoded J2K frames which is used to avoid re-encoding
+	   identical frames in different films and encodes; 0 for no cache.
+	*/
+	root->add_child("J2KCacheSize")->add_child_text(raw_convert<string>(_j2k_cache_size));
+	/* [XML] J2KCacheDirectory Directory to keep the cache of encoded J2K frames in. */
+	if (_j2k_cache_directory) {
+		root->add_child("J2KCacheDirectory")->add_child_text(_j2k_cache_directory->string());
+	}
+	/* [XML] ImageBufferPoolSize Maximum size in MB of the memory from finished-with images which is kept
+	   to be re-used by new ones.
+	*/
+	root->add_child("ImageBufferPoolSize")->add_child_text(raw_convert<string>(_image_buffer_pool_size));
+
 	/* [XML] DefaultNotify 1 to default jobs to notify when complete, otherwise 0. */
 	root->add_child("DefaultNotify")->add_child_text(_default_notify ? "1" : "0");
 
@@ -1287,6 +1312,17 @@ Config::existing_template (string name) const
 	return boost::filesystem::exists (template_path (name));
 }
 
+/** @return Directory for the cache of encoded J2K frames */
+boost::filesystem::path
+Config::j2k_cache_directory () const
+{
+	if (_j2k_cache_directory) {
+		return _j2k_cache_directory.get ();
+	}
+
+	return path ("j2k_cache", false);
+}
+
 boost::filesystem::path
 Config::template_path (string name) const
 {
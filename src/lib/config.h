@@ -117,6 +117,11 @@ public:
 		return _only_servers_encode;
 	}
 
+	/** @return true to losslessly compress raw frames before sending them to servers which can accept them */
+	bool compress_frames_for_servers () const {
+		return _compress_frames_for_servers;
+	}
+
 	FileTransferProtocol tms_protocol () const {
 		return _tms_protocol;
 	}
@@ -426,6 +431,18 @@ public:
 		return _decode_reduction;
 	}
 
+	/** @return maximum size of the cache of encoded J2K frames in GB, or 0 for no cache */
+	int j2k_cache_size () const {
+		return _j2k_cache_size;
+	}
+
+	boost::filesystem::path j2k_cache_directory () const;
+
+	/** @return maximum size in MB of the memory to keep for re-use by new images */
+	int image_buffer_pool_size () const {
+		return _image_buffer_pool_size;
+	}
+
 	bool default_notify () const {
 		return _default_notify;
 	}
@@ -568,6 +585,10 @@ public:
 		maybe_set (_only_servers_encode, o);
 	}
 
+	void set_compress_frames_for_servers (bool c) {
+		maybe_set (_compress_frames_for_servers, c);
+	}
+
 	void set_tms_protocol (FileTransferProtocol p) {
 		maybe_set (_tms_protocol, p);
 	}
@@ -856,6 +877,18 @@ public:
 		maybe_set (_decode_reduction, r);
 	}
 
+	void set_j2k_cache_size (int s) {
+		maybe_set (_j2k_cache_size, s);
+	}
+
+	void set_j2k_cache_directory (boost::filesystem::path d) {
+		maybe_set (_j2k_cache_directory, d);
+	}
+
+	void set_image_buffer_pool_size (int s) {
+		maybe_set (_image_buffer_pool_size, s);
+	}
+
 	void set_default_notify (bool n) {
 		maybe_set (_default_notify, n);
 	}
@@ -1143,6 +1176,7 @@ private:
 	/** J2K encoding servers that should definitely be used */
 	std::vector<std::string> _servers;
 	bool _only_servers_encode;
+	bool _compress_frames_for_servers;
 	FileTransferProtocol _tms_protocol;
 	/** The IP address of a TMS that we can copy DCPs to */
 	std::string _tms_ip;
@@ -1242,6 +1276,10 @@ private:
 	boost::optional<DKDMWriteType> _last_dkdm_write_type;
 	int _frames_in_memory_multiplier;
 	boost::optional<int> _decode_reduction;
+	int _j2k_cache_size;
+	/** directory for the cache of encoded J2K frames, or empty to use the default */
+	boost::optional<boost::filesystem::path> _j2k_cache_directory;
+	int _image_buffer_pool_size;
 	bool _default_notify;
 	bool _notification[NOTIFICATION_COUNT];
 	boost::optional<std::string> _barco_username;
@@ -312,6 +312,16 @@ Content::identifier () const
 	return buffer;
 }
 
+/** @return string which changes when something about this content changes which affects the
+ *  images that its decoder makes, other than the content's files; unlike identifier() this does
+ *  not depend on where the content is in the timeline or how it is trimmed.
+ */
+string
+Content::image_identifier () const
+{
+	return "";
+}
+
 bool
 Content::paths_valid () const
 {
@@ -24,6 +24,7 @@
 #include "video_decoder.h"
 #include "audio_decoder.h"
 #include "j2k_image_proxy.h"
+#include "dcp_read_ahead.h"
 #include "text_decoder.h"
 #include "ffmpeg_image_proxy.h"
 #include "image.h"
@@ -32,9 +33,7 @@
 #include <dcp/cpl.h>
 #include <dcp/reel.h>
 #include <dcp/mono_picture_asset.h>
-#include <dcp/mono_picture_asset_reader.h>
 #include <dcp/stereo_picture_asset.h>
-#include <dcp/stereo_picture_asset_reader.h>
 #include <dcp/reel_picture_asset.h>
 #include <dcp/reel_sound_asset.h>
 #include <dcp/reel_subtitle_asset.h>
@@ -42,13 +41,15 @@
 #include <dcp/mono_picture_frame.h>
 #include <dcp/stereo_picture_frame.h>
 #include <dcp/sound_frame.h>
-#include <dcp/sound_asset_reader.h>
 #include <dcp/subtitle_image.h>
 #include <boost/foreach.hpp>
 #include <iostream>
 
 #include "i18n.h"
 
+/** Number of bytes of picture and sound to read ahead of what is being decoded */
+#define DCP_READ_AHEAD_BYTES (64 * 1024 * 1024)
+
 using std::list;
 using std::cout;
 using boost::shared_ptr;
@@ -99,7 +100,6 @@ DCPDecoder::DCPDecoder (shared_ptr<const Film> film, shared_ptr<const DCPContent
 
 	_reel = _reels.begin ();
 	_offset = 0;
-	get_readers ();
 }
 
 
@@ -123,59 +123,61 @@ DCPDecoder::pass ()
 	*/
 	pass_texts (_next, picture_asset->size());
 
-	if ((_mono_reader || _stereo_reader) && (_decode_referenced || !_dcp_content->reference_video())) {
-		int64_t const entry_point = (*_reel)->main_picture()->entry_point ();
-		if (_mono_reader) {
-			video->emit (
-				film(),
-				shared_ptr<ImageProxy> (
-					new J2KImageProxy (
-						_mono_reader->get_frame (entry_point + frame),
-						picture_asset->size(),
-						AV_PIX_FMT_XYZ12LE,
-						_forced_reduction
-						)
-					),
-				_offset + frame
-				);
-		} else {
-			video->emit (
-				film(),
-				shared_ptr<ImageProxy> (
-					new J2KImageProxy (
-						_stereo_reader->get_frame (entry_point + frame),
-						picture_asset->size(),
-						dcp::EYE_LEFT,
-						AV_PIX_FMT_XYZ12LE,
-						_forced_reduction
-						)
-					),
-				_offset + frame
-				);
+	shared_ptr<DCPReadAhead> ra = read_ahead ();
+	DCPReadAhead::Frame f;
+	if (ra) {
+		f = ra->get (distance (_reels.begin(), _reel), frame);
+	}
 
-			video->emit (
-				film(),
-				shared_ptr<ImageProxy> (
-					new J2KImageProxy (
-						_stereo_reader->get_frame (entry_point + frame),
-						picture_asset->size(),
-						dcp::EYE_RIGHT,
-						AV_PIX_FMT_XYZ12LE,
-						_forced_reduction
-						)
-					),
-				_offset + frame
-				);
-		}
+	if (f.mono) {
+		video->emit (
+			film(),
+			shared_ptr<ImageProxy> (
+				new J2KImageProxy (
+					f.mono,
+					picture_asset->size(),
+					AV_PIX_FMT_XYZ12LE,
+					_forced_reduction
+					)
+				),
+			_offset + frame
+			);
+	} else if (f.stereo) {
+		/* Both eyes come from the same frame, which has been read (and, if necessary, decrypted) once */
+		video->emit (
+			film(),
+			shared_ptr<ImageProxy> (
+				new J2KImageProxy (
+					f.stereo,
+					picture_asset->size(),
+					dcp::EYE_LEFT,
+					AV_PIX_FMT_XYZ12LE,
+					_forced_reduction
+					)
+				),
+			_offset + frame
+			);
+
+		video->emit (
+			film(),
+			shared_ptr<ImageProxy> (
+				new J2KImageProxy (
+					f.stereo,
+					picture_asset->size(),
+					dcp::EYE_RIGHT,
+					AV_PIX_FMT_XYZ12LE,
+					_forced_reduction
+					)
+				),
+			_offset + frame
+			);
 	}
 
-	if (_sound_reader && (_decode_referenced || !_dcp_content->reference_audio())) {
-		int64_t const entry_point = (*_reel)->main_sound()->entry_point ();
-		shared_ptr<const dcp::SoundFrame> sf = _sound_reader->get_frame (entry_point + frame);
-		uint8_t const * from = sf->data ();
+	if (f.sound) {
+		uint8_t const * from = f.sound->data ();
 
 		int const channels = _dcp_content->audio->stream()->channels ();
-		int const frames = sf->size() / (3 * channels);
+		int const frames = f.sound->size() / (3 * channels);
 		shared_ptr<AudioBuffers> data (new AudioBuffers (channels, frames));
 		float** data_data = data->data();
 		for (int i = 0; i < frames; ++i) {
@@ -298,41 +300,23 @@ DCPDecoder::next_reel ()
 {
 	_offset += (*_reel)->main_picture()->duration();
 	++_reel;
-	get_readers ();
 }
 
-void
-DCPDecoder::get_readers ()
+/** @return Our read-ahead, creating it if necessary, or 0 if we do not need any picture or sound */
+shared_ptr<DCPReadAhead>
+DCPDecoder::read_ahead ()
 {
-	if (_reel == _reels.end() || !_dcp_content->can_be_played ()) {
-		_mono_reader.reset ();
-		_stereo_reader.reset ();
-		_sound_reader.reset ();
-		return;
+	if (_read_ahead) {
+		return _read_ahead;
 	}
 
-	if ((*_reel)->main_picture()) {
-		shared_ptr<dcp::PictureAsset> asset = (*_reel)->main_picture()->asset ();
-		shared_ptr<dcp::MonoPictureAsset> mono = dynamic_pointer_cast<dcp::MonoPictureAsset> (asset);
-		shared_ptr<dcp::StereoPictureAsset> stereo = dynamic_pointer_cast<dcp::StereoPictureAsset> (asset);
-		DCPOMATIC_ASSERT (mono || stereo);
-		if (mono) {
-			_mono_reader = mono->start_read ();
-			_stereo_reader.reset ();
-		} else {
-			_stereo_reader = stereo->start_read ();
-			_mono_reader.reset ();
-		}
-	} else {
-		_mono_reader.reset ();
-		_stereo_reader.reset ();
+	bool const picture = _decode_referenced || !_dcp_content->reference_video();
+	bool const sound = _decode_referenced || !_dcp_content->reference_audio();
+	if (picture || sound) {
+		_read_ahead.reset (new DCPReadAhead (_reels, picture, sound, DCP_READ_AHEAD_BYTES));
 	}
 
-	if ((*_reel)->main_sound()) {
-		_sound_reader = (*_reel)->main_sound()->asset()->start_read ();
-	} else {
-		_sound_reader.reset ();
-	}
+	return _read_ahead;
 }
 
 void
@@ -346,7 +330,6 @@ DCPDecoder::seek (ContentTime t, bool accurate)
 
 	_reel = _reels.begin ();
 	_offset = 0;
-	get_readers ();
 
 	int const pre_roll_seconds = 2;
 
@@ -382,12 +365,20 @@ DCPDecoder::seek (ContentTime t, bool accurate)
 	}
 
 	_next = t;
+
+	/* Start reading the picture and sound that will be wanted next while the caller does other things */
+	shared_ptr<DCPReadAhead> ra = read_ahead ();
+	if (ra && _reel != _reels.end()) {
+		ra->seek (distance (_reels.begin(), _reel), _next.frames_round (_dcp_content->active_video_frame_rate(film())));
+	}
 }
 
 void
 DCPDecoder::set_decode_referenced (bool r)
 {
 	_decode_referenced = r;
+	/* This decides what we need to read, so start again next time we need something */
+	_read_ahead.reset ();
 
 	if (video) {
 		video->set_ignore (_dcp_content->reference_video() && !_decode_referenced);
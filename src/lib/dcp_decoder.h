@@ -24,9 +24,6 @@
 
 #include "decoder.h"
 #include "dcp.h"
-#include <dcp/mono_picture_asset_reader.h>
-#include <dcp/stereo_picture_asset_reader.h>
-#include <dcp/sound_asset_reader.h>
 #include <dcp/subtitle_asset.h>
 
 namespace dcp {
@@ -34,6 +31,7 @@ namespace dcp {
 }
 
 class DCPContent;
+class DCPReadAhead;
 class Log;
 struct dcp_subtitle_within_dcp_test;
 
@@ -56,7 +54,7 @@ private:
 	friend struct dcp_subtitle_within_dcp_test;
 
 	void next_reel ();
-	void get_readers ();
+	boost::shared_ptr<DCPReadAhead> read_ahead ();
 	void pass_texts (ContentTime next, dcp::Size size);
 	void pass_texts (
 		ContentTime next,
@@ -74,12 +72,8 @@ private:
 	std::list<boost::shared_ptr<dcp::Reel> >::iterator _reel;
 	/** Offset of _reel from the start of the content in frames */
 	int64_t _offset;
-	/** Reader for current mono picture asset, if applicable */
-	boost::shared_ptr<dcp::MonoPictureAssetReader> _mono_reader;
-	/** Reader for current stereo picture asset, if applicable */
-	boost::shared_ptr<dcp::StereoPictureAssetReader> _stereo_reader;
-	/** Reader for current sound asset, if applicable */
-	boost::shared_ptr<dcp::SoundAssetReader> _sound_reader;
+	/** Reader of picture and sound, created when we first need it */
+	boost::shared_ptr<DCPReadAhead> _read_ahead;
 
 	bool _decode_referenced;
 	boost::optional<int> _forced_reduction;
@@ -46,6 +46,7 @@
 using std::string;
 using std::cout;
 using std::list;
+using std::vector;
 using boost::shared_ptr;
 using boost::weak_ptr;
 using boost::dynamic_pointer_cast;
@@ -161,6 +162,16 @@ DCPEncoder::current_rate () const
 	return _j2k_encoder->current_encoding_rate ();
 }
 
+vector<string>
+DCPEncoder::slow_servers () const
+{
+	if (!_j2k_encoder) {
+		return vector<string> ();
+	}
+
+	return _j2k_encoder->slow_servers ();
+}
+
 Frame
 DCPEncoder::frames_done () const
 {
@@ -42,6 +42,7 @@ public:
 	void go ();
 
 	float current_rate () const;
+	std::vector<std::string> slow_servers () const;
 	Frame frames_done () const;
 
 	/** @return true if we are in the process of calling Encoder::process_end */
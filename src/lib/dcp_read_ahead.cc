@@ -0,0 +1,269 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/dcp_read_ahead.cc
+ *  @brief DCPReadAhead class.
+ */
+
+#include "dcp_read_ahead.h"
+#include "dcpomatic_assert.h"
+#include <dcp/reel.h>
+#include <dcp/reel_picture_asset.h>
+#include <dcp/reel_sound_asset.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/stereo_picture_asset.h>
+#include <dcp/sound_asset.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/stereo_picture_frame.h>
+#include <dcp/sound_frame.h>
+#include <boost/foreach.hpp>
+
+using std::list;
+using boost::shared_ptr;
+using boost::dynamic_pointer_cast;
+using boost::optional;
+using boost::bind;
+
+/** @param reels Reels to read from.
+ *  @param picture true to read picture frames.
+ *  @param sound true to read sound frames.
+ *  @param max_bytes Number of bytes of frames to read ahead of what has been asked for.
+ *  At least one frame is always read ahead, however big it is.
+ */
+DCPReadAhead::DCPReadAhead (list<shared_ptr<dcp::Reel> > reels, bool picture, bool sound, int64_t max_bytes)
+	: _picture (picture)
+	, _sound (sound)
+	, _max_bytes (max_bytes)
+	, _bytes (0)
+	, _reel (0)
+	, _frame (0)
+	, _generation (0)
+{
+	BOOST_FOREACH (shared_ptr<dcp::Reel> i, reels) {
+		DCPOMATIC_ASSERT (i->main_picture ());
+		_reels.push_back (i);
+	}
+
+	_thread = new boost::thread (bind (&DCPReadAhead::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread->native_handle(), "dcp-read-ahead");
+#endif
+}
+
+DCPReadAhead::~DCPReadAhead ()
+{
+	_thread->interrupt ();
+	try {
+		_thread->join ();
+	} catch (boost::thread_interrupted& e) {
+		/* No problem */
+	}
+	delete _thread;
+}
+
+int64_t
+DCPReadAhead::Frame::bytes () const
+{
+	int64_t n = 0;
+	if (mono) {
+		n += mono->j2k_size ();
+	}
+	if (stereo) {
+		n += stereo->left_j2k_size() + stereo->right_j2k_size();
+	}
+	if (sound) {
+		n += sound->size ();
+	}
+	return n;
+}
+
+/** Get a frame, waiting for it to be read if it has not been already.  Asking for
+ *  anything other than the frame after the last one that was asked for (or the one
+ *  after the last seek) works, but it will throw away anything read so far.
+ *  @param reel Index of reel.
+ *  @param frame Frame within the reel, not counting its picture's entry point.
+ */
+DCPReadAhead::Frame
+DCPReadAhead::get (int reel, int64_t frame)
+{
+	DCPOMATIC_ASSERT (reel >= 0 && reel < int(_reels.size()));
+	DCPOMATIC_ASSERT (frame >= 0 && frame < _reels[reel]->main_picture()->duration());
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (!_frames.empty() && (_frames.front().reel < reel || (_frames.front().reel == reel && _frames.front().frame < frame))) {
+		_bytes -= _frames.front().bytes();
+		_frames.pop_front ();
+	}
+
+	bool const ready = !_frames.empty() && _frames.front().reel == reel && _frames.front().frame == frame;
+	bool const next = _frames.empty() && _reel == reel && _frame == frame;
+	if (!ready && !next) {
+		seek_unlocked (reel, frame);
+	}
+
+	while (_frames.empty() && !_error) {
+		_arrived.wait (lm);
+	}
+
+	if (_frames.empty()) {
+		/* Reading this frame failed; keep the error so that we can throw it again if
+		   we are asked for the same thing before a seek.
+		*/
+		boost::rethrow_exception (_error);
+	}
+
+	Frame const f = _frames.front ();
+	_frames.pop_front ();
+	_bytes -= f.bytes ();
+	_summon.notify_all ();
+	return f;
+}
+
+/** Throw away anything that has been read and start reading from a new position.
+ *  @param reel Index of reel.
+ *  @param frame Frame within the reel, not counting its picture's entry point.
+ */
+void
+DCPReadAhead::seek (int reel, int64_t frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	seek_unlocked (reel, frame);
+}
+
+/** Caller must hold a lock on _mutex */
+void
+DCPReadAhead::seek_unlocked (int reel, int64_t frame)
+{
+	_frames.clear ();
+	_bytes = 0;
+	_reel = reel;
+	_frame = frame;
+	++_generation;
+	_error = boost::exception_ptr ();
+	_summon.notify_all ();
+}
+
+void
+DCPReadAhead::thread ()
+try
+{
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+
+		/* Wait until there is something to read and room for it */
+		while (_error || _reel == int(_reels.size()) || (!_frames.empty() && _bytes >= _max_bytes)) {
+			_summon.wait (lm);
+		}
+
+		int const reel = _reel;
+		int64_t const frame = _frame;
+		int const generation = _generation;
+
+		lm.unlock ();
+
+		Frame f;
+		try {
+			f = read (reel, frame);
+		} catch (boost::thread_interrupted& e) {
+			throw;
+		} catch (...) {
+			lm.lock ();
+			if (generation == _generation) {
+				_error = boost::current_exception ();
+				_arrived.notify_all ();
+			}
+			continue;
+		}
+
+		lm.lock ();
+
+		if (generation != _generation) {
+			/* There was a seek while we were reading */
+			continue;
+		}
+
+		_frames.push_back (f);
+		_bytes += f.bytes ();
+
+		++_frame;
+		if (_frame >= _reels[_reel]->main_picture()->duration()) {
+			++_reel;
+			_frame = 0;
+		}
+
+		_arrived.notify_all ();
+	}
+} catch (boost::thread_interrupted& e) {
+	/* The thread is being terminated */
+}
+
+/** Read a frame; must only be called from the thread */
+DCPReadAhead::Frame
+DCPReadAhead::read (int reel, int64_t frame)
+{
+	if (!_readers_reel || *_readers_reel != reel) {
+		open (reel);
+	}
+
+	shared_ptr<dcp::Reel> r = _reels[reel];
+
+	Frame f (reel, frame);
+	if (_mono_reader) {
+		f.mono = _mono_reader->get_frame (r->main_picture()->entry_point() + frame);
+	} else if (_stereo_reader) {
+		f.stereo = _stereo_reader->get_frame (r->main_picture()->entry_point() + frame);
+	}
+	if (_sound_reader) {
+		f.sound = _sound_reader->get_frame (r->main_sound()->entry_point() + frame);
+	}
+
+	return f;
+}
+
+/** Open readers for a reel's assets; must only be called from the thread */
+void
+DCPReadAhead::open (int reel)
+{
+	_readers_reel = optional<int> ();
+	_mono_reader.reset ();
+	_stereo_reader.reset ();
+	_sound_reader.reset ();
+
+	shared_ptr<dcp::Reel> r = _reels[reel];
+
+	if (_picture) {
+		shared_ptr<dcp::PictureAsset> asset = r->main_picture()->asset ();
+		shared_ptr<dcp::MonoPictureAsset> mono = dynamic_pointer_cast<dcp::MonoPictureAsset> (asset);
+		shared_ptr<dcp::StereoPictureAsset> stereo = dynamic_pointer_cast<dcp::StereoPictureAsset> (asset);
+		DCPOMATIC_ASSERT (mono || stereo);
+		if (mono) {
+			_mono_reader = mono->start_read ();
+		} else {
+			_stereo_reader = stereo->start_read ();
+		}
+	}
+
+	if (_sound && r->main_sound()) {
+		_sound_reader = r->main_sound()->asset()->start_read ();
+	}
+
+	_readers_reel = reel;
+}
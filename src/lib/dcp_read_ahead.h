@@ -0,0 +1,130 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_DCP_READ_AHEAD_H
+#define DCPOMATIC_DCP_READ_AHEAD_H
+
+/** @file  src/lib/dcp_read_ahead.h
+ *  @brief DCPReadAhead class.
+ */
+
+#include <dcp/mono_picture_asset_reader.h>
+#include <dcp/stereo_picture_asset_reader.h>
+#include <dcp/sound_asset_reader.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <list>
+#include <vector>
+
+namespace dcp {
+	class Reel;
+	class MonoPictureFrame;
+	class StereoPictureFrame;
+	class SoundFrame;
+}
+
+/** @class DCPReadAhead
+ *  @brief Reader of picture and sound frames from a DCP's MXFs which reads ahead of what
+ *  is being asked for on its own thread.
+ *
+ *  Frames are read in order, moving through the reels, until the frames that have been read
+ *  but not yet asked for take up a given number of bytes.  The MXF readers are only ever
+ *  used by the read-ahead thread.
+ */
+class DCPReadAhead : public boost::noncopyable
+{
+public:
+	DCPReadAhead (std::list<boost::shared_ptr<dcp::Reel> > reels, bool picture, bool sound, int64_t max_bytes);
+	~DCPReadAhead ();
+
+	/** The picture and sound for one frame of a reel */
+	struct Frame
+	{
+		Frame ()
+			: reel (0)
+			, frame (0)
+		{}
+
+		Frame (int reel_, int64_t frame_)
+			: reel (reel_)
+			, frame (frame_)
+		{}
+
+		int64_t bytes () const;
+
+		/** Index of the reel */
+		int reel;
+		/** Frame within the reel, not counting its picture's entry point */
+		int64_t frame;
+		/** Picture, if the reel is 2D and we are reading picture */
+		boost::shared_ptr<const dcp::MonoPictureFrame> mono;
+		/** Picture, if the reel is 3D and we are reading picture */
+		boost::shared_ptr<const dcp::StereoPictureFrame> stereo;
+		/** Sound, if the reel has some and we are reading sound */
+		boost::shared_ptr<const dcp::SoundFrame> sound;
+	};
+
+	Frame get (int reel, int64_t frame);
+	void seek (int reel, int64_t frame);
+
+private:
+	void thread ();
+	Frame read (int reel, int64_t frame);
+	void open (int reel);
+	void seek_unlocked (int reel, int64_t frame);
+
+	std::vector<boost::shared_ptr<dcp::Reel> > _reels;
+	bool _picture;
+	bool _sound;
+	int64_t _max_bytes;
+
+	/** Reel that our readers are for, if they have been opened; only used by the thread */
+	boost::optional<int> _readers_reel;
+	boost::shared_ptr<dcp::MonoPictureAssetReader> _mono_reader;
+	boost::shared_ptr<dcp::StereoPictureAssetReader> _stereo_reader;
+	boost::shared_ptr<dcp::SoundAssetReader> _sound_reader;
+
+	/** mutex to protect the things below */
+	boost::mutex _mutex;
+	/** Frames that have been read and not yet asked for, in order */
+	std::list<Frame> _frames;
+	/** Total size of the data in _frames */
+	int64_t _bytes;
+	/** Reel of the next frame for the thread to read, or _reels.size() if it has reached the end */
+	int _reel;
+	/** Frame within _reel of the next frame for the thread to read */
+	int64_t _frame;
+	/** Incremented on each seek so that the thread can tell if it should discard a frame that
+	 *  it was reading when the seek happened.
+	 */
+	int _generation;
+	/** Exception thrown when reading the frame at _reel/_frame, if there was one */
+	boost::exception_ptr _error;
+	boost::condition _summon;
+	boost::condition _arrived;
+
+	boost::thread* _thread;
+};
+
+#endif
@@ -38,11 +38,13 @@
 #include "dcpomatic_log.h"
 #include "cross.h"
 #include "player_video.h"
+#include "binary_encoding_request.h"
+#include "digester.h"
+#include "xyz_converter.h"
 #include "compose.hpp"
 #include <libcxml/cxml.h>
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
-#include <dcp/rgb_xyz.h>
 #include <dcp/j2k.h>
 #include <libxml++/libxml++.h>
 #include <boost/asio.hpp>
@@ -55,6 +57,7 @@
 
 using std::string;
 using std::cout;
+using std::min;
 using boost::shared_ptr;
 using dcp::Size;
 using dcp::Data;
@@ -88,6 +91,16 @@ DCPVideo::DCPVideo (shared_ptr<const PlayerVideo> frame, shared_ptr<const cxml::
 	_resolution = Resolution (node->optional_number_child<int>("Resolution").get_value_or (RESOLUTION_2K));
 }
 
+DCPVideo::DCPVideo (shared_ptr<const PlayerVideo> frame, BinaryEncodingRequest const & request)
+	: _frame (frame)
+	, _index (request.index)
+	, _frames_per_second (request.frames_per_second)
+	, _j2k_bandwidth (request.j2k_bandwidth)
+	, _resolution (Resolution (request.resolution))
+{
+
+}
+
 shared_ptr<dcp::OpenJPEGImage>
 DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note)
 {
@@ -95,11 +108,10 @@ DCPVideo::convert_to_xyz (shared_ptr<const PlayerVideo> frame, dcp::NoteHandler
 
 	shared_ptr<Image> image = frame->image (bind (&PlayerVideo::keep_xyz_or_rgb, _1), true, false);
 	if (frame->colour_conversion()) {
-		xyz = dcp::rgb_to_xyz (
+		xyz = XYZConverter::get(frame->colour_conversion().get())->convert (
 			image->data()[0],
 			image->size(),
 			image->stride()[0],
-			frame->colour_conversion().get(),
 			note
 			);
 	} else {
@@ -157,10 +169,61 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 
 	socket->connect (*endpoint_iterator);
 
+	send_request (socket, min (serv.link_version(), SERVER_LINK_VERSION));
+
+	/* Read the response (JPEG2000-encoded data); this blocks until the data
+	   is ready and sent back.
+	*/
+	LOG_TIMING("start-remote-encode thread=%1", thread_id ());
+	Data e (socket->read_uint32 ());
+	LOG_TIMING("start-remote-receive thread=%1", thread_id ());
+	socket->read (e.data().get(), e.size());
+	LOG_TIMING("finish-remote-receive thread=%1", thread_id ());
+
+	LOG_DEBUG_ENCODE (N_("Finished remotely-encoded frame %1"), _index);
+
+	return e;
+}
+
+/** Send a request to encode this frame down a socket which is connected to an EncodeServer.
+ *  @param socket Socket to use.
+ *  @param link_version Server link version to use.
+ */
+void
+DCPVideo::send_request (shared_ptr<Socket> socket, int link_version) const
+{
+	if (link_version >= SERVER_LINK_VERSION_BINARY_REQUEST) {
+		BinaryEncodingRequest request;
+		if (add_binary_metadata (request)) {
+			LOG_DEBUG_ENCODE (N_("Sending frame %1 to remote"), _index);
+
+			request.compressed =
+				link_version >= SERVER_LINK_VERSION_COMPRESSED_IMAGES &&
+				Config::instance()->compress_frames_for_servers();
+
+			uint8_t buffer[BinaryEncodingRequest::length];
+			request.write (buffer);
+			uint32_t length = BinaryEncodingRequest::length | BinaryEncodingRequest::flag;
+			if (request.compressed) {
+				length |= BinaryEncodingRequest::compressed_flag;
+			}
+			socket->write (length);
+			socket->write (buffer, BinaryEncodingRequest::length);
+
+			LOG_TIMING("start-remote-send thread=%1", thread_id ());
+			if (request.compressed) {
+				_frame->send_compressed (socket);
+			} else {
+				_frame->send_binary (socket);
+			}
+			return;
+		}
+	}
+
 	/* Collect all XML metadata */
 	xmlpp::Document doc;
 	xmlpp::Element* root = doc.create_root_node ("EncodingRequest");
-	root->add_child("Version")->add_child_text (raw_convert<string> (SERVER_LINK_VERSION));
+	root->add_child("Version")->add_child_text (raw_convert<string> (link_version));
 	add_metadata (root);
 
 	LOG_DEBUG_ENCODE (N_("Sending frame %1 to remote"), _index);
@@ -173,19 +236,6 @@ DCPVideo::encode_remotely (EncodeServerDescription serv, int timeout)
 	/* Send binary data */
 	LOG_TIMING("start-remote-send thread=%1", thread_id ());
 	_frame->send_binary (socket);
-
-	/* Read the response (JPEG2000-encoded data); this blocks until the data
-	   is ready and sent back.
-	*/
-	LOG_TIMING("start-remote-encode thread=%1", thread_id ());
-	Data e (socket->read_uint32 ());
-	LOG_TIMING("start-remote-receive thread=%1", thread_id ());
-	socket->read (e.data().get(), e.size());
-	LOG_TIMING("finish-remote-receive thread=%1", thread_id ());
-
-	LOG_DEBUG_ENCODE (N_("Finished remotely-encoded frame %1"), _index);
-
-	return e;
 }
 
 void
@@ -198,6 +248,17 @@ DCPVideo::add_metadata (xmlpp::Element* el) const
 	_frame->add_metadata (el);
 }
 
+/** @return false if this frame cannot be described by a BinaryEncodingRequest */
+bool
+DCPVideo::add_binary_metadata (BinaryEncodingRequest& request) const
+{
+	request.index = _index;
+	request.frames_per_second = _frames_per_second;
+	request.j2k_bandwidth = _j2k_bandwidth;
+	request.resolution = static_cast<int> (_resolution);
+	return _frame->add_binary_metadata (request);
+}
+
 Eyes
 DCPVideo::eyes () const
 {
@@ -218,3 +279,25 @@ DCPVideo::same (shared_ptr<const DCPVideo> other) const
 
 	return _frame->same (other->_frame);
 }
+
+/** @return Digest of everything that affects the J2K data that we will make
+ *  (apart from the frame index).
+ */
+string
+DCPVideo::digest () const
+{
+	Digester digester;
+	_frame->add_digest (digester);
+	digester.add (_frames_per_second);
+	digester.add (_j2k_bandwidth);
+	digester.add (static_cast<int> (_resolution));
+	digester.add (_frame->eyes() == EYES_LEFT || _frame->eyes() == EYES_RIGHT);
+	return digester.get ();
+}
+
+/** @return true if digest() is quick */
+bool
+DCPVideo::digest_is_cheap () const
+{
+	return _frame->digest_is_cheap ();
+}
@@ -29,6 +29,8 @@
 
 class Log;
 class PlayerVideo;
+class Socket;
+class BinaryEncodingRequest;
 
 /** @class DCPVideo
  *  @brief A single frame of video destined for a DCP.
@@ -44,9 +46,11 @@ class DCPVideo : public boost::noncopyable
 public:
 	DCPVideo (boost::shared_ptr<const PlayerVideo>, int, int, int, Resolution);
 	DCPVideo (boost::shared_ptr<const PlayerVideo>, cxml::ConstNodePtr);
+	DCPVideo (boost::shared_ptr<const PlayerVideo>, BinaryEncodingRequest const &);
 
 	dcp::Data encode_locally ();
 	dcp::Data encode_remotely (EncodeServerDescription, int timeout = 30);
+	void send_request (boost::shared_ptr<Socket> socket, int link_version) const;
 
 	int index () const {
 		return _index;
@@ -55,12 +59,15 @@ public:
 	Eyes eyes () const;
 
 	bool same (boost::shared_ptr<const DCPVideo> other) const;
+	std::string digest () const;
+	bool digest_is_cheap () const;
 
 	static boost::shared_ptr<dcp::OpenJPEGImage> convert_to_xyz (boost::shared_ptr<const PlayerVideo> frame, dcp::NoteHandler note);
 
 private:
 
 	void add_metadata (xmlpp::Element *) const;
+	bool add_binary_metadata (BinaryEncodingRequest& request) const;
 
 	boost::shared_ptr<const PlayerVideo> _frame;
 	int _index;			 ///< frame index within the DCP's intrinsic duration
@@ -32,6 +32,7 @@ Socket::Socket (int timeout)
 	: _deadline (_io_service)
 	, _socket (_io_service)
 	, _timeout (timeout)
+	, _read_bytes (0)
 {
 	_deadline.expires_at (boost::posix_time::pos_infin);
 	check ();
@@ -117,6 +118,8 @@ Socket::read (uint8_t* data, int size)
 	if (ec) {
 		throw NetworkError (String::compose (_("error during async_read (%1)"), ec.value ()));
 	}
+
+	_read_bytes += size;
 }
 
 uint32_t
@@ -126,3 +129,19 @@ Socket::read_uint32 ()
 	read (reinterpret_cast<uint8_t *> (&v), 4);
 	return ntohl (v);
 }
+
+/** Close the socket so that any read or write which is in progress, or which is
+ *  started later, fails straight away.  This may be called from any thread; the
+ *  socket is closed by whichever thread is using it.
+ */
+void
+Socket::cancel ()
+{
+	_io_service.post (boost::bind (&Socket::close, this));
+}
+
+void
+Socket::close ()
+{
+	_socket.close ();
+}
@@ -46,8 +46,16 @@ public:
 	void read (uint8_t* data, int size);
 	uint32_t read_uint32 ();
 
+	void cancel ();
+
+	/** @return Total number of bytes that have been read from this socket */
+	uint64_t read_bytes () const {
+		return _read_bytes;
+	}
+
 private:
 	void check ();
+	void close ();
 
 	Socket (Socket const &);
 
@@ -55,4 +63,5 @@ private:
 	boost::asio::deadline_timer _deadline;
 	boost::asio::ip::tcp::socket _socket;
 	int _timeout;
+	uint64_t _read_bytes;
 };
@@ -0,0 +1,412 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/encode_scheduler.cc
+ *  @brief EncodeScheduler class.
+ */
+
+#include "encode_scheduler.h"
+#include "dcpomatic_assert.h"
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+
+using std::list;
+using std::min;
+using std::vector;
+using boost::shared_ptr;
+
+EncodeScheduler::EncodeScheduler ()
+	: _workers (new WorkerMap)
+	, _available (0)
+	, _next_id (0)
+	, _next_push (0)
+	, _work_waiters (0)
+	, _space_waiters (0)
+	, _wake_generation (0)
+{
+
+}
+
+/** Add a worker.
+ *  @param local true if the worker is encoding on this machine, in which case
+ *  it will be given its share of new frames; false if it should only steal.
+ *  @return ID to pass to pop() and remove_worker().
+ */
+int
+EncodeScheduler::add_worker (bool local)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	int const id = _next_id++;
+	shared_ptr<WorkerMap> changed (new WorkerMap (*_workers));
+	(*changed)[id] = shared_ptr<Worker> (new Worker (local));
+	boost::atomic_store (&_workers, shared_ptr<const WorkerMap> (changed));
+	return id;
+}
+
+/** Remove a worker; anything left in its deque is handed out to the others */
+void
+EncodeScheduler::remove_worker (int id)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	WorkerMap::const_iterator i = _workers->find (id);
+	if (i == _workers->end()) {
+		return;
+	}
+
+	shared_ptr<Worker> w = i->second;
+	shared_ptr<WorkerMap> changed (new WorkerMap (*_workers));
+	changed->erase (id);
+	boost::atomic_store (&_workers, shared_ptr<const WorkerMap> (changed));
+
+	/* push() may still have w from an earlier snapshot, so make sure that it
+	   cannot give w anything once we have emptied it.
+	*/
+	boost::mutex::scoped_lock wm (w->mutex);
+	w->removed = true;
+	{
+		boost::mutex::scoped_lock sm (_shared_mutex);
+		_shared.insert (_shared.end(), w->frames.begin(), w->frames.end());
+	}
+	w->frames.clear ();
+	/* Wake anybody in pop() who was looking for these frames */
+	_work_condition.notify_all ();
+}
+
+/** @return Snapshot of the current workers */
+shared_ptr<const EncodeScheduler::WorkerMap>
+EncodeScheduler::workers () const
+{
+	return boost::atomic_load (&_workers);
+}
+
+/** Add a new frame to be encoded */
+void
+EncodeScheduler::push (shared_ptr<DCPVideo> frame)
+{
+	shared_ptr<const WorkerMap> all = workers ();
+
+	bool any_local = false;
+	for (WorkerMap::const_iterator i = all->begin(); i != all->end(); ++i) {
+		if (i->second->local) {
+			any_local = true;
+			break;
+		}
+	}
+
+	/* Find the next worker after the last one that we gave something to */
+	shared_ptr<Worker> target;
+	WorkerMap::const_iterator i = all->upper_bound (_next_push);
+	for (size_t n = 0; n < all->size(); ++n) {
+		if (i == all->end()) {
+			i = all->begin ();
+		}
+		if (!any_local || i->second->local) {
+			target = i->second;
+			_next_push = i->first;
+			break;
+		}
+		++i;
+	}
+
+	bool pushed = false;
+	if (target) {
+		boost::mutex::scoped_lock wm (target->mutex);
+		if (!target->removed) {
+			target->frames.push_back (frame);
+			pushed = true;
+		}
+	}
+
+	if (!pushed) {
+		/* Nobody to give it to */
+		push_shared (frame, false);
+	}
+
+	made_available ();
+}
+
+/** Put a frame back which could not be encoded; it will be the next thing
+ *  that any worker picks up.
+ */
+void
+EncodeScheduler::push_front (shared_ptr<DCPVideo> frame)
+{
+	push_shared (frame, true);
+	made_available ();
+}
+
+void
+EncodeScheduler::push_shared (shared_ptr<DCPVideo> frame, bool front)
+{
+	boost::mutex::scoped_lock lm (_shared_mutex);
+	if (front) {
+		_shared.push_front (frame);
+	} else {
+		_shared.push_back (frame);
+	}
+}
+
+/** Count a frame which has just been put into a deque, and wake a worker if any are asleep */
+void
+EncodeScheduler::made_available ()
+{
+	++_available;
+	/* A worker increments _work_waiters before it looks at _available, so if it has missed
+	   our frame we will see it here.  Taking _mutex makes sure that it is waiting on
+	   _work_condition before we notify.
+	*/
+	if (_work_waiters > 0) {
+		boost::mutex::scoped_lock lm (_mutex);
+		_work_condition.notify_one ();
+	}
+}
+
+/** Add a copy of a frame which is being encoded elsewhere but which is taking too long.
+ *  It will be given to the first local worker which has nothing else to do.
+ */
+void
+EncodeScheduler::push_speculative (shared_ptr<DCPVideo> frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_speculative.push_back (frame);
+	/* We don't know which of the waiting workers are local, so wake them all */
+	_work_condition.notify_all ();
+}
+
+/** @return true if a worker could take a speculative frame now; must be called with _mutex held */
+bool
+EncodeScheduler::can_speculate (int worker) const
+{
+	if (_speculative.empty ()) {
+		return false;
+	}
+
+	WorkerMap::const_iterator i = _workers->find (worker);
+	return i != _workers->end() && i->second->local;
+}
+
+/** Claim up to max_frames of the available frames.
+ *  @return Number of frames claimed, which may be 0.
+ */
+size_t
+EncodeScheduler::claim (size_t max_frames)
+{
+	size_t available = _available;
+	while (available > 0) {
+		size_t const wanted = min (available, max_frames);
+		if (_available.compare_exchange_weak (available, available - wanted)) {
+			return wanted;
+		}
+	}
+
+	return 0;
+}
+
+/** Move frames from the front of a deque to the back of out until out has `wanted' frames;
+ *  the mutex for the deque must be held.
+ */
+void
+EncodeScheduler::take_from (std::deque<shared_ptr<DCPVideo> >& from, size_t wanted, list<shared_ptr<DCPVideo> >& out) const
+{
+	while (out.size() < wanted && !from.empty()) {
+		out.push_back (from.front ());
+		from.pop_front ();
+	}
+}
+
+/** Find frames that have been claimed.
+ *  @param worker ID of the worker that claimed them.
+ *  @param wanted Number of frames that were claimed, including any already in out.
+ *  @param out List to add the frames to.
+ */
+void
+EncodeScheduler::take (int worker, size_t wanted, list<shared_ptr<DCPVideo> >& out)
+{
+	/* Look at _shared first, since the Writer is probably waiting for things in it */
+	{
+		boost::mutex::scoped_lock lm (_shared_mutex);
+		take_from (_shared, wanted, out);
+	}
+
+	/* Then our own deque, then steal from the others */
+	shared_ptr<const WorkerMap> all = workers ();
+	WorkerMap::const_iterator i = all->find (worker);
+	if (i != all->end() && out.size() < wanted) {
+		boost::mutex::scoped_lock wm (i->second->mutex);
+		take_from (i->second->frames, wanted, out);
+	}
+
+	for (i = all->begin(); i != all->end() && out.size() < wanted; ++i) {
+		if (i->first != worker) {
+			boost::mutex::scoped_lock wm (i->second->mutex);
+			take_from (i->second->frames, wanted, out);
+		}
+	}
+
+	if (out.size() == wanted) {
+		return;
+	}
+
+	/* Some of our frames were moved to _shared by remove_worker(), or taken by other workers
+	   from places that we had not yet looked at while frames that they claimed appeared in
+	   places that we had already looked at.  Look again with _mutex held so that nothing can
+	   move them.  There are always at least as many frames in the deques as have been claimed,
+	   so this should not take long, but rather than spinning we wait a little if we do not find
+	   them.  We have claimed frames so we must not be interrupted here.
+	*/
+	boost::this_thread::disable_interruption di;
+	boost::mutex::scoped_lock lm (_mutex);
+	while (true) {
+		{
+			boost::mutex::scoped_lock sm (_shared_mutex);
+			take_from (_shared, wanted, out);
+		}
+		for (i = _workers->begin(); i != _workers->end() && out.size() < wanted; ++i) {
+			boost::mutex::scoped_lock wm (i->second->mutex);
+			take_from (i->second->frames, wanted, out);
+		}
+		if (out.size() == wanted) {
+			break;
+		}
+		_work_condition.timed_wait (lm, boost::posix_time::milliseconds (1));
+	}
+}
+
+/** Take some frames to encode, blocking until at least one is available.  This is a
+ *  boost::thread interruption point, but only until frames have been claimed.  If a
+ *  local worker has nothing else to do it may be given a single speculative frame.
+ *  @param worker ID of the worker that is asking.
+ *  @param max_frames Maximum number of frames to take.
+ *  @return Frames to encode.
+ */
+list<shared_ptr<DCPVideo> >
+EncodeScheduler::pop (int worker, int max_frames)
+{
+	DCPOMATIC_ASSERT (max_frames > 0);
+
+	list<shared_ptr<DCPVideo> > out;
+
+	/* Usually there is something to claim without taking _mutex */
+	size_t wanted = claim (max_frames);
+
+	if (wanted == 0) {
+		boost::mutex::scoped_lock lm (_mutex);
+		/* This must happen before we look at _available; see made_available() */
+		++_work_waiters;
+		try {
+			while (true) {
+				wanted = claim (max_frames);
+				if (wanted > 0) {
+					break;
+				}
+				if (can_speculate (worker)) {
+					out.push_back (_speculative.front ());
+					_speculative.pop_front ();
+					break;
+				}
+				_work_condition.wait (lm);
+			}
+		} catch (...) {
+			/* Most likely boost::thread_interrupted */
+			--_work_waiters;
+			throw;
+		}
+		--_work_waiters;
+
+		if (wanted == 0) {
+			/* We got a speculative frame */
+			return out;
+		}
+	}
+
+	/* Like made_available(), but for the space that we just made */
+	if (_space_waiters > 0) {
+		boost::mutex::scoped_lock lm (_mutex);
+		_space_condition.notify_all ();
+	}
+
+	take (worker, wanted, out);
+	return out;
+}
+
+/** Remove and return everything that is queued.  This should only be called
+ *  when no workers are running.
+ */
+list<shared_ptr<DCPVideo> >
+EncodeScheduler::take_all ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	list<shared_ptr<DCPVideo> > all;
+	{
+		boost::mutex::scoped_lock sm (_shared_mutex);
+		all.assign (_shared.begin(), _shared.end());
+		_shared.clear ();
+	}
+	/* These are all being encoded somewhere else too */
+	_speculative.clear ();
+
+	for (WorkerMap::const_iterator i = _workers->begin(); i != _workers->end(); ++i) {
+		boost::mutex::scoped_lock wm (i->second->mutex);
+		all.insert (all.end(), i->second->frames.begin(), i->second->frames.end());
+		i->second->frames.clear ();
+	}
+
+	_available = 0;
+	return all;
+}
+
+/** Block until fewer than `limit' frames are waiting to be claimed, or until
+ *  wake() is called.
+ */
+void
+EncodeScheduler::wait_until_below (size_t limit)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	int const generation = _wake_generation;
+	++_space_waiters;
+	try {
+		while (_available >= limit && generation == _wake_generation) {
+			_space_condition.wait (lm);
+		}
+	} catch (...) {
+		/* Most likely boost::thread_interrupted */
+		--_space_waiters;
+		throw;
+	}
+	--_space_waiters;
+}
+
+/** Wake anything that is in wait_until_below(); e.g. so that it can notice an exception */
+void
+EncodeScheduler::wake ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	++_wake_generation;
+	_space_condition.notify_all ();
+}
+
+/** @return Number of frames which are queued and not yet claimed by a worker */
+size_t
+EncodeScheduler::size () const
+{
+	return _available;
+}
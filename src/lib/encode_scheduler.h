@@ -0,0 +1,141 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_ENCODE_SCHEDULER_H
+#define DCPOMATIC_ENCODE_SCHEDULER_H
+
+/** @file  src/lib/encode_scheduler.h
+ *  @brief EncodeScheduler class.
+ */
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+
+class DCPVideo;
+
+/** @class EncodeScheduler
+ *  @brief Work-stealing queue of frames waiting to be encoded.
+ *
+ *  Each worker thread has its own deque of frames.  New frames are dealt out
+ *  round-robin to the deques of local workers (or all workers if there are no
+ *  local ones), and a worker takes from the front of its own deque before
+ *  stealing from the fronts of the others.  Remote workers have nothing dealt
+ *  to them; they steal batches from everybody else.
+ *
+ *  Frames that a worker could not encode are put onto a shared deque which
+ *  everybody looks at first, since the Writer will be waiting for them.
+ *
+ *  The only state shared by all workers is an atomic count of the frames which
+ *  have not yet been claimed; it is used to put idle workers to sleep and to
+ *  apply back-pressure to whoever is pushing frames.  Pushing and popping take
+ *  only the mutexes of the deques that they touch; _mutex is only needed to
+ *  sleep, to change the set of workers or to take speculative frames.
+ *
+ *  Finally, there is a deque of speculative frames: copies of frames which are
+ *  already being encoded elsewhere but which are late.  Only local workers take
+ *  these, and only when there is nothing else to do; they are not counted by size().
+ */
+class EncodeScheduler : public boost::noncopyable
+{
+public:
+	EncodeScheduler ();
+
+	int add_worker (bool local);
+	void remove_worker (int worker);
+
+	void push (boost::shared_ptr<DCPVideo> frame);
+	void push_front (boost::shared_ptr<DCPVideo> frame);
+	void push_speculative (boost::shared_ptr<DCPVideo> frame);
+	std::list<boost::shared_ptr<DCPVideo> > pop (int worker, int max_frames);
+	std::list<boost::shared_ptr<DCPVideo> > take_all ();
+
+	void wait_until_below (size_t limit);
+	void wake ();
+
+	size_t size () const;
+
+private:
+	struct Worker
+	{
+		explicit Worker (bool l)
+			: local (l)
+			, removed (false)
+		{}
+
+		bool local;
+		/** mutex for removed and frames */
+		boost::mutex mutex;
+		/** true if remove_worker() has been called for this worker */
+		bool removed;
+		std::deque<boost::shared_ptr<DCPVideo> > frames;
+	};
+
+	typedef std::map<int, boost::shared_ptr<Worker> > WorkerMap;
+
+	boost::shared_ptr<const WorkerMap> workers () const;
+	size_t claim (size_t max_frames);
+	void take (int worker, size_t wanted, std::list<boost::shared_ptr<DCPVideo> >& out);
+	void take_from (std::deque<boost::shared_ptr<DCPVideo> >& from, size_t wanted, std::list<boost::shared_ptr<DCPVideo> >& out) const;
+	void push_shared (boost::shared_ptr<DCPVideo> frame, bool front);
+	void made_available ();
+	bool can_speculate (int worker) const;
+
+	/** mutex for _speculative and _wake_generation, and to be held while sleeping on
+	 *  either condition or while changing _workers.  It is taken before any other mutex.
+	 */
+	mutable boost::mutex _mutex;
+	/** the current workers; this map is never changed once it is published, but it is replaced
+	 *  (with _mutex held) when a worker is added or removed.  Read it using workers().
+	 */
+	boost::shared_ptr<const WorkerMap> _workers;
+	/** mutex for _shared; taken after any Worker::mutex */
+	boost::mutex _shared_mutex;
+	/** frames which have been put back after a failure */
+	std::deque<boost::shared_ptr<DCPVideo> > _shared;
+	/** copies of late frames, for local workers which have nothing else to do */
+	std::deque<boost::shared_ptr<DCPVideo> > _speculative;
+	/** number of frames which are queued and which nobody has yet claimed.  A frame is
+	 *  only counted once it is in a deque, so there are always at least this many frames
+	 *  in the deques.
+	 */
+	boost::atomic<size_t> _available;
+	int _next_id;
+	/** id of the worker that was given the last pushed frame */
+	boost::atomic<int> _next_push;
+	/** number of threads waiting in pop() for _work_condition */
+	boost::atomic<int> _work_waiters;
+	/** number of threads waiting in wait_until_below() */
+	boost::atomic<int> _space_waiters;
+	/** incremented by wake() so that wait_until_below() can notice */
+	int _wake_generation;
+	/** condition to wake workers when a frame is added */
+	boost::condition _work_condition;
+	/** condition to wake wait_until_below() when a frame is claimed */
+	boost::condition _space_condition;
+};
+
+#endif
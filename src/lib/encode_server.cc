@@ -35,6 +35,8 @@
 #include "log.h"
 #include "dcpomatic_log.h"
 #include "encoded_log_entry.h"
+#include "exceptions.h"
+#include "binary_encoding_request.h"
 #include "version.h"
 #include <dcp/raw_convert.h>
 #include <libcxml/cxml.h>
@@ -54,6 +56,7 @@
 using std::string;
 using std::vector;
 using std::list;
+using std::min;
 using std::cout;
 using std::cerr;
 using std::fixed;
@@ -66,6 +69,46 @@ using dcp::Size;
 using dcp::Data;
 using dcp::raw_convert;
 
+/** Largest number of frames that we will accept in one batch on a pipelined connection */
+static uint32_t const maximum_pipelined_batch = 256;
+
+/** The frames from one batch on a pipelined connection which have been encoded */
+struct PipelineResults
+{
+	PipelineResults ()
+		: abandoned (false)
+	{}
+
+	boost::mutex mutex;
+	boost::condition condition;
+	std::list<shared_ptr<PipelinedFrame> > done;
+	/** true if the connection has gone and nobody wants these results any more */
+	bool abandoned;
+};
+
+/** A frame which has been sent down a pipelined connection */
+struct PipelinedFrame
+{
+	PipelinedFrame (shared_ptr<DCPVideo> f, int p, shared_ptr<PipelineResults> r, double rt, uint64_t rb)
+		: frame (f)
+		, position (p)
+		, results (r)
+		, receive_time (rt)
+		, received_bytes (rb)
+		, encode_time (0)
+	{}
+
+	shared_ptr<DCPVideo> frame;
+	/** position of the frame within its batch */
+	int position;
+	shared_ptr<PipelineResults> results;
+	double receive_time;
+	uint64_t received_bytes;
+	double encode_time;
+	/** encoded data, or empty if encoding failed */
+	optional<Data> encoded;
+};
+
 EncodeServer::EncodeServer (bool verbose, int num_threads)
 #if !defined(RUNNING_ON_VALGRIND) || RUNNING_ON_VALGRIND == 0
 	: Server (ENCODE_FRAME_PORT)
@@ -97,6 +140,21 @@ EncodeServer::~EncodeServer ()
 		delete i;
 	}
 
+	/* No new pipeline threads can be started now that _terminate is set and the workers have gone.
+	   The threads are probably waiting for their clients to send something, so close their sockets
+	   to stop them straight away rather than when the read times out.
+	*/
+	BOOST_FOREACH (PipelineThread& i, _pipeline_threads) {
+		i.socket->cancel ();
+	}
+
+	BOOST_FOREACH (PipelineThread& i, _pipeline_threads) {
+		if (i.thread->joinable ()) {
+			i.thread->join ();
+		}
+		delete i.thread;
+	}
+
 	{
 		boost::mutex::scoped_lock lm (_broadcast.mutex);
 		if (_broadcast.socket) {
@@ -118,13 +176,27 @@ EncodeServer::~EncodeServer ()
 	}
 }
 
-/** @param after_read Filled in with gettimeofday() after reading the input from the network.
- *  @param after_encode Filled in with gettimeofday() after encoding the image.
+/** Read an EncodingRequest (in XML or as a BinaryEncodingRequest) and the binary data that goes with it.
+ *  @param length Length word of the request, which has already been read.
+ *  @return Frame to encode, or 0 if the request used a link version that we do not understand.
  */
-int
-EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, struct timeval& after_encode)
+shared_ptr<DCPVideo>
+EncodeServer::read_request (shared_ptr<Socket> socket, uint32_t length)
 {
-	uint32_t length = socket->read_uint32 ();
+	if (length & BinaryEncodingRequest::flag) {
+		uint32_t const flags = BinaryEncodingRequest::flag | BinaryEncodingRequest::compressed_flag;
+		if ((length & ~flags) != uint32_t (BinaryEncodingRequest::length)) {
+			throw NetworkError (String::compose ("Unexpected binary encoding request length %1", length & ~flags));
+		}
+		uint8_t buffer[BinaryEncodingRequest::length];
+		socket->read (buffer, BinaryEncodingRequest::length);
+		BinaryEncodingRequest request;
+		request.read (buffer);
+		request.compressed = length & BinaryEncodingRequest::compressed_flag;
+		shared_ptr<PlayerVideo> pvf (new PlayerVideo (request, socket));
+		return shared_ptr<DCPVideo> (new DCPVideo (pvf, request));
+	}
+
 	scoped_array<char> buffer (new char[length]);
 	socket->read (reinterpret_cast<uint8_t*> (buffer.get()), length);
 
@@ -134,19 +206,32 @@ EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, st
 	/* This is a double-check; the server shouldn't even be on the candidate list
 	   if it is the wrong version, but it doesn't hurt to make sure here.
 	*/
-	if (xml->number_child<int> ("Version") != SERVER_LINK_VERSION) {
+	int const version = xml->number_child<int> ("Version");
+	if (version < SERVER_LINK_VERSION_MINIMUM || version > SERVER_LINK_VERSION) {
 		cerr << "Mismatched server/client versions\n";
 		LOG_ERROR_NC ("Mismatched server/client versions");
-		return -1;
+		return shared_ptr<DCPVideo> ();
 	}
 
 	shared_ptr<PlayerVideo> pvf (new PlayerVideo (xml, socket));
+	return shared_ptr<DCPVideo> (new DCPVideo (pvf, xml));
+}
 
-	DCPVideo dcp_video_frame (pvf, xml);
+/** @param length Length of the XML part of the request, which has already been read.
+ *  @param after_read Filled in with gettimeofday() after reading the input from the network.
+ *  @param after_encode Filled in with gettimeofday() after encoding the image.
+ */
+int
+EncodeServer::process (shared_ptr<Socket> socket, uint32_t length, struct timeval& after_read, struct timeval& after_encode)
+{
+	shared_ptr<DCPVideo> dcp_video_frame = read_request (socket, length);
+	if (!dcp_video_frame) {
+		return -1;
+	}
 
 	gettimeofday (&after_read, 0);
 
-	Data encoded = dcp_video_frame.encode_locally ();
+	Data encoded = dcp_video_frame->encode_locally ();
 
 	gettimeofday (&after_encode, 0);
 
@@ -154,12 +239,47 @@ EncodeServer::process (shared_ptr<Socket> socket, struct timeval& after_read, st
 		socket->write (encoded.size());
 		socket->write (encoded.data().get(), encoded.size());
 	} catch (std::exception& e) {
-		cerr << "Send failed; frame " << dcp_video_frame.index() << "\n";
-		LOG_ERROR ("Send failed; frame %1", dcp_video_frame.index());
+		cerr << "Send failed; frame " << dcp_video_frame->index() << "\n";
+		LOG_ERROR ("Send failed; frame %1", dcp_video_frame->index());
 		throw;
 	}
 
-	return dcp_video_frame.index ();
+	return dcp_video_frame->index ();
+}
+
+/** Encode a frame from a pipelined connection and pass it back to the thread
+ *  which is looking after that connection.
+ */
+void
+EncodeServer::process_pipelined (shared_ptr<PipelinedFrame> frame)
+{
+	{
+		boost::mutex::scoped_lock lm (frame->results->mutex);
+		if (frame->results->abandoned) {
+			return;
+		}
+	}
+
+	struct timeval start;
+	struct timeval after_encode;
+
+	gettimeofday (&start, 0);
+
+	try {
+		frame->encoded = frame->frame->encode_locally ();
+	} catch (std::exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		LOG_ERROR ("Error: %1", e.what());
+	}
+
+	gettimeofday (&after_encode, 0);
+	frame->encode_time = seconds(after_encode) - seconds(start);
+
+	boost::mutex::scoped_lock lm (frame->results->mutex);
+	if (!frame->results->abandoned) {
+		frame->results->done.push_back (frame);
+		frame->results->condition.notify_all ();
+	}
 }
 
 void
@@ -167,7 +287,7 @@ EncodeServer::worker_thread ()
 {
 	while (true) {
 		boost::mutex::scoped_lock lock (_mutex);
-		while (_queue.empty () && !_terminate) {
+		while (_queue.empty () && _frames.empty () && !_terminate) {
 			_empty_condition.wait (lock);
 		}
 
@@ -175,6 +295,15 @@ EncodeServer::worker_thread ()
 			return;
 		}
 
+		if (!_frames.empty ()) {
+			/* Frames from pipelined connections go first as their batches have already been accepted */
+			shared_ptr<PipelinedFrame> frame = _frames.front ();
+			_frames.pop_front ();
+			lock.unlock ();
+			process_pipelined (frame);
+			continue;
+		}
+
 		shared_ptr<Socket> socket = _queue.front ();
 		_queue.pop_front ();
 
@@ -182,6 +311,7 @@ EncodeServer::worker_thread ()
 
 		int frame = -1;
 		string ip;
+		uint64_t received_bytes = 0;
 
 		struct timeval start;
 		struct timeval after_read;
@@ -191,8 +321,15 @@ EncodeServer::worker_thread ()
 		gettimeofday (&start, 0);
 
 		try {
-			frame = process (socket, after_read, after_encode);
-			ip = socket->socket().remote_endpoint().address().to_string();
+			uint32_t const length = socket->read_uint32 ();
+			if (length == 0) {
+				/* This can't be a real request, so it must be the start of a pipelined connection */
+				start_pipeline (socket);
+			} else {
+				frame = process (socket, length, after_read, after_encode);
+				ip = socket->socket().remote_endpoint().address().to_string();
+				received_bytes = socket->read_bytes ();
+			}
 		} catch (std::exception& e) {
 			cerr << "Error: " << e.what() << "\n";
 			LOG_ERROR ("Error: %1", e.what());
@@ -213,7 +350,8 @@ EncodeServer::worker_thread ()
 					frame, ip,
 					seconds(after_read) - seconds(start),
 					seconds(after_encode) - seconds(after_read),
-					seconds(end) - seconds(after_encode)
+					seconds(end) - seconds(after_encode),
+					received_bytes
 					)
 				);
 
@@ -228,6 +366,147 @@ EncodeServer::worker_thread ()
 	}
 }
 
+/** Start a thread to look after a pipelined connection */
+void
+EncodeServer::start_pipeline (shared_ptr<Socket> socket)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	/* Tidy up threads for connections which have closed */
+	BOOST_FOREACH (boost::thread::id i, _finished_pipeline_threads) {
+		for (list<PipelineThread>::iterator j = _pipeline_threads.begin(); j != _pipeline_threads.end(); ++j) {
+			if (j->thread->get_id() == i) {
+				j->thread->join ();
+				delete j->thread;
+				_pipeline_threads.erase (j);
+				break;
+			}
+		}
+	}
+	_finished_pipeline_threads.clear ();
+
+	if (_terminate) {
+		return;
+	}
+
+	thread* t = new thread (bind (&EncodeServer::pipeline_thread, this, socket));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (t->native_handle(), "encode-server-pipeline");
+#endif
+	_pipeline_threads.push_back (PipelineThread (t, socket));
+}
+
+/** Look after a pipelined connection; see EncodeServerConnection for a description of the protocol */
+void
+EncodeServer::pipeline_thread (shared_ptr<Socket> socket)
+{
+	shared_ptr<PipelineResults> results;
+
+	try {
+		string const ip = socket->socket().remote_endpoint().address().to_string();
+
+		int const version = socket->read_uint32 ();
+		if (version < SERVER_LINK_VERSION_PIPELINED || version > SERVER_LINK_VERSION) {
+			socket->write (0);
+			throw NetworkError (String::compose ("client %1 asked for unsupported link version %2", ip, version));
+		}
+		socket->write (version);
+
+		if (_verbose) {
+			cout << "Pipelined connection from " << ip << "\n";
+		}
+
+		while (true) {
+			uint32_t const count = socket->read_uint32 ();
+			if (count == 0 || count > maximum_pipelined_batch) {
+				throw NetworkError (String::compose ("bad batch size %1 from %2", count, ip));
+			}
+
+			results.reset (new PipelineResults);
+
+			/* Read the batch, giving each frame to the workers as soon as we have it */
+			for (uint32_t i = 0; i < count; ++i) {
+				struct timeval start;
+				gettimeofday (&start, 0);
+				uint64_t const read_before = socket->read_bytes ();
+				shared_ptr<DCPVideo> frame = read_request (socket, socket->read_uint32 ());
+				if (!frame) {
+					throw NetworkError (String::compose ("bad request from %1", ip));
+				}
+				struct timeval after_read;
+				gettimeofday (&after_read, 0);
+
+				boost::mutex::scoped_lock lm (_mutex);
+				_frames.push_back (shared_ptr<PipelinedFrame> (new PipelinedFrame (frame, i, results, seconds(after_read) - seconds(start), socket->read_bytes() - read_before)));
+				_empty_condition.notify_all ();
+			}
+
+			/* Send the frames back as they are finished */
+			for (uint32_t i = 0; i < count; ++i) {
+				shared_ptr<PipelinedFrame> frame;
+				while (!frame) {
+					{
+						boost::mutex::scoped_lock lm (results->mutex);
+						if (results->done.empty ()) {
+							results->condition.timed_wait (lm, boost::posix_time::seconds (1));
+						}
+						if (!results->done.empty ()) {
+							frame = results->done.front ();
+							results->done.pop_front ();
+						}
+					}
+
+					boost::mutex::scoped_lock lm (_mutex);
+					if (_terminate) {
+						throw NetworkError ("server is stopping");
+					}
+				}
+
+				if (!frame->encoded) {
+					throw EncodeError (String::compose ("could not encode frame %1 for %2", frame->frame->index(), ip));
+				}
+
+				struct timeval start;
+				gettimeofday (&start, 0);
+
+				socket->write (frame->position);
+				socket->write (frame->encoded->size());
+				socket->write (frame->encoded->data().get(), frame->encoded->size());
+
+				struct timeval end;
+				gettimeofday (&end, 0);
+
+				shared_ptr<EncodedLogEntry> e (
+					new EncodedLogEntry (
+						frame->frame->index(), ip, frame->receive_time, frame->encode_time, seconds(end) - seconds(start), frame->received_bytes
+						)
+					);
+
+				if (_verbose) {
+					cout << e->get() << "\n";
+				}
+
+				dcpomatic_log->log (e);
+			}
+
+			results.reset ();
+		}
+	} catch (std::exception& e) {
+		/* Most likely the client closed the connection */
+		LOG_GENERAL ("Pipelined connection finished: %1", e.what());
+	}
+
+	if (results) {
+		/* Stop the workers bothering with anything else from this batch */
+		boost::mutex::scoped_lock lm (results->mutex);
+		results->abandoned = true;
+		results->done.clear ();
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_finished_pipeline_threads.push_back (boost::this_thread::get_id ());
+}
+
 void
 EncodeServer::run ()
 {
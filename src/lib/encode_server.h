@@ -34,6 +34,8 @@
 
 class Socket;
 class Log;
+class DCPVideo;
+struct PipelinedFrame;
 
 /** @class EncodeServer
  *  @brief A class to run a server which can accept requests to perform JPEG2000
@@ -50,12 +52,34 @@ public:
 private:
 	void handle (boost::shared_ptr<Socket>);
 	void worker_thread ();
-	int process (boost::shared_ptr<Socket> socket, struct timeval &, struct timeval &);
+	int process (boost::shared_ptr<Socket> socket, uint32_t length, struct timeval &, struct timeval &);
+	void process_pipelined (boost::shared_ptr<PipelinedFrame> frame);
+	boost::shared_ptr<DCPVideo> read_request (boost::shared_ptr<Socket> socket, uint32_t length);
+	void start_pipeline (boost::shared_ptr<Socket> socket);
+	void pipeline_thread (boost::shared_ptr<Socket> socket);
 	void broadcast_thread ();
 	void broadcast_received ();
 
 	std::vector<boost::thread *> _worker_threads;
 	std::list<boost::shared_ptr<Socket> > _queue;
+	/** frames from pipelined connections which are waiting to be encoded */
+	std::list<boost::shared_ptr<PipelinedFrame> > _frames;
+	struct PipelineThread
+	{
+		PipelineThread (boost::thread* t, boost::shared_ptr<Socket> s)
+			: thread (t)
+			, socket (s)
+		{}
+
+		boost::thread* thread;
+		/** the connection that the thread is looking after */
+		boost::shared_ptr<Socket> socket;
+	};
+
+	/** threads which are looking after pipelined connections */
+	std::list<PipelineThread> _pipeline_threads;
+	/** IDs of threads in _pipeline_threads which have finished and can be joined */
+	std::list<boost::thread::id> _finished_pipeline_threads;
 	boost::condition _full_condition;
 	boost::condition _empty_condition;
 	bool _verbose;
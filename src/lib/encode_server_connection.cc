@@ -0,0 +1,128 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/encode_server_connection.cc
+ *  @brief EncodeServerConnection class.
+ */
+
+#include "encode_server_connection.h"
+#include "dcpomatic_socket.h"
+#include "dcp_video.h"
+#include "exceptions.h"
+#include "config.h"
+#include "dcpomatic_log.h"
+#include "compose.hpp"
+#include <dcp/raw_convert.h>
+#include <boost/asio.hpp>
+
+#include "i18n.h"
+
+using std::string;
+using std::vector;
+using std::min;
+using boost::shared_ptr;
+using dcp::Data;
+using dcp::raw_convert;
+
+/** Number of seconds after which we stop trusting an idle connection; servers give up on
+ *  connections which have not been used for their timeout (usually 30s).
+ */
+static int const maximum_idle = 10;
+
+/** @param server Server to connect to; its link version must be at least SERVER_LINK_VERSION_PIPELINED.
+ *  @param timeout Timeout in seconds for each network operation.
+ */
+EncodeServerConnection::EncodeServerConnection (EncodeServerDescription server, int timeout)
+	: _server (server)
+	, _timeout (timeout)
+	, _link_version (0)
+	, _last_used (0)
+{
+
+}
+
+void
+EncodeServerConnection::connect ()
+{
+	_socket.reset ();
+
+	boost::asio::io_service io_service;
+	boost::asio::ip::tcp::resolver resolver (io_service);
+	boost::asio::ip::tcp::resolver::query query (_server.host_name(), raw_convert<string> (ENCODE_FRAME_PORT));
+	boost::asio::ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve (query);
+
+	shared_ptr<Socket> socket (new Socket (_timeout));
+	socket->connect (*endpoint_iterator);
+
+	int const wanted = min (_server.link_version(), SERVER_LINK_VERSION);
+	socket->write (0);
+	socket->write (wanted);
+	if (int (socket->read_uint32 ()) != wanted) {
+		throw NetworkError (String::compose (_("%1 refused a pipelined connection"), _server.host_name ()));
+	}
+
+	LOG_GENERAL ("Opened pipelined connection to %1 with link version %2", _server.host_name(), wanted);
+
+	_socket = socket;
+	_link_version = wanted;
+}
+
+/** Encode some frames on the server, blocking until they have all come back.
+ *  If anything goes wrong an exception is thrown and the connection is closed;
+ *  it will be opened again by the next call.
+ *  @param frames Frames to encode.
+ *  @param handler Called with each frame and its encoded data, in the order in which the
+ *  server finishes them.  Frames for which this has not been called when an exception
+ *  is thrown have not been encoded.
+ */
+void
+EncodeServerConnection::encode (vector<shared_ptr<DCPVideo> > const & frames, boost::function<void (shared_ptr<DCPVideo>, Data)> handler)
+{
+	/* The server will give up on a connection that has been idle for too long;
+	   be sure to open a new one before that happens.
+	*/
+	if (!_socket || (time (0) - _last_used) > maximum_idle) {
+		connect ();
+	}
+
+	try {
+		_socket->write (frames.size ());
+		for (vector<shared_ptr<DCPVideo> >::const_iterator i = frames.begin(); i != frames.end(); ++i) {
+			(*i)->send_request (_socket, _link_version);
+		}
+
+		vector<bool> done (frames.size(), false);
+		for (size_t i = 0; i < frames.size(); ++i) {
+			uint32_t const position = _socket->read_uint32 ();
+			if (position >= frames.size() || done[position]) {
+				throw NetworkError (String::compose (_("unexpected response from %1"), _server.host_name ()));
+			}
+			Data e (_socket->read_uint32 ());
+			_socket->read (e.data().get(), e.size());
+			done[position] = true;
+			handler (frames[position], e);
+		}
+	} catch (...) {
+		_socket.reset ();
+		throw;
+	}
+
+	_last_used = time (0);
+}
@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_ENCODE_SERVER_CONNECTION_H
+#define DCPOMATIC_ENCODE_SERVER_CONNECTION_H
+
+/** @file  src/lib/encode_server_connection.h
+ *  @brief EncodeServerConnection class.
+ */
+
+#include "encode_server_description.h"
+#include <dcp/data.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+#include <ctime>
+
+class DCPVideo;
+class Socket;
+
+/** @class EncodeServerConnection
+ *  @brief A connection to an EncodeServer which is kept open and which can
+ *  have several frames in flight at once.
+ *
+ *  The protocol, used with servers whose link version is at least
+ *  SERVER_LINK_VERSION_PIPELINED, is:
+ *
+ *  - we send a uint32 0 (which can never be the length of a normal
+ *    EncodingRequest) followed by the link version that we want to speak.
+ *  - the server replies with that version if it accepts it, otherwise 0.
+ *
+ *  Then, for each batch of frames:
+ *
+ *  - we send a uint32 count followed by that many requests, each of which is
+ *    the same as a request for a one-off connection.
+ *  - the server encodes the frames in parallel as they arrive, and once it
+ *    has read the whole batch it sends each frame back as it is finished:
+ *    uint32 position of the frame in the batch, uint32 length, J2K data.
+ *
+ *  Each side is only ever either reading or writing, which is what Socket
+ *  needs.  To keep the server busy while one batch is being sent back its
+ *  client should have two of these connections open.
+ */
+class EncodeServerConnection : public boost::noncopyable
+{
+public:
+	EncodeServerConnection (EncodeServerDescription server, int timeout = 30);
+
+	void encode (
+		std::vector<boost::shared_ptr<DCPVideo> > const & frames,
+		boost::function<void (boost::shared_ptr<DCPVideo>, dcp::Data)> handler
+		);
+
+	/** @return the link version that we agreed with the server, or 0 if we are not connected */
+	int link_version () const {
+		return _socket ? _link_version : 0;
+	}
+
+private:
+	void connect ();
+
+	EncodeServerDescription _server;
+	int _timeout;
+	boost::shared_ptr<Socket> _socket;
+	int _link_version;
+	/** time that _socket was last used */
+	time_t _last_used;
+};
+
+#endif
@@ -60,8 +60,19 @@ public:
 		return _threads;
 	}
 
+	/** @return true if we can talk to this server */
 	bool current_link_version () const {
-		return _link_version == SERVER_LINK_VERSION;
+		return _link_version >= SERVER_LINK_VERSION_MINIMUM && _link_version <= SERVER_LINK_VERSION;
+	}
+
+	/** @return server link (i.e. protocol) version number */
+	int link_version () const {
+		return _link_version;
+	}
+
+	/** @return true if this server can accept an EncodeServerConnection */
+	bool pipelined () const {
+		return _link_version >= SERVER_LINK_VERSION_PIPELINED;
 	}
 
 	void set_host_name (std::string n) {
@@ -80,6 +91,15 @@ public:
 		return boost::posix_time::time_duration(boost::posix_time::second_clock::local_time() - _last_seen).total_seconds();
 	}
 
+	/** @return true if o describes the same server with the same settings; when it was last seen is ignored */
+	bool operator== (EncodeServerDescription const & o) const {
+		return _host_name == o._host_name && _threads == o._threads && _link_version == o._link_version;
+	}
+
+	bool operator!= (EncodeServerDescription const & o) const {
+		return !(*this == o);
+	}
+
 private:
 	/** server's host name */
 	std::string _host_name;
@@ -0,0 +1,289 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/encode_server_throughput.cc
+ *  @brief EncodeServerThroughput class.
+ */
+
+#include "encode_server_throughput.h"
+#include "event_history.h"
+#include "dcpomatic_log.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+
+#include "i18n.h"
+
+using std::map;
+using std::min;
+using std::max;
+using std::make_pair;
+using std::sort;
+using std::string;
+using std::vector;
+using boost::optional;
+
+EncodeServerThroughput::Server::Server (int t, int history_size)
+	: threads (t)
+	, in_flight (0)
+	, average_in_flight (-1)
+	, history (new EventHistory (history_size))
+{
+
+}
+
+/** @param history_size Number of finished frames to measure each server's throughput over */
+EncodeServerThroughput::EncodeServerThroughput (int history_size)
+	: _history_size (history_size)
+{
+
+}
+
+/** Set the servers that we are using.  Measurements for servers that are already
+ *  known are kept, and anything not in \p threads is forgotten.
+ *  @param threads Number of frames that each server can encode at once, keyed by host name.
+ */
+void
+EncodeServerThroughput::set_servers (map<string, int> threads)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, Server>::iterator i = _servers.begin ();
+	while (i != _servers.end()) {
+		map<string, Server>::iterator j = i;
+		++i;
+		if (threads.find (j->first) == threads.end()) {
+			_logged_slow.erase (j->first);
+			_servers.erase (j);
+		}
+	}
+
+	for (map<string, int>::const_iterator i = threads.begin(); i != threads.end(); ++i) {
+		map<string, Server>::iterator j = _servers.find (i->first);
+		if (j == _servers.end()) {
+			_servers.insert (make_pair (i->first, Server (i->second, _history_size)));
+		} else {
+			j->second.threads = i->second;
+		}
+	}
+
+	_condition.notify_all ();
+}
+
+/** Reserve some frames for a server, blocking until it is allowed at least one more.
+ *  This is a boost::thread interruption point.
+ *  @param wanted Maximum number of frames to reserve.
+ *  @return Number of frames reserved, which must be given back with frame_done() or release().
+ */
+int
+EncodeServerThroughput::reserve (string server, int wanted)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (true) {
+		map<string, Server>::iterator i = _servers.find (server);
+		if (i == _servers.end()) {
+			/* We know nothing of this server, so there is nothing to limit */
+			return wanted;
+		}
+
+		int const n = min (wanted, allowed (server, i->second) - i->second.in_flight);
+		if (n > 0) {
+			i->second.in_flight += n;
+			return n;
+		}
+
+		_condition.wait (lm);
+	}
+}
+
+/** As reserve(), but never blocks.
+ *  @return Number of frames reserved, which may be 0.
+ */
+int
+EncodeServerThroughput::try_reserve (string server, int wanted)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, Server>::iterator i = _servers.find (server);
+	if (i == _servers.end()) {
+		return wanted;
+	}
+
+	int const n = max (0, min (wanted, allowed (server, i->second) - i->second.in_flight));
+	i->second.in_flight += n;
+	return n;
+}
+
+/** Give back frames which were reserved but which were not encoded */
+void
+EncodeServerThroughput::release (string server, int frames)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, Server>::iterator i = _servers.find (server);
+	if (i != _servers.end()) {
+		i->second.in_flight = max (0, i->second.in_flight - frames);
+	}
+
+	_condition.notify_all ();
+}
+
+/** Note that a server has finished a frame which was reserved for it */
+void
+EncodeServerThroughput::frame_done (string server)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, Server>::iterator i = _servers.find (server);
+	if (i == _servers.end()) {
+		return;
+	}
+
+	Server& s = i->second;
+	if (s.average_in_flight < 0) {
+		s.average_in_flight = s.in_flight;
+	} else {
+		s.average_in_flight = s.average_in_flight * 0.9 + s.in_flight * 0.1;
+	}
+	s.history->event ();
+	s.in_flight = max (0, s.in_flight - 1);
+
+	bool const is_slow = slow (server, s);
+	bool const was_slow = _logged_slow.find (server) != _logged_slow.end ();
+	if (is_slow && !was_slow) {
+		LOG_GENERAL (
+			N_("Encode server %1 is slow (%2s per frame, against %3s typically); allowing it %4 frames at once"),
+			server, latency(s).get(), median_latency().get(), allowed(server, s)
+			);
+		_logged_slow.insert (server);
+	} else if (!is_slow && was_slow) {
+		LOG_GENERAL (N_("Encode server %1 is no longer slow"), server);
+		_logged_slow.erase (server);
+	}
+
+	_condition.notify_all ();
+}
+
+/** @return Time in seconds that a frame spends on a server, if we know it; must be called with _mutex held */
+optional<float>
+EncodeServerThroughput::latency (Server const & server) const
+{
+	/* By Little's law the time spent on the server is the number of frames
+	   there divided by the rate at which they are leaving.
+	*/
+	float const rate = server.history->rate ();
+	if (rate <= 0 || server.average_in_flight <= 0) {
+		return optional<float> ();
+	}
+
+	return server.average_in_flight / rate;
+}
+
+/** @return Median of the latencies that we know, if any; must be called with _mutex held */
+optional<float>
+EncodeServerThroughput::median_latency () const
+{
+	vector<float> all;
+	for (map<string, Server>::const_iterator i = _servers.begin(); i != _servers.end(); ++i) {
+		optional<float> l = latency (i->second);
+		if (l) {
+			all.push_back (l.get ());
+		}
+	}
+
+	if (all.empty ()) {
+		return optional<float> ();
+	}
+
+	sort (all.begin(), all.end());
+	return all[(all.size() - 1) / 2];
+}
+
+/** Must be called with _mutex held */
+bool
+EncodeServerThroughput::slow (string name, Server const & server) const
+{
+	if (name.empty ()) {
+		/* Local encoding is never slow; there's nothing else it could be doing */
+		return false;
+	}
+
+	optional<float> l = latency (server);
+	optional<float> m = median_latency ();
+	return l && m && l.get() > m.get() * 2;
+}
+
+/** @return Number of frames that a server may have at once; must be called with _mutex held */
+int
+EncodeServerThroughput::allowed (string name, Server const & server) const
+{
+	if (!slow (name, server)) {
+		return server.threads;
+	}
+
+	/* Allow as many frames as the server could finish in twice the median time if it were fully loaded */
+	float const capacity = server.threads / latency(server).get();
+	return max (1, min (server.threads, int (lrintf (capacity * median_latency().get() * 2))));
+}
+
+/** @return Number of frames that a server may have at once, or 0 if it is unknown */
+int
+EncodeServerThroughput::allowed (string server) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, Server>::const_iterator i = _servers.find (server);
+	if (i == _servers.end()) {
+		return 0;
+	}
+
+	return allowed (server, i->second);
+}
+
+/** @return Time in seconds that a frame usually spends on a server, if we know it */
+optional<float>
+EncodeServerThroughput::latency (string server) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, Server>::const_iterator i = _servers.find (server);
+	if (i == _servers.end()) {
+		return optional<float> ();
+	}
+
+	return latency (i->second);
+}
+
+/** @return Host names of servers which are currently slow */
+vector<string>
+EncodeServerThroughput::slow_servers () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	vector<string> s;
+	for (map<string, Server>::const_iterator i = _servers.begin(); i != _servers.end(); ++i) {
+		if (slow (i->first, i->second)) {
+			s.push_back (i->first);
+		}
+	}
+
+	return s;
+}
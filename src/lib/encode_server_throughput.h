@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_ENCODE_SERVER_THROUGHPUT_H
+#define DCPOMATIC_ENCODE_SERVER_THROUGHPUT_H
+
+/** @file  src/lib/encode_server_throughput.h
+ *  @brief EncodeServerThroughput class.
+ */
+
+#include <boost/shared_ptr.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class EventHistory;
+
+/** @class EncodeServerThroughput
+ *  @brief Measurements of how quickly each encode server is getting through
+ *  its frames, which are used to decide how many frames it may have in flight.
+ *
+ *  For each server we keep an EventHistory of completed frames, giving its
+ *  throughput, and an average of the number of frames that it had in flight.
+ *  Dividing the second by the first gives the time that a frame spends on the
+ *  server.  A server whose frames take more than twice as long as the median
+ *  is slow; it is allowed only as many frames as it can finish in twice the
+ *  median time, so that it holds on to fewer frames that the Writer is waiting for.
+ *
+ *  Local encoding is counted as a server whose name is the empty string, so
+ *  that it contributes to the median, but it is never limited.
+ */
+class EncodeServerThroughput : public boost::noncopyable
+{
+public:
+	explicit EncodeServerThroughput (int history_size = 16);
+
+	void set_servers (std::map<std::string, int> threads);
+
+	int reserve (std::string server, int wanted);
+	int try_reserve (std::string server, int wanted);
+	void release (std::string server, int frames);
+	void frame_done (std::string server);
+
+	int allowed (std::string server) const;
+	boost::optional<float> latency (std::string server) const;
+	std::vector<std::string> slow_servers () const;
+
+private:
+	struct Server
+	{
+		Server (int t, int history_size);
+
+		/** number of frames that the server can encode at once */
+		int threads;
+		/** number of frames that are reserved for the server */
+		int in_flight;
+		/** moving average of in_flight, taken as each frame is finished, or
+		 *  negative if no frames have been finished yet.
+		 */
+		float average_in_flight;
+		boost::shared_ptr<EventHistory> history;
+	};
+
+	boost::optional<float> latency (Server const & server) const;
+	boost::optional<float> median_latency () const;
+	bool slow (std::string name, Server const & server) const;
+	int allowed (std::string name, Server const & server) const;
+
+	/** mutex for _servers */
+	mutable boost::mutex _mutex;
+	std::map<std::string, Server> _servers;
+	/** servers which we have logged as slow */
+	std::set<std::string> _logged_slow;
+	/** condition to wake reserve() when frames are released */
+	boost::condition _condition;
+	int const _history_size;
+};
+
+#endif
@@ -20,16 +20,18 @@
 
 #include "encoded_log_entry.h"
 #include <cstdio>
+#include <inttypes.h>
 
 using std::string;
 
-EncodedLogEntry::EncodedLogEntry (int frame, string ip, double receive, double encode, double send)
+EncodedLogEntry::EncodedLogEntry (int frame, string ip, double receive, double encode, double send, uint64_t received_bytes)
 	: LogEntry (LogEntry::TYPE_GENERAL)
 	, _frame (frame)
 	, _ip (ip)
 	, _receive (receive)
 	, _encode (encode)
 	, _send (send)
+	, _received_bytes (received_bytes)
 {
 
 }
@@ -38,6 +40,8 @@ string
 EncodedLogEntry::message () const
 {
 	char buffer[256];
-	snprintf (buffer, sizeof(buffer), "Encoded frame %d from %s: receive %.2fs encode %.2fs send %.2fs.", _frame, _ip.c_str(), _receive, _encode, _send);
+	snprintf (buffer, sizeof(buffer), "Encoded frame %d from %s: receive %.2fs (%" PRIu64 " bytes) encode %.2fs send %.2fs.",
+		_frame, _ip.c_str(), _receive, _received_bytes, _encode, _send
+		);
 	return buffer;
 }
@@ -19,11 +19,12 @@
 */
 
 #include "log_entry.h"
+#include <stdint.h>
 
 class EncodedLogEntry : public LogEntry
 {
 public:
-	EncodedLogEntry (int frame, std::string ip, double receive, double encode, double send);
+	EncodedLogEntry (int frame, std::string ip, double receive, double encode, double send, uint64_t received_bytes);
 
 	std::string message () const;
 
@@ -33,4 +34,5 @@ private:
 	double _receive;
 	double _encode;
 	double _send;
+	uint64_t _received_bytes;
 };
@@ -25,6 +25,8 @@
 #include "player_text.h"
 #include <boost/weak_ptr.hpp>
 #include <boost/signals2.hpp>
+#include <string>
+#include <vector>
 
 class Film;
 class Encoder;
@@ -44,6 +46,10 @@ public:
 
 	/** @return the current frame rate over the last short while */
 	virtual float current_rate () const = 0;
+	/** @return host names of any encode servers which are much slower than the others */
+	virtual std::vector<std::string> slow_servers () const {
+		return std::vector<std::string> ();
+	}
 	/** @return the number of frames that are done */
 	virtual Frame frames_done () const = 0;
 	virtual bool finishing () const = 0;
@@ -0,0 +1,201 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/fader.cc
+ *  @brief Fader class.
+ */
+
+#include "fader.h"
+#include "dcpomatic_assert.h"
+
+#ifdef DCPOMATIC_X86
+#include <emmintrin.h>
+#endif
+
+static uint16_t
+swap_16 (uint16_t v)
+{
+	return ((v >> 8) & 0xff) | ((v & 0xff) << 8);
+}
+
+/** @return The fastest kernel that this CPU can use */
+Fader::Kernel
+Fader::best_kernel ()
+{
+	return SIMDKernels::best_kernel (KERNEL_SSE2);
+}
+
+/** Fade some 8-bit samples.
+ *  @param p First sample.
+ *  @param n Number of samples.
+ *  @param f Amount to fade by; 0 is black, 1 is no fade.
+ *  @param kernel Kernel to use, which must be supported().
+ */
+void
+Fader::fade_8 (uint8_t* p, int n, float f, Kernel kernel)
+{
+	DCPOMATIC_ASSERT (supported (kernel));
+
+	int done = 0;
+	if (kernel >= KERNEL_SSE2) {
+		done = fade_8_sse2 (p, n, f);
+	}
+
+	fade_8_scalar (p + done, n - done, f);
+}
+
+/** Fade some 16-bit samples.
+ *  @param p First sample.
+ *  @param n Number of samples.
+ *  @param f Amount to fade by; 0 is black, 1 is no fade.
+ *  @param big_endian true if the samples are big-endian, false if they are little-endian.
+ *  @param kernel Kernel to use, which must be supported().
+ */
+void
+Fader::fade_16 (uint16_t* p, int n, float f, bool big_endian, Kernel kernel)
+{
+	DCPOMATIC_ASSERT (supported (kernel));
+
+	int done = 0;
+	if (kernel >= KERNEL_SSE2) {
+		done = fade_16_sse2 (p, n, f, big_endian);
+	}
+
+	fade_16_scalar (p + done, n - done, f, big_endian);
+}
+
+void
+Fader::fade_8_scalar (uint8_t* p, int n, float f)
+{
+	for (int i = 0; i < n; ++i) {
+		p[i] = int (float (p[i]) * f);
+	}
+}
+
+void
+Fader::fade_16_scalar (uint16_t* p, int n, float f, bool big_endian)
+{
+	if (big_endian) {
+		for (int i = 0; i < n; ++i) {
+			p[i] = swap_16 (int (float (swap_16 (p[i])) * f));
+		}
+	} else {
+		for (int i = 0; i < n; ++i) {
+			p[i] = int (float (p[i]) * f);
+		}
+	}
+}
+
+/* The SSE2 versions below multiply in single precision and truncate, as the scalar ones do
+   (see SIMDKernels).  They return the number of samples that they did, leaving
+   the rest for the scalar versions.  Fades outside [0, 1] are all left to the scalar versions,
+   as they would need the scalar versions' wrapping of out-of-range values.
+*/
+
+#ifdef DCPOMATIC_X86
+
+/** @param v 4 samples as 32-bit integers */
+__attribute__((target("sse2")))
+static inline __m128i
+fade_32 (__m128i v, __m128 f)
+{
+	return _mm_cvttps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (v), f));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+swap_16_sse2 (__m128i v)
+{
+	return _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+}
+
+__attribute__((target("sse2")))
+int
+Fader::fade_8_sse2 (uint8_t* p, int n, float f)
+{
+	if (f < 0 || f > 1) {
+		return 0;
+	}
+
+	__m128 const factor = _mm_set1_ps (f);
+	__m128i const zero = _mm_setzero_si128 ();
+
+	int i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i* q = reinterpret_cast<__m128i*> (p + i);
+		__m128i const v = _mm_loadu_si128 (q);
+		__m128i const lo = _mm_unpacklo_epi8 (v, zero);
+		__m128i const hi = _mm_unpackhi_epi8 (v, zero);
+		__m128i const a = _mm_packs_epi32 (fade_32 (_mm_unpacklo_epi16 (lo, zero), factor), fade_32 (_mm_unpackhi_epi16 (lo, zero), factor));
+		__m128i const b = _mm_packs_epi32 (fade_32 (_mm_unpacklo_epi16 (hi, zero), factor), fade_32 (_mm_unpackhi_epi16 (hi, zero), factor));
+		_mm_storeu_si128 (q, _mm_packus_epi16 (a, b));
+	}
+
+	return i;
+}
+
+__attribute__((target("sse2")))
+int
+Fader::fade_16_sse2 (uint16_t* p, int n, float f, bool big_endian)
+{
+	if (f < 0 || f > 1) {
+		return 0;
+	}
+
+	__m128 const factor = _mm_set1_ps (f);
+	__m128i const zero = _mm_setzero_si128 ();
+	/* SSE2 can only pack 32-bit values into signed 16-bit ones, so offset them into that range and back */
+	__m128i const offset_32 = _mm_set1_epi32 (32768);
+	__m128i const offset_16 = _mm_set1_epi16 (-32768);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i* q = reinterpret_cast<__m128i*> (p + i);
+		__m128i v = _mm_loadu_si128 (q);
+		if (big_endian) {
+			v = swap_16_sse2 (v);
+		}
+		__m128i const a = _mm_sub_epi32 (fade_32 (_mm_unpacklo_epi16 (v, zero), factor), offset_32);
+		__m128i const b = _mm_sub_epi32 (fade_32 (_mm_unpackhi_epi16 (v, zero), factor), offset_32);
+		__m128i r = _mm_add_epi16 (_mm_packs_epi32 (a, b), offset_16);
+		if (big_endian) {
+			r = swap_16_sse2 (r);
+		}
+		_mm_storeu_si128 (q, r);
+	}
+
+	return i;
+}
+
+#else
+
+int
+Fader::fade_8_sse2 (uint8_t *, int, float)
+{
+	return 0;
+}
+
+int
+Fader::fade_16_sse2 (uint16_t *, int, float, bool)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_FADER_H
+#define DCPOMATIC_FADER_H
+
+/** @file  src/lib/fader.h
+ *  @brief Fader class.
+ */
+
+#include "simd_kernels.h"
+#include <stdint.h>
+
+/** @class Fader
+ *  @brief Scaling of runs of 8- or 16-bit samples towards zero, for Image::fade.
+ *
+ *  Samples are done 16 or 8 at a time using SSE2 where the CPU has it.
+ */
+class Fader : public SIMDKernels
+{
+public:
+	static void fade_8 (uint8_t* p, int n, float f, Kernel kernel = best_kernel());
+	static void fade_16 (uint16_t* p, int n, float f, bool big_endian, Kernel kernel = best_kernel());
+
+	static Kernel best_kernel ();
+
+private:
+	static void fade_8_scalar (uint8_t* p, int n, float f);
+	static void fade_16_scalar (uint16_t* p, int n, float f, bool big_endian);
+	static int fade_8_sse2 (uint8_t* p, int n, float f);
+	static int fade_16_sse2 (uint16_t* p, int n, float f, bool big_endian);
+};
+
+#endif
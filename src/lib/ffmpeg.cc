@@ -211,6 +211,12 @@ FFmpeg::setup_decoders ()
 			/* Enable following of links in files */
 			av_dict_set_int (&options, "enable_drefs", 1, 0);
 
+			/* Have the decoder give us references to its frames, which we must unref
+			   when we have finished with them; this means that Image can use their
+			   data in place rather than copying it.
+			*/
+			context->refcounted_frames = 1;
+
 			if (avcodec_open2 (context, codec, &options) < 0) {
 				throw DecodeError (N_("could not open decoder"));
 			}
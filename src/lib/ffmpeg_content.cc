@@ -472,6 +472,19 @@ FFmpegContent::identifier () const
 	return s;
 }
 
+string
+FFmpegContent::image_identifier () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	string s;
+	for (vector<Filter const *>::const_iterator i = _filters.begin(); i != _filters.end(); ++i) {
+		s += "_" + (*i)->id ();
+	}
+
+	return s;
+}
+
 void
 FFmpegContent::set_default_colour_conversion ()
 {
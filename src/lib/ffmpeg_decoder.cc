@@ -478,6 +478,8 @@ FFmpegDecoder::decode_audio_packet ()
 			if (ct >= ContentTime() && data->frames() > 0) {
 				audio->emit (film(), *stream, data, ct);
 			}
+
+			av_frame_unref (_frame);
 		}
 
 		copy_packet.data += decode_result;
@@ -515,6 +517,8 @@ FFmpegDecoder::decode_video_packet ()
 	}
 
 	list<pair<shared_ptr<Image>, int64_t> > images = graph->process (_frame);
+	/* The images have their own references to any of _frame's data that they use */
+	av_frame_unref (_frame);
 
 	for (list<pair<shared_ptr<Image>, int64_t> >::iterator i = images.begin(); i != images.end(); ++i) {
 
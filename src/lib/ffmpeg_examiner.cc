@@ -186,6 +186,7 @@ FFmpegExaminer::video_packet (AVCodecContext* context)
 				_format_context->streams[_video_stream.get()]
 				).get_value_or (ContentTime ()).frames_round (video_frame_rate().get ());
 		}
+		av_frame_unref (_frame);
 	}
 }
 
@@ -199,6 +200,7 @@ FFmpegExaminer::audio_packet (AVCodecContext* context, shared_ptr<FFmpegAudioStr
 	int frame_finished;
 	if (avcodec_decode_audio4 (context, _frame, &frame_finished, &_packet) >= 0 && frame_finished) {
 		stream->first_audio = frame_time (stream->stream (_format_context));
+		av_frame_unref (_frame);
 	}
 }
 
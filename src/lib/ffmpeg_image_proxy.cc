@@ -25,6 +25,7 @@
 #include "image.h"
 #include "compose.hpp"
 #include "util.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -168,6 +169,9 @@ FFmpegImageProxy::image (optional<dcp::Size>) const
 	AVCodec* codec = avcodec_find_decoder (codec_context->codec_id);
 	DCPOMATIC_ASSERT (codec);
 
+	/* So that our Image can use the decoded frame's data in place */
+	codec_context->refcounted_frames = 1;
+
 	if (avcodec_open2 (codec_context, codec, 0) < 0) {
 		throw DecodeError (N_("could not open decoder"));
 	}
@@ -223,6 +227,12 @@ FFmpegImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return memcmp (_data.data().get(), mp->_data.data().get(), _data.size()) == 0;
 }
 
+void
+FFmpegImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (_data.data().get(), _data.size());
+}
+
 size_t
 FFmpegImageProxy::memory_used () const
 {
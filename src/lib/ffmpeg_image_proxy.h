@@ -38,6 +38,7 @@ public:
 	void send_binary (boost::shared_ptr<Socket>) const;
 	bool same (boost::shared_ptr<const ImageProxy> other) const;
 	size_t memory_used () const;
+	void add_digest (Digester& digester) const;
 
 	int avio_read (uint8_t* buffer, int const amount);
 	int64_t avio_seek (int64_t const pos, int whence);
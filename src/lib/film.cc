@@ -1019,30 +1019,14 @@ Film::set_isdcf_date_today ()
 	_isdcf_date = boost::gregorian::day_clock::local_day ();
 }
 
+/** @return The file to keep JPEG2000 frames for a reel in while they are waiting to be written to its picture asset */
 boost::filesystem::path
-Film::j2c_path (int reel, Frame frame, Eyes eyes, bool tmp) const
+Film::spill_file (int reel) const
 {
 	boost::filesystem::path p;
 	p /= "j2c";
 	p /= video_identifier ();
-
-	char buffer[256];
-	snprintf(buffer, sizeof(buffer), "%08d_%08" PRId64, reel, frame);
-	string s (buffer);
-
-	if (eyes == EYES_LEFT) {
-		s += ".L";
-	} else if (eyes == EYES_RIGHT) {
-		s += ".R";
-	}
-
-	s += ".j2c";
-
-	if (tmp) {
-		s += ".tmp";
-	}
-
-	p /= s;
+	p /= raw_convert<string> (reel) + ".spill";
 	return file (p);
 }
 
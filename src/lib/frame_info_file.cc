@@ -0,0 +1,113 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/frame_info_file.cc
+ *  @brief FrameInfoFile class.
+ */
+
+#include "frame_info_file.h"
+#include "cross.h"
+#include "util.h"
+#include "exceptions.h"
+#include "dcpomatic_assert.h"
+
+int const FrameInfoFile::_info_size = 48;
+
+/** Open a file, creating it if it does not exist; any information that is already in
+ *  it is kept.
+ */
+FrameInfoFile::FrameInfoFile (boost::filesystem::path path)
+	: _path (path)
+{
+	bool const read = boost::filesystem::exists (_path);
+
+	if (read) {
+		_file = fopen_boost (_path, "r+b");
+	} else {
+		_file = fopen_boost (_path, "w+b");
+	}
+	if (!_file) {
+		throw OpenFileError (_path, errno, read);
+	}
+}
+
+FrameInfoFile::~FrameInfoFile ()
+{
+	fclose (_file);
+}
+
+/** @param frame reel-relative frame */
+void
+FrameInfoFile::write (Frame frame, Eyes eyes, dcp::FrameInfo info)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	dcpomatic_fseek (_file, position (frame, eyes), SEEK_SET);
+	checked_fwrite (&info.offset, sizeof (info.offset), _file, _path);
+	checked_fwrite (&info.size, sizeof (info.size), _file, _path);
+	checked_fwrite (info.hash.c_str(), info.hash.size(), _file, _path);
+
+	/* Flush so that a resumed encode will find this if we are killed later */
+	fflush (_file);
+}
+
+/** @param frame reel-relative frame */
+dcp::FrameInfo
+FrameInfoFile::read (Frame frame, Eyes eyes)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	dcp::FrameInfo info;
+	dcpomatic_fseek (_file, position (frame, eyes), SEEK_SET);
+	checked_fread (&info.offset, sizeof(info.offset), _file, _path);
+	checked_fread (&info.size, sizeof(info.size), _file, _path);
+
+	char hash_buffer[33];
+	checked_fread (hash_buffer, 32, _file, _path);
+	hash_buffer[32] = '\0';
+	info.hash = hash_buffer;
+
+	return info;
+}
+
+/** @return Number of complete pieces of information in the file; for 3D there is one for each eye */
+int64_t
+FrameInfoFile::entries ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return boost::filesystem::file_size (_path) / _info_size;
+}
+
+long
+FrameInfoFile::position (Frame frame, Eyes eyes) const
+{
+	switch (eyes) {
+	case EYES_BOTH:
+		return frame * _info_size;
+	case EYES_LEFT:
+		return frame * _info_size * 2;
+	case EYES_RIGHT:
+		return frame * _info_size * 2 + _info_size;
+	default:
+		DCPOMATIC_ASSERT (false);
+	}
+
+	DCPOMATIC_ASSERT (false);
+}
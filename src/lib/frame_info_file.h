@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_FRAME_INFO_FILE_H
+#define DCPOMATIC_FRAME_INFO_FILE_H
+
+/** @file  src/lib/frame_info_file.h
+ *  @brief FrameInfoFile class.
+ */
+
+#include "types.h"
+#include <dcp/picture_asset_writer.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** @class FrameInfoFile
+ *  @brief A file of the dcp::FrameInfo for each frame that has been written to a reel's picture asset.
+ *
+ *  The file is kept open for as long as this object exists, and each piece of information is
+ *  flushed as soon as it is written so that it will still be there if DCP-o-matic dies.
+ *  It may be used from more than one thread.
+ */
+class FrameInfoFile : public boost::noncopyable
+{
+public:
+	explicit FrameInfoFile (boost::filesystem::path path);
+	~FrameInfoFile ();
+
+	void write (Frame frame, Eyes eyes, dcp::FrameInfo info);
+	dcp::FrameInfo read (Frame frame, Eyes eyes);
+	int64_t entries ();
+
+private:
+	long position (Frame frame, Eyes eyes) const;
+
+	boost::filesystem::path _path;
+	/** mutex to protect _file */
+	boost::mutex _mutex;
+	FILE* _file;
+
+	static int const _info_size;
+};
+
+#endif
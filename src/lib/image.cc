@@ -29,6 +29,11 @@
 #include "util.h"
 #include "compose.hpp"
 #include "dcpomatic_socket.h"
+#include "digester.h"
+#include "sws_context_cache.h"
+#include "thread_pool.h"
+#include "image_buffer_pool.h"
+#include "fader.h"
 #include <dcp/rgb_xyz.h>
 #include <dcp/transfer_function.h>
 extern "C" {
@@ -38,10 +43,12 @@ extern "C" {
 #include <libavutil/frame.h>
 }
 #include <png.h>
+#include <zlib.h>
 #if HAVE_VALGRIND_MEMCHECK_H
 #include <valgrind/memcheck.h>
 #endif
 #include <iostream>
+#include <vector>
 
 #include "i18n.h"
 
@@ -51,8 +58,13 @@ using std::max;
 using std::cout;
 using std::cerr;
 using std::list;
-using std::runtime_error;
+using std::vector;
+using std::bad_alloc;
+using std::pair;
+using std::make_pair;
+using boost::function;
 using boost::shared_ptr;
+using boost::optional;
 using dcp::Size;
 
 int
@@ -117,6 +129,33 @@ Image::planes () const
 	return d->nb_components;
 }
 
+/** A scale of some image data, using a context from SwsContextCache */
+struct ScaleBand
+{
+	void operator() () const
+	{
+		struct SwsContext* scale_context = SwsContextCache::get (in_size, in_format, out_size, out_format, flags, yuv_to_rgb);
+
+		sws_scale (
+			scale_context,
+			&in_data[0], in_stride,
+			0, in_size.height,
+			&out_data[0], out_stride
+			);
+	}
+
+	vector<uint8_t*> in_data;
+	int const * in_stride;
+	dcp::Size in_size;
+	AVPixelFormat in_format;
+	vector<uint8_t*> out_data;
+	int const * out_stride;
+	dcp::Size out_size;
+	AVPixelFormat out_format;
+	int flags;
+	dcp::YUVToRGB yuv_to_rgb;
+};
+
 /** Crop this image, scale it to `inter_size' and then place it in a black frame of `out_size'.
  *  @param crop Amount to crop by.
  *  @param inter_size Size to scale the cropped image to.
@@ -126,10 +165,13 @@ Image::planes () const
  *  @param out_aligned true to make the output image aligned.
  *  @param fast Try to be fast at the possible expense of quality; at present this means using
  *  fast bilinear rather than bicubic scaling.
+ *  @param parallel true to split the image into horizontal bands and scale them in parallel.  Each band
+ *  is scaled on its own, so if the image is being scaled vertically the rows at the edges of the bands
+ *  may be very slightly different to what they would otherwise be.
  */
 shared_ptr<Image>
 Image::crop_scale_window (
-	Crop crop, dcp::Size inter_size, dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool out_aligned, bool fast
+	Crop crop, dcp::Size inter_size, dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool out_aligned, bool fast, bool parallel
 	) const
 {
 	/* Empirical testing suggests that sws_scale() will crash if
@@ -163,46 +205,22 @@ Image::crop_scale_window (
 	*/
 
 	shared_ptr<Image> out (new Image (out_format, out_size, out_aligned, (out_size.width - inter_size.width) / 2));
-	out->make_black ();
-
-	/* Size of the image after any crop */
-	dcp::Size const cropped_size = crop.apply (size ());
 
-	/* Scale context for a scale from cropped_size to inter_size */
-	struct SwsContext* scale_context = sws_getContext (
-			cropped_size.width, cropped_size.height, pixel_format(),
-			inter_size.width, inter_size.height, out_format,
-			fast ? SWS_FAST_BILINEAR : SWS_BICUBIC, 0, 0, 0
-		);
+	/* Corner of the image within out_size */
+	Position<int> const corner ((out_size.width - inter_size.width) / 2, (out_size.height - inter_size.height) / 2);
 
-	if (!scale_context) {
-		throw runtime_error (N_("Could not allocate SwsContext"));
+	if (inter_size.width == out_size.width) {
+		/* The scale below will write the whole of every row from corner.y to corner.y + inter_size.height,
+		   so only the rows above and below those need to be made black.
+		*/
+		out->make_rows_black (0, corner.y);
+		out->make_rows_black (corner.y + inter_size.height, out_size.height);
+	} else {
+		out->make_black ();
 	}
 
-	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
-	int const lut[dcp::YUV_TO_RGB_COUNT] = {
-		SWS_CS_ITU601,
-		SWS_CS_ITU709
-	};
-
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores
-	   these parameters unless the image isYUV or isGray
-	   (if it's neither, it uses video range for source
-	   and destination).
-	*/
-	sws_setColorspaceDetails (
-		scale_context,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		0, 1 << 16, 1 << 16
-		);
+	/* Size of the image after any crop */
+	dcp::Size const cropped_size = crop.apply (size ());
 
 	AVPixFmtDescriptor const * in_desc = av_pix_fmt_desc_get (_pixel_format);
 	if (!in_desc) {
@@ -221,9 +239,6 @@ Image::crop_scale_window (
 		scale_in_data[c] = data()[c] + x + stride()[c] * (crop.top / vertical_factor(c));
 	}
 
-	/* Corner of the image within out_size */
-	Position<int> const corner ((out_size.width - inter_size.width) / 2, (out_size.height - inter_size.height) / 2);
-
 	AVPixFmtDescriptor const * out_desc = av_pix_fmt_desc_get (out_format);
 	if (!out_desc) {
 		throw PixelFormatError ("crop_scale_window()", out_format);
@@ -236,14 +251,62 @@ Image::crop_scale_window (
 		scale_out_data[c] = out->data()[c] + x + out->stride()[c] * (corner.y / out->vertical_factor(c));
 	}
 
-	sws_scale (
-		scale_context,
-		scale_in_data, stride(),
-		0, cropped_size.height,
-		scale_out_data, out->stride()
-		);
+	ScaleBand band;
+	band.in_stride = stride ();
+	band.in_format = pixel_format ();
+	band.out_stride = out->stride ();
+	band.out_format = out_format;
+	band.flags = fast ? SWS_FAST_BILINEAR : SWS_BICUBIC;
+	band.yuv_to_rgb = yuv_to_rgb;
+
+	/* Number of horizontal bands to scale in parallel; they must not get too thin */
+	int bands = 1;
+	if (parallel) {
+		bands = min (ThreadPool::instance()->threads(), min (inter_size.height, cropped_size.height) / 64);
+	}
+
+	if (bands <= 1) {
+		band.in_data = vector<uint8_t*> (scale_in_data, scale_in_data + planes());
+		band.in_size = cropped_size;
+		band.out_data = vector<uint8_t*> (scale_out_data, scale_out_data + out->planes());
+		band.out_size = inter_size;
+		band ();
+		return out;
+	}
+
+	/* Band edges must be on whole rows of any subsampled planes, in the input and the output */
+	int const align = max (1 << in_desc->log2_chroma_h, 1 << out_desc->log2_chroma_h);
+
+	vector<function<void ()> > jobs;
+	int in_y = 0;
+	int out_y = 0;
+	for (int i = 1; i <= bands; ++i) {
+		int next_out_y = inter_size.height;
+		int next_in_y = cropped_size.height;
+		if (i < bands) {
+			next_out_y = (int64_t (inter_size.height) * i / bands) & ~(align - 1);
+			next_in_y = (int64_t (cropped_size.height) * next_out_y / inter_size.height) & ~(align - 1);
+		}
 
-	sws_freeContext (scale_context);
+		band.in_data.clear ();
+		for (int c = 0; c < planes(); ++c) {
+			band.in_data.push_back (scale_in_data[c] + stride()[c] * (in_y / vertical_factor(c)));
+		}
+		band.in_size = dcp::Size (cropped_size.width, next_in_y - in_y);
+
+		band.out_data.clear ();
+		for (int c = 0; c < out->planes(); ++c) {
+			band.out_data.push_back (scale_out_data[c] + out->stride()[c] * (out_y / out->vertical_factor(c)));
+		}
+		band.out_size = dcp::Size (inter_size.width, next_out_y - out_y);
+
+		jobs.push_back (band);
+
+		in_y = next_in_y;
+		out_y = next_out_y;
+	}
+
+	ThreadPool::instance()->run (jobs);
 
 	return out;
 }
@@ -271,35 +334,8 @@ Image::scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_fo
 
 	shared_ptr<Image> scaled (new Image (out_format, out_size, out_aligned));
 
-	struct SwsContext* scale_context = sws_getContext (
-		size().width, size().height, pixel_format(),
-		out_size.width, out_size.height, out_format,
-		(fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND, 0, 0, 0
-		);
-
-	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
-	int const lut[dcp::YUV_TO_RGB_COUNT] = {
-		SWS_CS_ITU601,
-		SWS_CS_ITU709
-	};
-
-	/* The 3rd parameter here is:
-	   0 -> source range MPEG (i.e. "video", 16-235)
-	   1 -> source range JPEG (i.e. "full", 0-255)
-	   And the 5th:
-	   0 -> destination range MPEG (i.e. "video", 16-235)
-	   1 -> destination range JPEG (i.e. "full", 0-255)
-
-	   But remember: sws_setColorspaceDetails ignores
-	   these parameters unless the image isYUV or isGray
-	   (if it's neither, it uses video range for source
-	   and destination).
-	*/
-	sws_setColorspaceDetails (
-		scale_context,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		sws_getCoefficients (lut[yuv_to_rgb]), 0,
-		0, 1 << 16, 1 << 16
+	struct SwsContext* scale_context = SwsContextCache::get (
+		size(), pixel_format(), out_size, out_format, (fast ? SWS_FAST_BILINEAR : SWS_BICUBIC) | SWS_ACCURATE_RND, yuv_to_rgb
 		);
 
 	sws_scale (
@@ -309,30 +345,65 @@ Image::scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_fo
 		scaled->data(), scaled->stride()
 		);
 
-	sws_freeContext (scale_context);
-
 	return scaled;
 }
 
-/** Blacken a YUV image whose bits per pixel is rounded up to 16 */
+/** @return The range of rows [first, last) of a plane which hold image rows [from, to) */
+pair<int, int>
+Image::plane_rows (int c, int from, int to) const
+{
+	int const v = vertical_factor (c);
+	return make_pair (from / v, min (sample_size(c).height, (to + v - 1) / v));
+}
+
+/** Fill the rows of a plane which hold some image rows with a repeating pattern.
+ *  @param c Plane.
+ *  @param from First image row.
+ *  @param to One past the last image row.
+ *  @param pattern Pattern of bytes.
+ *  @param pattern_size Size of pattern in bytes.
+ */
 void
-Image::yuv_16_black (uint16_t v, bool alpha)
+Image::fill_rows (int c, int from, int to, uint8_t const * pattern, int pattern_size)
 {
-	memset (data()[0], 0, sample_size(0).height * stride()[0]);
-	for (int i = 1; i < 3; ++i) {
-		int16_t* p = reinterpret_cast<int16_t*> (data()[i]);
-		int const lines = sample_size(i).height;
-		for (int y = 0; y < lines; ++y) {
-			/* We divide by 2 here because we are writing 2 bytes at a time */
-			for (int x = 0; x < line_size()[i] / 2; ++x) {
-				p[x] = v;
-			}
-			p += stride()[i] / 2;
-		}
+	pair<int, int> const rows = plane_rows (c, from, to);
+	if (rows.first >= rows.second) {
+		return;
 	}
 
+	uint8_t* p = data()[c] + rows.first * stride()[c];
+
+	if (pattern_size == 1) {
+		memset (p, *pattern, (rows.second - rows.first) * stride()[c]);
+		return;
+	}
+
+	/* Fill the first row by doubling up the pattern, then copy that row into the others */
+	int const s = stride()[c];
+	memcpy (p, pattern, min (pattern_size, s));
+	for (int done = pattern_size; done < s; done *= 2) {
+		memcpy (p + done, p, min (done, s - done));
+	}
+
+	for (int i = rows.first + 1; i < rows.second; ++i) {
+		memcpy (p + (i - rows.first) * s, p, s);
+	}
+}
+
+/** Blacken a YUV image whose bits per pixel is rounded up to 16 */
+void
+Image::yuv_16_black (uint16_t v, bool alpha, int from, int to)
+{
+	uint8_t const zero = 0;
+	uint8_t pattern[2];
+	memcpy (pattern, &v, 2);
+
+	fill_rows (0, from, to, &zero, 1);
+	fill_rows (1, from, to, pattern, 2);
+	fill_rows (2, from, to, pattern, 2);
+
 	if (alpha) {
-		memset (data()[3], 0, sample_size(3).height * stride()[3]);
+		fill_rows (3, from, to, &zero, 1);
 	}
 }
 
@@ -345,6 +416,18 @@ Image::swap_16 (uint16_t v)
 void
 Image::make_black ()
 {
+	make_rows_black (0, size().height);
+}
+
+/** Make some rows of the image black.
+ *  @param from First row.
+ *  @param to One past the last row.
+ */
+void
+Image::make_rows_black (int from, int to)
+{
+	make_writable ();
+
 	/* U/V black value for 8-bit colour */
 	static uint8_t const eight_bit_uv =	(1 << 7) - 1;
 	/* U/V black value for 9-bit colour */
@@ -354,83 +437,88 @@ Image::make_black ()
 	/* U/V black value for 16-bit colour */
 	static uint16_t const sixteen_bit_uv =	(1 << 15) - 1;
 
+	uint8_t const zero = 0;
+
 	switch (_pixel_format) {
 	case AV_PIX_FMT_YUV420P:
 	case AV_PIX_FMT_YUV422P:
 	case AV_PIX_FMT_YUV444P:
 	case AV_PIX_FMT_YUV411P:
-		memset (data()[0], 0, sample_size(0).height * stride()[0]);
-		memset (data()[1], eight_bit_uv, sample_size(1).height * stride()[1]);
-		memset (data()[2], eight_bit_uv, sample_size(2).height * stride()[2]);
+		fill_rows (0, from, to, &zero, 1);
+		fill_rows (1, from, to, &eight_bit_uv, 1);
+		fill_rows (2, from, to, &eight_bit_uv, 1);
 		break;
 
 	case AV_PIX_FMT_YUVJ420P:
 	case AV_PIX_FMT_YUVJ422P:
 	case AV_PIX_FMT_YUVJ444P:
-		memset (data()[0], 0, sample_size(0).height * stride()[0]);
-		memset (data()[1], eight_bit_uv + 1, sample_size(1).height * stride()[1]);
-		memset (data()[2], eight_bit_uv + 1, sample_size(2).height * stride()[2]);
+	{
+		uint8_t const uv = eight_bit_uv + 1;
+		fill_rows (0, from, to, &zero, 1);
+		fill_rows (1, from, to, &uv, 1);
+		fill_rows (2, from, to, &uv, 1);
 		break;
+	}
 
 	case AV_PIX_FMT_YUV422P9LE:
 	case AV_PIX_FMT_YUV444P9LE:
-		yuv_16_black (nine_bit_uv, false);
+		yuv_16_black (nine_bit_uv, false, from, to);
 		break;
 
 	case AV_PIX_FMT_YUV422P9BE:
 	case AV_PIX_FMT_YUV444P9BE:
-		yuv_16_black (swap_16 (nine_bit_uv), false);
+		yuv_16_black (swap_16 (nine_bit_uv), false, from, to);
 		break;
 
 	case AV_PIX_FMT_YUV422P10LE:
 	case AV_PIX_FMT_YUV444P10LE:
-		yuv_16_black (ten_bit_uv, false);
+		yuv_16_black (ten_bit_uv, false, from, to);
 		break;
 
 	case AV_PIX_FMT_YUV422P16LE:
 	case AV_PIX_FMT_YUV444P16LE:
-		yuv_16_black (sixteen_bit_uv, false);
+		yuv_16_black (sixteen_bit_uv, false, from, to);
 		break;
 
 	case AV_PIX_FMT_YUV444P10BE:
 	case AV_PIX_FMT_YUV422P10BE:
-		yuv_16_black (swap_16 (ten_bit_uv), false);
+		yuv_16_black (swap_16 (ten_bit_uv), false, from, to);
 		break;
 
 	case AV_PIX_FMT_YUVA420P9BE:
 	case AV_PIX_FMT_YUVA422P9BE:
 	case AV_PIX_FMT_YUVA444P9BE:
-		yuv_16_black (swap_16 (nine_bit_uv), true);
+		yuv_16_black (swap_16 (nine_bit_uv), true, from, to);
 		break;
 
 	case AV_PIX_FMT_YUVA420P9LE:
 	case AV_PIX_FMT_YUVA422P9LE:
 	case AV_PIX_FMT_YUVA444P9LE:
-		yuv_16_black (nine_bit_uv, true);
+		yuv_16_black (nine_bit_uv, true, from, to);
 		break;
 
 	case AV_PIX_FMT_YUVA420P10BE:
 	case AV_PIX_FMT_YUVA422P10BE:
 	case AV_PIX_FMT_YUVA444P10BE:
-		yuv_16_black (swap_16 (ten_bit_uv), true);
+		yuv_16_black (swap_16 (ten_bit_uv), true, from, to);
 		break;
 
 	case AV_PIX_FMT_YUVA420P10LE:
 	case AV_PIX_FMT_YUVA422P10LE:
 	case AV_PIX_FMT_YUVA444P10LE:
-		yuv_16_black (ten_bit_uv, true);
+		yuv_16_black (ten_bit_uv, true, from, to);
 		break;
 
 	case AV_PIX_FMT_YUVA420P16BE:
 	case AV_PIX_FMT_YUVA422P16BE:
 	case AV_PIX_FMT_YUVA444P16BE:
-		yuv_16_black (swap_16 (sixteen_bit_uv), true);
+		yuv_16_black (swap_16 (sixteen_bit_uv), true, from, to);
 		break;
 
 	case AV_PIX_FMT_YUVA420P16LE:
 	case AV_PIX_FMT_YUVA422P16LE:
 	case AV_PIX_FMT_YUVA444P16LE:
-		yuv_16_black (sixteen_bit_uv, true);
+		yuv_16_black (sixteen_bit_uv, true, from, to);
 		break;
 
 	case AV_PIX_FMT_RGB24:
@@ -442,22 +530,14 @@ Image::make_black ()
 	case AV_PIX_FMT_RGB48LE:
 	case AV_PIX_FMT_RGB48BE:
 	case AV_PIX_FMT_XYZ12LE:
-		memset (data()[0], 0, sample_size(0).height * stride()[0]);
+		fill_rows (0, from, to, &zero, 1);
 		break;
 
 	case AV_PIX_FMT_UYVY422:
 	{
-		int const Y = sample_size(0).height;
-		int const X = line_size()[0];
-		uint8_t* p = data()[0];
-		for (int y = 0; y < Y; ++y) {
-			for (int x = 0; x < X / 4; ++x) {
-				*p++ = eight_bit_uv; // Cb
-				*p++ = 0;	     // Y0
-				*p++ = eight_bit_uv; // Cr
-				*p++ = 0;	     // Y1
-			}
-		}
+		/* Cb, Y0, Cr, Y1 */
+		uint8_t const pattern[4] = { eight_bit_uv, 0, eight_bit_uv, 0 };
+		fill_rows (0, from, to, pattern, 4);
 		break;
 	}
 
@@ -469,6 +549,8 @@ Image::make_black ()
 void
 Image::make_transparent ()
 {
+	make_writable ();
+
 	if (_pixel_format != AV_PIX_FMT_BGRA) {
 		throw PixelFormatError ("make_transparent()", _pixel_format);
 	}
@@ -476,9 +558,80 @@ Image::make_transparent ()
 	memset (data()[0], 0, sample_size(0).height * stride()[0]);
 }
 
+/** Blend an RGBA or BGRA overlay onto an image whose components are interleaved 8-bit values
+ *  (or have 8-bit high bytes which can be treated as such).
+ */
+static void
+alpha_blend_interleaved (
+	Image* image, AlphaBlender::Layout layout, shared_ptr<const Image> other, int start_tx, int start_ty, int start_ox, int start_oy, AlphaBlender::Kernel kernel
+	)
+{
+	bool const bgra = other->pixel_format() == AV_PIX_FMT_BGRA;
+	int const width = min (image->size().width - start_tx, other->size().width - start_ox);
+	if (width <= 0) {
+		return;
+	}
+
+	for (int ty = start_ty, oy = start_oy; ty < image->size().height && oy < other->size().height; ++ty, ++oy) {
+		uint8_t* tp = image->data()[0] + ty * image->stride()[0] + start_tx * layout.bpp;
+		uint8_t* op = other->data()[0] + oy * other->stride()[0] + start_ox * 4;
+		AlphaBlender::blend (tp, layout, op, bgra, width, kernel);
+	}
+}
+
+/** Blend an overlay, which has been converted to the same YUV format as an image, onto that image;
+ *  T is the type of each component and chroma_factor the vertical subsampling of the chroma planes.
+ */
+template <class T>
+static void
+alpha_blend_yuv (
+	Image* image, shared_ptr<const Image> yuv, shared_ptr<const Image> other, int chroma_factor,
+	int start_tx, int start_ty, int start_ox, int start_oy, AlphaBlender::Kernel kernel
+	)
+{
+	dcp::Size const ts = image->size();
+	dcp::Size const os = yuv->size();
+	int const width = min (ts.width - start_tx, os.width - start_ox);
+	if (width <= 0) {
+		return;
+	}
+
+	for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
+		int const hty = ty / chroma_factor;
+		int const hoy = oy / chroma_factor;
+		T* tY = reinterpret_cast<T*> (image->data()[0] + ty * image->stride()[0]);
+		T* tU = reinterpret_cast<T*> (image->data()[1] + hty * image->stride()[1]);
+		T* tV = reinterpret_cast<T*> (image->data()[2] + hty * image->stride()[2]);
+		T const * oY = reinterpret_cast<T const *> (yuv->data()[0] + oy * yuv->stride()[0]);
+		T const * oU = reinterpret_cast<T const *> (yuv->data()[1] + hoy * yuv->stride()[1]);
+		T const * oV = reinterpret_cast<T const *> (yuv->data()[2] + hoy * yuv->stride()[2]);
+		uint8_t const * alpha = other->data()[0] + oy * other->stride()[0];
+		for (int i = 0; i < width; ++i) {
+			/* Skip any transparent pixels, which would not change anything */
+			i += AlphaBlender::transparent (alpha + (start_ox + i) * 4, width - i, kernel);
+			if (i == width) {
+				break;
+			}
+			int const tx = start_tx + i;
+			int const ox = start_ox + i;
+			float const a = float(alpha[ox * 4 + 3]) / 255;
+			tY[tx] = oY[ox] * a + tY[tx] * (1 - a);
+			tU[tx / 2] = oU[ox / 2] * a + tU[tx / 2] * (1 - a);
+			tV[tx / 2] = oV[ox / 2] * a + tV[tx / 2] * (1 - a);
+		}
+	}
+}
+
+/** Blend another image onto this one.
+ *  @param other RGBA or BGRA image to blend.
+ *  @param position Position of the top-left of `other' within this image.
+ *  @param kernel AlphaBlender kernel to use for the blend and for finding transparent pixels, which must be supported.
+ */
 void
-Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
+Image::alpha_blend (shared_ptr<const Image> other, Position<int> position, AlphaBlender::Kernel kernel)
 {
+	make_writable ();
+
 	/* We're blending RGBA or BGRA images */
 	DCPOMATIC_ASSERT (other->pixel_format() == AV_PIX_FMT_BGRA || other->pixel_format() == AV_PIX_FMT_RGBA);
 	int const blue = other->pixel_format() == AV_PIX_FMT_BGRA ? 0 : 2;
@@ -504,81 +657,19 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 
 	switch (_pixel_format) {
 	case AV_PIX_FMT_RGB24:
-	{
 		/* Going onto RGB24.  First byte is red, second green, third blue */
-		int const this_bpp = 3;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
-			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[red] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[blue] * alpha + tp[2] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
-		}
+		alpha_blend_interleaved (this, AlphaBlender::Layout (3, 0, 1, 2, -1), other, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
-	}
 	case AV_PIX_FMT_BGRA:
-	{
-		int const this_bpp = 4;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
-			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[blue] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[red] * alpha + tp[2] * (1 - alpha);
-				tp[3] = op[3] * alpha + tp[3] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
-		}
+		alpha_blend_interleaved (this, AlphaBlender::Layout (4, 2, 1, 0, 3), other, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
-	}
 	case AV_PIX_FMT_RGBA:
-	{
-		int const this_bpp = 4;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
-			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				tp[0] = op[red] * alpha + tp[0] * (1 - alpha);
-				tp[1] = op[1] * alpha + tp[1] * (1 - alpha);
-				tp[2] = op[blue] * alpha + tp[2] * (1 - alpha);
-				tp[3] = op[3] * alpha + tp[3] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
-		}
+		alpha_blend_interleaved (this, AlphaBlender::Layout (4, 0, 1, 2, 3), other, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
-	}
 	case AV_PIX_FMT_RGB48LE:
-	{
-		int const this_bpp = 6;
-		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
-			uint8_t* tp = data()[0] + ty * stride()[0] + start_tx * this_bpp;
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
-				float const alpha = float (op[3]) / 255;
-				/* Blend high bytes */
-				tp[1] = op[red] * alpha + tp[1] * (1 - alpha);
-				tp[3] = op[1] * alpha + tp[3] * (1 - alpha);
-				tp[5] = op[blue] * alpha + tp[5] * (1 - alpha);
-
-				tp += this_bpp;
-				op += other_bpp;
-			}
-		}
+		/* Blend high bytes */
+		alpha_blend_interleaved (this, AlphaBlender::Layout (6, 1, 3, 5, -1), other, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
-	}
 	case AV_PIX_FMT_XYZ12LE:
 	{
 		dcp::ColourConversion conv = dcp::ColourConversion::srgb_to_xyz();
@@ -587,10 +678,19 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 		double const * lut_in = conv.in()->lut (8, false);
 		double const * lut_out = conv.out()->lut (16, true);
 		int const this_bpp = 6;
+		int const width = min (size().width - start_tx, other->size().width - start_ox);
 		for (int ty = start_ty, oy = start_oy; ty < size().height && oy < other->size().height; ++ty, ++oy) {
-			uint16_t* tp = reinterpret_cast<uint16_t*> (data()[0] + ty * stride()[0] + start_tx * this_bpp);
-			uint8_t* op = other->data()[0] + oy * other->stride()[0];
-			for (int tx = start_tx, ox = start_ox; tx < size().width && ox < other->size().width; ++tx, ++ox) {
+			uint8_t* trow = data()[0] + ty * stride()[0];
+			uint8_t* orow = other->data()[0] + oy * other->stride()[0];
+			for (int i = 0; i < width; ++i) {
+				/* Skip any transparent pixels, which would not change anything */
+				i += AlphaBlender::transparent (orow + (start_ox + i) * other_bpp, width - i, kernel);
+				if (i == width) {
+					break;
+				}
+
+				uint16_t* tp = reinterpret_cast<uint16_t*> (trow + (start_tx + i) * this_bpp);
+				uint8_t* op = orow + (start_ox + i) * other_bpp;
 				float const alpha = float (op[3]) / 255;
 
 				/* Convert sRGB to XYZ; op is BGRA.  First, input gamma LUT */
@@ -607,9 +707,6 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 				tp[0] = lrint(lut_out[lrint(x)] * 65535) * alpha + tp[0] * (1 - alpha);
 				tp[1] = lrint(lut_out[lrint(y)] * 65535) * alpha + tp[1] * (1 - alpha);
 				tp[2] = lrint(lut_out[lrint(z)] * 65535) * alpha + tp[2] * (1 - alpha);
-
-				tp += this_bpp / 2;
-				op += other_bpp;
 			}
 		}
 		break;
@@ -617,104 +714,19 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 	case AV_PIX_FMT_YUV420P:
 	{
 		shared_ptr<Image> yuv = other->convert_pixel_format (dcp::YUV_TO_RGB_REC709, _pixel_format, false, false);
-		dcp::Size const ts = size();
-		dcp::Size const os = yuv->size();
-		for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
-			int const hty = ty / 2;
-			int const hoy = oy / 2;
-			uint8_t* tY = data()[0] + (ty * stride()[0]) + start_tx;
-			uint8_t* tU = data()[1] + (hty * stride()[1]) + start_tx / 2;
-			uint8_t* tV = data()[2] + (hty * stride()[2]) + start_tx / 2;
-			uint8_t* oY = yuv->data()[0] + (oy * yuv->stride()[0]) + start_ox;
-			uint8_t* oU = yuv->data()[1] + (hoy * yuv->stride()[1]) + start_ox / 2;
-			uint8_t* oV = yuv->data()[2] + (hoy * yuv->stride()[2]) + start_ox / 2;
-			uint8_t* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
-			for (int tx = start_tx, ox = start_ox; tx < ts.width && ox < os.width; ++tx, ++ox) {
-				float const a = float(alpha[3]) / 255;
-				*tY = *oY * a + *tY * (1 - a);
-				*tU = *oU * a + *tU * (1 - a);
-				*tV = *oV * a + *tV * (1 - a);
-				++tY;
-				++oY;
-				if (tx % 2) {
-					++tU;
-					++tV;
-				}
-				if (ox % 2) {
-					++oU;
-					++oV;
-				}
-				alpha += 4;
-			}
-		}
+		alpha_blend_yuv<uint8_t> (this, yuv, other, 2, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
 	}
 	case AV_PIX_FMT_YUV420P10:
 	{
 		shared_ptr<Image> yuv = other->convert_pixel_format (dcp::YUV_TO_RGB_REC709, _pixel_format, false, false);
-		dcp::Size const ts = size();
-		dcp::Size const os = yuv->size();
-		for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
-			int const hty = ty / 2;
-			int const hoy = oy / 2;
-			uint16_t* tY = ((uint16_t *) (data()[0] + (ty * stride()[0]))) + start_tx;
-			uint16_t* tU = ((uint16_t *) (data()[1] + (hty * stride()[1]))) + start_tx / 2;
-			uint16_t* tV = ((uint16_t *) (data()[2] + (hty * stride()[2]))) + start_tx / 2;
-			uint16_t* oY = ((uint16_t *) (yuv->data()[0] + (oy * yuv->stride()[0]))) + start_ox;
-			uint16_t* oU = ((uint16_t *) (yuv->data()[1] + (hoy * yuv->stride()[1]))) + start_ox / 2;
-			uint16_t* oV = ((uint16_t *) (yuv->data()[2] + (hoy * yuv->stride()[2]))) + start_ox / 2;
-			uint8_t* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
-			for (int tx = start_tx, ox = start_ox; tx < ts.width && ox < os.width; ++tx, ++ox) {
-				float const a = float(alpha[3]) / 255;
-				*tY = *oY * a + *tY * (1 - a);
-				*tU = *oU * a + *tU * (1 - a);
-				*tV = *oV * a + *tV * (1 - a);
-				++tY;
-				++oY;
-				if (tx % 2) {
-					++tU;
-					++tV;
-				}
-				if (ox % 2) {
-					++oU;
-					++oV;
-				}
-				alpha += 4;
-			}
-		}
+		alpha_blend_yuv<uint16_t> (this, yuv, other, 2, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
 	}
 	case AV_PIX_FMT_YUV422P10LE:
 	{
 		shared_ptr<Image> yuv = other->convert_pixel_format (dcp::YUV_TO_RGB_REC709, _pixel_format, false, false);
-		dcp::Size const ts = size();
-		dcp::Size const os = yuv->size();
-		for (int ty = start_ty, oy = start_oy; ty < ts.height && oy < os.height; ++ty, ++oy) {
-			uint16_t* tY = ((uint16_t *) (data()[0] + (ty * stride()[0]))) + start_tx;
-			uint16_t* tU = ((uint16_t *) (data()[1] + (ty * stride()[1]))) + start_tx / 2;
-			uint16_t* tV = ((uint16_t *) (data()[2] + (ty * stride()[2]))) + start_tx / 2;
-			uint16_t* oY = ((uint16_t *) (yuv->data()[0] + (oy * yuv->stride()[0]))) + start_ox;
-			uint16_t* oU = ((uint16_t *) (yuv->data()[1] + (oy * yuv->stride()[1]))) + start_ox / 2;
-			uint16_t* oV = ((uint16_t *) (yuv->data()[2] + (oy * yuv->stride()[2]))) + start_ox / 2;
-			uint8_t* alpha = other->data()[0] + (oy * other->stride()[0]) + start_ox * 4;
-			for (int tx = start_tx, ox = start_ox; tx < ts.width && ox < os.width; ++tx, ++ox) {
-				float const a = float(alpha[3]) / 255;
-				*tY = *oY * a + *tY * (1 - a);
-				*tU = *oU * a + *tU * (1 - a);
-				*tV = *oV * a + *tV * (1 - a);
-				++tY;
-				++oY;
-				if (tx % 2) {
-					++tU;
-					++tV;
-				}
-				if (ox % 2) {
-					++oU;
-					++oV;
-				}
-				alpha += 4;
-			}
-		}
+		alpha_blend_yuv<uint16_t> (this, yuv, other, 1, start_tx, start_ty, start_ox, start_oy, kernel);
 		break;
 	}
 	default:
@@ -725,6 +737,8 @@ Image::alpha_blend (shared_ptr<const Image> other, Position<int> position)
 void
 Image::copy (shared_ptr<const Image> other, Position<int> position)
 {
+	make_writable ();
+
 	/* Only implemented for RGB24 onto RGB24 so far */
 	DCPOMATIC_ASSERT (_pixel_format == AV_PIX_FMT_RGB24 && other->pixel_format() == AV_PIX_FMT_RGB24);
 	DCPOMATIC_ASSERT (position.x >= 0 && position.y >= 0);
@@ -740,6 +754,8 @@ Image::copy (shared_ptr<const Image> other, Position<int> position)
 void
 Image::read_from_socket (shared_ptr<Socket> socket)
 {
+	make_writable ();
+
 	for (int i = 0; i < planes(); ++i) {
 		uint8_t* p = data()[i];
 		int const lines = sample_size(i).height;
@@ -763,6 +779,150 @@ Image::write_to_socket (shared_ptr<Socket> socket) const
 	}
 }
 
+/** Add our pixel format, size and image data (but not any padding) to a Digester */
+void
+Image::add_digest (Digester& digester) const
+{
+	digester.add (static_cast<int> (_pixel_format));
+	digester.add (_size.width);
+	digester.add (_size.height);
+	for (int i = 0; i < planes(); ++i) {
+		uint8_t const * p = data()[i];
+		int const lines = sample_size(i).height;
+		for (int y = 0; y < lines; ++y) {
+			digester.add (p, line_size()[i]);
+			p += stride()[i];
+		}
+	}
+}
+
+/** @return Distance in bytes between a byte and the one that it is predicted from
+ *  by write_compressed_to_socket() and read_compressed_from_socket().
+ */
+static int
+compression_filter_distance (Image const * image)
+{
+	/* Roughly the size of a pixel, so that we predict each byte from the same
+	   part of the pixel to its left; this need not be exact.
+	*/
+	return max (1, int (lrintf (image->bytes_per_pixel (0))));
+}
+
+/** Write our image to a socket in a way that can be read by read_compressed_from_socket().
+ *  Each line has each byte replaced by its difference from the corresponding byte of the
+ *  previous pixel, then the whole image is compressed with zlib and sent with its length.
+ */
+void
+Image::write_compressed_to_socket (shared_ptr<Socket> socket) const
+{
+	int const distance = compression_filter_distance (this);
+
+	size_t total = 0;
+	int longest_line = 0;
+	for (int i = 0; i < planes(); ++i) {
+		total += size_t (line_size()[i]) * sample_size(i).height;
+		longest_line = max (longest_line, line_size()[i]);
+	}
+
+	z_stream stream;
+	memset (&stream, 0, sizeof (stream));
+	if (deflateInit (&stream, 1) != Z_OK) {
+		throw EncodeError (N_("could not set up zlib"));
+	}
+
+	vector<uint8_t> out (deflateBound (&stream, total) + 1);
+	vector<uint8_t> line (longest_line + 1);
+	stream.next_out = &out[0];
+	stream.avail_out = out.size ();
+
+	for (int i = 0; i < planes(); ++i) {
+		uint8_t const * p = data()[i];
+		int const lines = sample_size(i).height;
+		int const n = line_size()[i];
+		for (int y = 0; y < lines; ++y) {
+			for (int x = 0; x < min (distance, n); ++x) {
+				line[x] = p[x];
+			}
+			for (int x = distance; x < n; ++x) {
+				line[x] = p[x] - p[x - distance];
+			}
+			stream.next_in = &line[0];
+			stream.avail_in = n;
+			/* out is big enough that this will always take all the input */
+			deflate (&stream, Z_NO_FLUSH);
+			DCPOMATIC_ASSERT (stream.avail_in == 0);
+			p += stride()[i];
+		}
+	}
+
+	int const r = deflate (&stream, Z_FINISH);
+	deflateEnd (&stream);
+	if (r != Z_STREAM_END) {
+		throw EncodeError (N_("could not compress image"));
+	}
+
+	uint32_t const size = out.size() - stream.avail_out;
+	socket->write (size);
+	socket->write (&out[0], size);
+}
+
+/** Read an image written by write_compressed_to_socket() into this one, which must
+ *  already have the same size and pixel format as the one that was written.
+ */
+void
+Image::read_compressed_from_socket (shared_ptr<Socket> socket)
+{
+	make_writable ();
+
+	int const distance = compression_filter_distance (this);
+
+	size_t total = 0;
+	for (int i = 0; i < planes(); ++i) {
+		total += size_t (line_size()[i]) * sample_size(i).height;
+	}
+
+	/* The size comes from the other end of the socket so we must not trust it; the writer
+	   compressed exactly `total' bytes, so it cannot have made more than this.
+	*/
+	uint32_t const size = socket->read_uint32 ();
+	if (size > compressBound (total)) {
+		throw NetworkError (String::compose (N_("compressed image is too big (%1 bytes for %2 bytes of image)"), size, total));
+	}
+
+	vector<uint8_t> in (size + 1);
+	socket->read (&in[0], size);
+
+	z_stream stream;
+	memset (&stream, 0, sizeof (stream));
+	if (inflateInit (&stream) != Z_OK) {
+		throw NetworkError (N_("could not set up zlib"));
+	}
+
+	stream.next_in = &in[0];
+	stream.avail_in = size;
+
+	for (int i = 0; i < planes(); ++i) {
+		uint8_t* p = data()[i];
+		int const lines = sample_size(i).height;
+		int const n = line_size()[i];
+		for (int y = 0; y < lines; ++y) {
+			stream.next_out = p;
+			stream.avail_out = n;
+			int const r = inflate (&stream, Z_SYNC_FLUSH);
+			if ((r != Z_OK && r != Z_STREAM_END) || stream.avail_out != 0) {
+				inflateEnd (&stream);
+				throw NetworkError (N_("could not decompress image"));
+			}
+			for (int x = distance; x < n; ++x) {
+				p[x] += p[x - distance];
+			}
+			p += stride()[i];
+		}
+	}
+
+	inflateEnd (&stream);
+}
+
 float
 Image::bytes_per_pixel (int c) const
 {
@@ -822,12 +982,21 @@ Image::Image (AVPixelFormat p, dcp::Size s, bool aligned, int extra_pixels)
 	, _pixel_format (p)
 	, _aligned (aligned)
 	, _extra_pixels (extra_pixels)
+	, _frame (0)
 {
 	allocate ();
 }
 
 void
 Image::allocate ()
+{
+	allocate_pointers ();
+	allocate_planes ();
+}
+
+/** Allocate the arrays which describe our planes */
+void
+Image::allocate_pointers ()
 {
 	_data = (uint8_t **) wrapped_av_malloc (4 * sizeof (uint8_t *));
 	_data[0] = _data[1] = _data[2] = _data[3] = 0;
@@ -837,7 +1006,12 @@ Image::allocate ()
 
 	_stride = (int *) wrapped_av_malloc (4 * sizeof (int));
 	_stride[0] = _stride[1] = _stride[2] = _stride[3] = 0;
+}
 
+/** Allocate memory for the data of each plane, setting up _line_size, _stride and _data */
+void
+Image::allocate_planes ()
+{
 	for (int i = 0; i < planes(); ++i) {
 		_line_size[i] = ceil (_size.width * bytes_per_pixel(i));
 		_stride[i] = stride_round_up (i, _line_size, _aligned ? 32 : 1);
@@ -856,22 +1030,30 @@ Image::allocate ()
 		   so I'll just over-allocate by 32 bytes and have done with it.  Empirical
 		   testing suggests that it works.
 		*/
-		_data[i] = (uint8_t *) wrapped_av_malloc (_stride[i] * sample_size(i).height + _extra_pixels * bytes_per_pixel(i) + 32);
+		_data[i] = ImageBufferPool::instance()->get (allocation_size (i));
 #if HAVE_VALGRIND_MEMCHECK_H
 		/* The data between the end of the line size and the stride is undefined but processed by
 		   libswscale, causing lots of valgrind errors.  Mark it all defined to quell these errors.
 		*/
-		VALGRIND_MAKE_MEM_DEFINED (_data[i], _stride[i] * sample_size(i).height + _extra_pixels * bytes_per_pixel(i) + 32);
+		VALGRIND_MAKE_MEM_DEFINED (_data[i], allocation_size (i));
 #endif
 	}
 }
 
+/** @return Size of the buffer that allocate() makes for a plane, in bytes */
+size_t
+Image::allocation_size (int plane) const
+{
+	return _stride[plane] * sample_size(plane).height + _extra_pixels * bytes_per_pixel(plane) + 32;
+}
+
 Image::Image (Image const & other)
 	: boost::enable_shared_from_this<Image>(other)
 	, _size (other._size)
 	, _pixel_format (other._pixel_format)
 	, _aligned (other._aligned)
 	, _extra_pixels (other._extra_pixels)
+	, _frame (0)
 {
 	allocate ();
 
@@ -892,8 +1074,32 @@ Image::Image (AVFrame* frame)
 	, _pixel_format (static_cast<AVPixelFormat> (frame->format))
 	, _aligned (true)
 	, _extra_pixels (0)
+	, _frame (0)
 {
-	allocate ();
+	allocate_pointers ();
+	for (int i = 0; i < planes(); ++i) {
+		_line_size[i] = ceil (_size.width * bytes_per_pixel(i));
+		/* AVFrame's linesize is what we call `stride' */
+		_stride[i] = frame->linesize[i];
+	}
+
+	if (can_share (frame)) {
+		/* Take a reference to the frame's data and use it in place; it will be
+		   copied by make_writable() if anybody wants to change it.
+		*/
+		_frame = av_frame_alloc ();
+		if (!_frame || av_frame_ref (_frame, frame) < 0) {
+			av_frame_free (&_frame);
+			throw bad_alloc ();
+		}
+
+		for (int i = 0; i < planes(); ++i) {
+			_data[i] = _frame->data[i];
+		}
+		return;
+	}
+
+	allocate_planes ();
 
 	for (int i = 0; i < planes(); ++i) {
 		uint8_t* p = _data[i];
@@ -908,11 +1114,85 @@ Image::Image (AVFrame* frame)
 	}
 }
 
+/** @return true if we can use the data in an AVFrame in place, rather than copying it;
+ *  this requires the frame's data to be reference-counted and laid out as an aligned
+ *  Image's would be, with each plane's buffer as big as allocate() would have made it
+ *  (so that code which reads past the end of the last line, as some of libswscale does,
+ *  stays inside the buffer).  _stride must have been set up from the frame's linesize.
+ */
+bool
+Image::can_share (AVFrame const * frame) const
+{
+	if (!frame->buf[0]) {
+		return false;
+	}
+
+	AVPixFmtDescriptor const * d = av_pix_fmt_desc_get (_pixel_format);
+	if (!d || (d->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))) {
+		return false;
+	}
+
+	for (int i = 0; i < planes(); ++i) {
+		if (
+			!frame->data[i] ||
+			frame->linesize[i] < ceil (_size.width * bytes_per_pixel(i)) ||
+			(frame->linesize[i] % 32) ||
+			(reinterpret_cast<uintptr_t> (frame->data[i]) % 32)
+			) {
+			return false;
+		}
+
+		/* Find the buffer that this plane is in and check that it is big enough */
+		bool covered = false;
+		for (int j = 0; j < AV_NUM_DATA_POINTERS && frame->buf[j]; ++j) {
+			uint8_t const * start = frame->buf[j]->data;
+			uint8_t const * end = start + frame->buf[j]->size;
+			if (frame->data[i] >= start && frame->data[i] < end) {
+				covered = size_t (end - frame->data[i]) >= allocation_size (i);
+				break;
+			}
+		}
+
+		if (!covered) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** If we are sharing an AVFrame's data, copy it into our own memory
+ *  so that we can change it without affecting anybody else.
+ */
+void
+Image::make_writable ()
+{
+	if (!_frame) {
+		return;
+	}
+
+	allocate_planes ();
+
+	for (int i = 0; i < planes(); ++i) {
+		uint8_t* p = _data[i];
+		uint8_t* q = _frame->data[i];
+		int const lines = sample_size(i).height;
+		for (int j = 0; j < lines; ++j) {
+			memcpy (p, q, _line_size[i]);
+			p += _stride[i];
+			q += _frame->linesize[i];
+		}
+	}
+
+	av_frame_free (&_frame);
+}
+
 Image::Image (shared_ptr<const Image> other, bool aligned)
 	: _size (other->_size)
 	, _pixel_format (other->_pixel_format)
 	, _aligned (aligned)
 	, _extra_pixels (other->_extra_pixels)
+	, _frame (0)
 {
 	allocate ();
 
@@ -955,13 +1235,18 @@ Image::swap (Image & other)
 
 	std::swap (_aligned, other._aligned);
 	std::swap (_extra_pixels, other._extra_pixels);
+	std::swap (_frame, other._frame);
 }
 
 /** Destroy a Image */
 Image::~Image ()
 {
-	for (int i = 0; i < planes(); ++i) {
-		av_free (_data[i]);
+	if (_frame) {
+		av_frame_free (&_frame);
+	} else {
+		for (int i = 0; i < planes(); ++i) {
+			ImageBufferPool::instance()->put (_data[i], allocation_size (i));
+		}
 	}
 
 	av_free (_data);
@@ -975,6 +1260,17 @@ Image::data () const
 	return _data;
 }
 
+/** @return Our data, for writing to; this must not be called on an Image which is
+ *  sharing an AVFrame's data, as that would change the frame for everybody else.
+ *  Code which only reads should use the const version.
+ */
+uint8_t * const *
+Image::data ()
+{
+	DCPOMATIC_ASSERT (!_frame);
+	return _data;
+}
+
 int const *
 Image::line_size () const
 {
@@ -1058,6 +1354,23 @@ operator== (Image const & a, Image const & b)
 void
 Image::fade (float f)
 {
+	fade (f, dcpomatic::Rect<int> (0, 0, size().width, size().height));
+}
+
+/** Fade part of the image, leaving the rest as it is.
+ *  @param f Amount to fade by; 0 is black, 1 is no fade.
+ *  @param area Area to fade; this may be made a little bigger to take in whole subsampled pixels.
+ */
+void
+Image::fade (float f, dcpomatic::Rect<int> area)
+{
+	make_writable ();
+
+	optional<dcpomatic::Rect<int> > const clipped = area.intersection (dcpomatic::Rect<int> (0, 0, size().width, size().height));
+	if (!clipped || clipped->width == 0 || clipped->height == 0) {
+		return;
+	}
+
 	switch (_pixel_format) {
 	case AV_PIX_FMT_YUV420P:
 	case AV_PIX_FMT_YUV422P:
@@ -1073,17 +1386,8 @@ Image::fade (float f)
 	case AV_PIX_FMT_BGRA:
 	case AV_PIX_FMT_RGB555LE:
 		/* 8-bit */
-		for (int c = 0; c < 3; ++c) {
-			uint8_t* p = data()[c];
-			int const lines = sample_size(c).height;
-			for (int y = 0; y < lines; ++y) {
-				uint8_t* q = p;
-				for (int x = 0; x < line_size()[c]; ++x) {
-					*q = int (float (*q) * f);
-					++q;
-				}
-				p += stride()[c];
-			}
+		for (int c = 0; c < min (3, planes()); ++c) {
+			fade_plane (c, f, *clipped, 1, false, 1);
 		}
 		break;
 
@@ -1102,19 +1406,8 @@ Image::fade (float f)
 	case AV_PIX_FMT_RGB48LE:
 	case AV_PIX_FMT_XYZ12LE:
 		/* 16-bit little-endian */
-		for (int c = 0; c < 3; ++c) {
-			int const stride_pixels = stride()[c] / 2;
-			int const line_size_pixels = line_size()[c] / 2;
-			uint16_t* p = reinterpret_cast<uint16_t*> (data()[c]);
-			int const lines = sample_size(c).height;
-			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = int (float (*q) * f);
-					++q;
-				}
-				p += stride_pixels;
-			}
+		for (int c = 0; c < min (3, planes()); ++c) {
+			fade_plane (c, f, *clipped, 2, false, 2);
 		}
 		break;
 
@@ -1133,41 +1426,50 @@ Image::fade (float f)
 	case AV_PIX_FMT_YUVA444P16BE:
 	case AV_PIX_FMT_RGB48BE:
 		/* 16-bit big-endian */
-		for (int c = 0; c < 3; ++c) {
-			int const stride_pixels = stride()[c] / 2;
-			int const line_size_pixels = line_size()[c] / 2;
-			uint16_t* p = reinterpret_cast<uint16_t*> (data()[c]);
-			int const lines = sample_size(c).height;
-			for (int y = 0; y < lines; ++y) {
-				uint16_t* q = p;
-				for (int x = 0; x < line_size_pixels; ++x) {
-					*q = swap_16 (int (float (swap_16 (*q)) * f));
-					++q;
-				}
-				p += stride_pixels;
-			}
+		for (int c = 0; c < min (3, planes()); ++c) {
+			fade_plane (c, f, *clipped, 2, true, 2);
 		}
 		break;
 
 	case AV_PIX_FMT_UYVY422:
-	{
-		int const Y = sample_size(0).height;
-		int const X = line_size()[0];
-		uint8_t* p = data()[0];
-		for (int y = 0; y < Y; ++y) {
-			for (int x = 0; x < X; ++x) {
-				*p = int (float (*p) * f);
-				++p;
-			}
-		}
+		/* 8-bit, with each 4 bytes holding 2 pixels */
+		fade_plane (0, f, *clipped, 1, false, 4);
 		break;
-	}
 
 	default:
 		throw PixelFormatError ("fade()", _pixel_format);
 	}
 }
 
+/** Fade the part of one plane which holds an area of the image.
+ *  @param c Plane.
+ *  @param f Amount to fade by; 0 is black, 1 is no fade.
+ *  @param area Area of the image, which must be within the image.
+ *  @param sample_bytes Size of each sample in bytes (1 or 2).
+ *  @param big_endian true if 2-byte samples are big-endian.
+ *  @param align Number of bytes to round the start and end of the area in each row out to.
+ */
+void
+Image::fade_plane (int c, float f, dcpomatic::Rect<int> area, int sample_bytes, bool big_endian, int align)
+{
+	pair<int, int> const rows = plane_rows (c, area.y, area.y + area.height);
+	int const start = (int (floor (area.x * bytes_per_pixel(c))) / align) * align;
+	int const end = min (line_size()[c], ((int (ceil ((area.x + area.width) * bytes_per_pixel(c))) + align - 1) / align) * align);
+	if (end <= start) {
+		return;
+	}
+
+	uint8_t* p = data()[c] + rows.first * stride()[c] + start;
+	for (int y = rows.first; y < rows.second; ++y) {
+		if (sample_bytes == 1) {
+			Fader::fade_8 (p, end - start, f);
+		} else {
+			Fader::fade_16 (reinterpret_cast<uint16_t*> (p), (end - start) / 2, f, big_endian);
+		}
+		p += stride()[c];
+	}
+}
+
 shared_ptr<const Image>
 Image::ensure_aligned (shared_ptr<const Image> image)
 {
@@ -1188,6 +1490,15 @@ Image::memory_used () const
 	return m;
 }
 
+/** @return Memory used by buffers which belong to no Image at the moment, but which are being kept
+ *  to be re-used by new ones.
+ */
+size_t
+Image::pooled_memory ()
+{
+	return ImageBufferPool::instance()->held ();
+}
+
 class Memory
 {
 public:
@@ -28,6 +28,8 @@
 #include "position.h"
 #include "position_image.h"
 #include "types.h"
+#include "alpha_blender.h"
+#include "rect.h"
 extern "C" {
 #include <libavutil/pixfmt.h>
 }
@@ -37,7 +39,17 @@ extern "C" {
 
 struct AVFrame;
 class Socket;
-
+class Digester;
+
+/** @class Image
+ *  @brief An image in memory.
+ *
+ *  An Image made from an AVFrame may share that frame's data rather than copying it;
+ *  the shared data is copied into the Image's own memory the first time one of the
+ *  methods which change the image (make_black(), fade() and so on) is called.  Code
+ *  which writes to data() directly should only do so to Images that it made itself;
+ *  the non-const data() asserts that the Image is not sharing a frame's data.
+ */
 class Image : public boost::enable_shared_from_this<Image>
 {
 public:
@@ -49,6 +61,7 @@ public:
 	~Image ();
 
 	uint8_t * const * data () const;
+	uint8_t * const * data ();
 	int const * line_size () const;
 	int const * stride () const;
 	dcp::Size size () const;
@@ -63,23 +76,28 @@ public:
 	boost::shared_ptr<Image> convert_pixel_format (dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast) const;
 	boost::shared_ptr<Image> scale (dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast) const;
 	boost::shared_ptr<Image> crop_scale_window (
-		Crop crop, dcp::Size inter_size, dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast
+		Crop crop, dcp::Size inter_size, dcp::Size out_size, dcp::YUVToRGB yuv_to_rgb, AVPixelFormat out_format, bool aligned, bool fast, bool parallel = false
 		) const;
 
 	void make_black ();
 	void make_transparent ();
-	void alpha_blend (boost::shared_ptr<const Image> image, Position<int> pos);
+	void alpha_blend (boost::shared_ptr<const Image> image, Position<int> pos, AlphaBlender::Kernel kernel = AlphaBlender::best_kernel());
 	void copy (boost::shared_ptr<const Image> image, Position<int> pos);
 	void fade (float);
+	void fade (float, dcpomatic::Rect<int> area);
 
 	void read_from_socket (boost::shared_ptr<Socket>);
 	void write_to_socket (boost::shared_ptr<Socket>) const;
+	void read_compressed_from_socket (boost::shared_ptr<Socket>);
+	void write_compressed_to_socket (boost::shared_ptr<Socket>) const;
 
 	AVPixelFormat pixel_format () const {
 		return _pixel_format;
 	}
 
 	size_t memory_used () const;
+	static size_t pooled_memory ();
+	void add_digest (Digester& digester) const;
 
 	dcp::Data as_png () const;
 
@@ -91,8 +109,17 @@ private:
 	friend struct pixel_formats_test;
 
 	void allocate ();
+	void allocate_pointers ();
+	void allocate_planes ();
+	size_t allocation_size (int plane) const;
+	bool can_share (AVFrame const * frame) const;
+	void make_writable ();
 	void swap (Image &);
-	void yuv_16_black (uint16_t, bool);
+	void make_rows_black (int from, int to);
+	std::pair<int, int> plane_rows (int c, int from, int to) const;
+	void fill_rows (int c, int from, int to, uint8_t const * pattern, int pattern_size);
+	void yuv_16_black (uint16_t v, bool alpha, int from, int to);
+	void fade_plane (int c, float f, dcpomatic::Rect<int> area, int sample_bytes, bool big_endian, int align);
 	static uint16_t swap_16 (uint16_t);
 
 	dcp::Size _size;
@@ -102,6 +129,8 @@ private:
 	int* _stride; ///< array of strides for each line, in bytes (including any alignment padding bytes)
 	bool _aligned;
 	int _extra_pixels;
+	/** frame whose data we are sharing, or 0 if _data is our own */
+	AVFrame* _frame;
 };
 
 extern PositionImage merge (std::list<PositionImage> images);
@@ -0,0 +1,177 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/image_buffer_pool.cc
+ *  @brief ImageBufferPool class.
+ */
+
+#include "image_buffer_pool.h"
+#include "util.h"
+#include "dcpomatic_assert.h"
+extern "C" {
+#include <libavutil/mem.h>
+}
+#include <boost/bind.hpp>
+
+using std::map;
+using std::vector;
+
+ImageBufferPool* ImageBufferPool::_instance = 0;
+boost::mutex ImageBufferPool::_instance_mutex;
+
+ImageBufferPool::ImageBufferPool ()
+	: _held (0)
+	, _maximum (size_t (Config::instance()->image_buffer_pool_size()) * 1000000)
+	, _hits (0)
+	, _misses (0)
+{
+	Config::instance()->Changed.connect (boost::bind (&ImageBufferPool::config_changed, this, _1));
+}
+
+void
+ImageBufferPool::config_changed (Config::Property what)
+{
+	if (what == Config::OTHER) {
+		set_maximum_size (size_t (Config::instance()->image_buffer_pool_size()) * 1000000);
+	}
+}
+
+/** Set the maximum total size of the buffers in the pool, freeing any that no longer fit.
+ *  @param bytes New maximum size in bytes.
+ */
+void
+ImageBufferPool::set_maximum_size (size_t bytes)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_maximum = bytes;
+	while (_held > _maximum) {
+		free_one ();
+	}
+}
+
+ImageBufferPool*
+ImageBufferPool::instance ()
+{
+	boost::mutex::scoped_lock lm (_instance_mutex);
+	if (!_instance) {
+		_instance = new ImageBufferPool ();
+	}
+
+	return _instance;
+}
+
+/** @return A buffer of \p size bytes, which should be given back with put() */
+uint8_t*
+ImageBufferPool::get (size_t size)
+{
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		map<size_t, vector<uint8_t*> >::iterator i = _buffers.find (size);
+		if (i != _buffers.end() && !i->second.empty()) {
+			uint8_t* b = i->second.back ();
+			i->second.pop_back ();
+			if (i->second.empty ()) {
+				_buffers.erase (i);
+				_sizes.remove (size);
+			}
+			_held -= size;
+			++_hits;
+			return b;
+		}
+		++_misses;
+	}
+
+	return static_cast<uint8_t*> (wrapped_av_malloc (size));
+}
+
+/** Give back a buffer which came from get(), so that it can be used again
+ *  @param size Size that was passed to get().
+ */
+void
+ImageBufferPool::put (uint8_t* buffer, size_t size)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (size > _maximum) {
+		av_free (buffer);
+		return;
+	}
+
+	while (_held + size > _maximum) {
+		free_one ();
+	}
+
+	_buffers[size].push_back (buffer);
+	_held += size;
+
+	_sizes.remove (size);
+	_sizes.push_front (size);
+}
+
+/** Free a buffer of the least recently used size.  Must be called with _mutex held */
+void
+ImageBufferPool::free_one ()
+{
+	DCPOMATIC_ASSERT (!_sizes.empty ());
+
+	size_t const size = _sizes.back ();
+	vector<uint8_t*>& buffers = _buffers[size];
+	DCPOMATIC_ASSERT (!buffers.empty ());
+
+	av_free (buffers.back ());
+	buffers.pop_back ();
+	_held -= size;
+
+	if (buffers.empty ()) {
+		_buffers.erase (size);
+		_sizes.pop_back ();
+	}
+}
+
+/** Free all the buffers in the pool */
+void
+ImageBufferPool::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	while (!_sizes.empty ()) {
+		free_one ();
+	}
+}
+
+uint64_t
+ImageBufferPool::hits () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _hits;
+}
+
+uint64_t
+ImageBufferPool::misses () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _misses;
+}
+
+size_t
+ImageBufferPool::held () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _held;
+}
@@ -0,0 +1,84 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_IMAGE_BUFFER_POOL_H
+#define DCPOMATIC_IMAGE_BUFFER_POOL_H
+
+/** @file  src/lib/image_buffer_pool.h
+ *  @brief ImageBufferPool class.
+ */
+
+#include "config.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <vector>
+
+/** @class ImageBufferPool
+ *  @brief A store of the buffers used for Image planes, so that the many images of the
+ *  same few sizes which are made and thrown away during an encode or playback can re-use
+ *  each other's memory rather than going back to the allocator (and the kernel) each time.
+ *
+ *  Buffers are kept by size.  When keeping a buffer would take the pool over its maximum size
+ *  buffers of the least recently used sizes are freed first.  The maximum is taken from
+ *  Config::image_buffer_pool_size() when the pool is made and whenever the config changes.
+ */
+class ImageBufferPool : public boost::noncopyable
+{
+public:
+	uint8_t* get (size_t size);
+	void put (uint8_t* buffer, size_t size);
+	void clear ();
+	void set_maximum_size (size_t bytes);
+
+	/** @return number of times that get() has returned a buffer from the pool */
+	uint64_t hits () const;
+	/** @return number of times that get() has had to allocate a buffer */
+	uint64_t misses () const;
+	/** @return total size of the buffers in the pool, in bytes */
+	size_t held () const;
+
+	static ImageBufferPool* instance ();
+
+private:
+	ImageBufferPool ();
+
+	void free_one ();
+	void config_changed (Config::Property);
+
+	/** mutex for everything below */
+	mutable boost::mutex _mutex;
+	/** buffers keyed by size */
+	std::map<size_t, std::vector<uint8_t*> > _buffers;
+	/** sizes in _buffers, most recently used first */
+	std::list<size_t> _sizes;
+	size_t _held;
+	/** maximum total size of the buffers in the pool, in bytes */
+	size_t _maximum;
+	uint64_t _hits;
+	uint64_t _misses;
+
+	static ImageBufferPool* _instance;
+	static boost::mutex _instance_mutex;
+};
+
+#endif
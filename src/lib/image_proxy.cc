@@ -25,6 +25,7 @@
 #include "image.h"
 #include "exceptions.h"
 #include "cross.h"
+#include "binary_encoding_request.h"
 #include <dcp/util.h>
 #include <libcxml/cxml.h>
 #include <iostream>
@@ -48,3 +49,10 @@ image_proxy_factory (shared_ptr<cxml::Node> xml, shared_ptr<Socket> socket)
 
 	throw NetworkError (_("Unexpected image type received by server"));
 }
+
+shared_ptr<ImageProxy>
+image_proxy_factory (BinaryEncodingRequest const & request, shared_ptr<Socket> socket)
+{
+	/* Only raw images are sent this way */
+	return shared_ptr<ImageProxy> (new RawImageProxy (request, socket));
+}
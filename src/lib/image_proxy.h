@@ -35,6 +35,8 @@ extern "C" {
 
 class Image;
 class Socket;
+class Digester;
+class BinaryEncodingRequest;
 
 namespace xmlpp {
 	class Node;
@@ -72,6 +74,12 @@ public:
 		) const = 0;
 
 	virtual void add_metadata (xmlpp::Node *) const = 0;
+	/** Describe this proxy in a BinaryEncodingRequest, if possible.
+	 *  @return true if this proxy can be sent using a BinaryEncodingRequest, otherwise false.
+	 */
+	virtual bool add_binary_metadata (BinaryEncodingRequest &) const {
+		return false;
+	}
 	virtual void send_binary (boost::shared_ptr<Socket>) const = 0;
 	/** @return true if our image is definitely the same as another, false if it is probably not */
 	virtual bool same (boost::shared_ptr<const ImageProxy>) const = 0;
@@ -81,8 +89,15 @@ public:
 	 */
 	virtual int prepare (boost::optional<dcp::Size> = boost::optional<dcp::Size>()) const { return 0; }
 	virtual size_t memory_used () const = 0;
+	/** Add everything that affects the image that we produce to a Digester */
+	virtual void add_digest (Digester &) const = 0;
+	/** @return true if add_digest() is quick; false if it has to look at a whole uncompressed image */
+	virtual bool digest_is_cheap () const {
+		return true;
+	}
 };
 
 boost::shared_ptr<ImageProxy> image_proxy_factory (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
+boost::shared_ptr<ImageProxy> image_proxy_factory (BinaryEncodingRequest const & request, boost::shared_ptr<Socket> socket);
 
 #endif
@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/in_flight_frames.cc
+ *  @brief InFlightFrames class.
+ */
+
+#include "in_flight_frames.h"
+#include <boost/thread.hpp>
+
+using std::string;
+using std::list;
+using std::map;
+using std::pair;
+using std::make_pair;
+using boost::shared_ptr;
+
+/** Note that a frame has been sent to a server.
+ *  @param deadline Time (in seconds, from gettimeofday()) after which the frame will be considered late.
+ */
+void
+InFlightFrames::start (shared_ptr<DCPVideo> frame, string server, double deadline)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_frames.insert (make_pair (frame, Frame (server, deadline)));
+}
+
+/** Note that a frame from a server, or a local copy of one, has been encoded.
+ *  @return true if this is the first time, so that the frame should be written.
+ */
+bool
+InFlightFrames::finish (shared_ptr<DCPVideo> frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	bool const first = _frames.erase (frame) > 0;
+	_condition.notify_all ();
+	return first;
+}
+
+/** Note that a server could not encode a frame.
+ *  @return true if the frame should be put back into the queue; false if a local copy
+ *  is being encoded, or has already been encoded and written.
+ */
+bool
+InFlightFrames::fail (shared_ptr<DCPVideo> frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	map<shared_ptr<DCPVideo>, Frame>::iterator i = _frames.find (frame);
+	if (i == _frames.end()) {
+		/* Another copy has already finished */
+		return false;
+	}
+
+	if (i->second.duplicated) {
+		/* Leave it to the local copy */
+		return false;
+	}
+
+	_frames.erase (i);
+	_condition.notify_all ();
+	return true;
+}
+
+/** @return true if a frame is being encoded by a server and has not yet been finished */
+bool
+InFlightFrames::contains (shared_ptr<DCPVideo> frame) const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _frames.find (frame) != _frames.end ();
+}
+
+/** Called by a local thread to see if a frame that it has taken is a copy of one that is late from a server.
+ *  @return true if it is.
+ */
+bool
+InFlightFrames::take_duplicate (shared_ptr<DCPVideo> frame)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _duplicates.erase (frame) > 0;
+}
+
+/** Mark any frames which are late, and which have not been marked before, as duplicated.
+ *  The caller must give them to local threads.
+ *  @param now Current time (in seconds, from gettimeofday()).
+ *  @return The late frames and the host names of the servers that they were sent to.
+ */
+list<pair<shared_ptr<DCPVideo>, string> >
+InFlightFrames::duplicate_late (double now)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	list<pair<shared_ptr<DCPVideo>, string> > late;
+	for (map<shared_ptr<DCPVideo>, Frame>::iterator i = _frames.begin(); i != _frames.end(); ++i) {
+		if (!i->second.duplicated && now > i->second.deadline) {
+			i->second.duplicated = true;
+			_duplicates.insert (i->first);
+			late.push_back (make_pair (i->first, i->second.server));
+		}
+	}
+
+	return late;
+}
+
+bool
+InFlightFrames::empty () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _frames.empty ();
+}
+
+/** Wait for a frame to be finished or failed, or for a timeout, unless there is nothing in flight */
+void
+InFlightFrames::wait (int seconds)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	if (!_frames.empty ()) {
+		_condition.timed_wait (lm, boost::posix_time::seconds (seconds));
+	}
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_IN_FLIGHT_FRAMES_H
+#define DCPOMATIC_IN_FLIGHT_FRAMES_H
+
+/** @file  src/lib/in_flight_frames.h
+ *  @brief InFlightFrames class.
+ */
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+
+class DCPVideo;
+
+/** @class InFlightFrames
+ *  @brief Frames which J2KEncoder has sent to encode servers and which have not yet come back.
+ *
+ *  Frames which are late may also be given to local threads as duplicates; whichever copy
+ *  finishes first is written and the other is dropped.
+ */
+class InFlightFrames : public boost::noncopyable
+{
+public:
+	void start (boost::shared_ptr<DCPVideo> frame, std::string server, double deadline);
+	bool finish (boost::shared_ptr<DCPVideo> frame);
+	bool fail (boost::shared_ptr<DCPVideo> frame);
+	bool contains (boost::shared_ptr<DCPVideo> frame) const;
+	bool take_duplicate (boost::shared_ptr<DCPVideo> frame);
+	std::list<std::pair<boost::shared_ptr<DCPVideo>, std::string> > duplicate_late (double now);
+	bool empty () const;
+	void wait (int seconds);
+
+private:
+	/** A frame which has been sent to a server */
+	struct Frame
+	{
+		Frame (std::string s, double d)
+			: server (s)
+			, deadline (d)
+			, duplicated (false)
+		{}
+
+		/** host name of the server */
+		std::string server;
+		/** time (in seconds, from gettimeofday()) after which we consider the frame to be late */
+		double deadline;
+		/** true if the frame has also been given to local threads */
+		bool duplicated;
+	};
+
+	/** mutex for _frames and _duplicates */
+	mutable boost::mutex _mutex;
+	/** frames which are being encoded by servers */
+	std::map<boost::shared_ptr<DCPVideo>, Frame> _frames;
+	/** frames from _frames which have been given to local threads, but not yet taken */
+	std::set<boost::shared_ptr<DCPVideo> > _duplicates;
+	/** condition to wake wait() when something leaves _frames */
+	boost::condition _condition;
+};
+
+#endif
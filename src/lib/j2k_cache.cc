@@ -0,0 +1,254 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/j2k_cache.cc
+ *  @brief J2KCache class.
+ */
+
+#include "j2k_cache.h"
+#include "digester.h"
+#include "compose.hpp"
+#include "version.h"
+#include "dcpomatic_log.h"
+#include "log.h"
+#include <dcp/version.h>
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <vector>
+#include <ctime>
+
+#include "i18n.h"
+
+using std::string;
+using std::vector;
+using std::sort;
+using boost::optional;
+using dcp::Data;
+
+/** Version of the way that frames are stored in the cache; increment this if it changes */
+static int const j2k_cache_format = 1;
+
+/** @param directory Directory to keep the cache in; it will be created if required.
+ *  @param maximum_size Maximum total size of the cache in bytes.
+ */
+J2KCache::J2KCache (boost::filesystem::path directory, uint64_t maximum_size)
+	: _directory (directory)
+	, _maximum_size (maximum_size)
+	, _version (String::compose ("%1 %2 %3", j2k_cache_format, dcpomatic_git_commit, dcp::git_commit))
+	, _size (0)
+	, _added (0)
+	/* Find out how big the cache is in the background, as it may take a while */
+	, _evict_needed (true)
+{
+	boost::filesystem::create_directories (_directory);
+
+	_evict_thread = new boost::thread (boost::bind (&J2KCache::evict_thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_evict_thread->native_handle(), "j2k-cache-evict");
+#endif
+}
+
+J2KCache::~J2KCache ()
+{
+	_evict_thread->interrupt ();
+	try {
+		_evict_thread->join ();
+	} catch (boost::thread_interrupted& e) {
+		/* No problem */
+	}
+	delete _evict_thread;
+}
+
+/** @return Path of the file for a digest; we use subdirectories so that none of them gets too big */
+boost::filesystem::path
+J2KCache::file (string digest) const
+{
+	Digester digester;
+	digester.add (digest);
+	digester.add (_version);
+	string const name = digester.get ();
+	return _directory / name.substr (0, 2) / (name + ".j2c");
+}
+
+/** @param digest DCPVideo::digest() of a frame.
+ *  @return J2K data for the frame, if we have it.
+ */
+optional<Data>
+J2KCache::get (string digest)
+{
+	boost::filesystem::path const f = file (digest);
+
+	boost::system::error_code ec;
+	if (!boost::filesystem::exists (f, ec)) {
+		return optional<Data> ();
+	}
+
+	try {
+		Data data (f);
+		/* Mark this file as recently used */
+		boost::filesystem::last_write_time (f, time (0), ec);
+		return data;
+	} catch (std::exception& e) {
+		/* Most likely it was deleted by somebody else just now */
+		LOG_GENERAL (N_("Could not read %1 from J2K cache (%2)"), digest, e.what ());
+	}
+
+	return optional<Data> ();
+}
+
+/** Add a frame to the cache, deleting old frames if we go over the maximum size.
+ *  @param digest DCPVideo::digest() of the frame.
+ *  @param data J2K data.
+ */
+void
+J2KCache::put (string digest, Data data)
+{
+	boost::filesystem::path const f = file (digest);
+
+	/* If the file is already there (e.g. because another thread has just put the same frame)
+	   we will replace it, and the cache will not get any bigger.
+	*/
+	boost::system::error_code ec;
+	bool const existed = boost::filesystem::exists (f, ec);
+
+	try {
+		boost::filesystem::create_directories (f.parent_path ());
+		/* Write via a temporary file so that nobody ever sees half a frame */
+		boost::filesystem::path const temp = f.parent_path() / (digest + "." + boost::filesystem::unique_path().string() + ".tmp");
+		data.write_via_temp (temp, f);
+	} catch (std::exception& e) {
+		LOG_ERROR (N_("Could not write %1 to J2K cache (%2)"), digest, e.what ());
+		return;
+	}
+
+	if (existed) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+	_size += data.size ();
+	_added += data.size ();
+	if (_size > _maximum_size && !_evict_needed) {
+		_evict_needed = true;
+		_evict_condition.notify_all ();
+	}
+}
+
+/** Thread to call evict() when we start, and then when put() has taken us over the maximum
+ *  size, so that neither our constructor nor the threads calling put() have to wait for it.
+ */
+void
+J2KCache::evict_thread ()
+try
+{
+	while (true) {
+		{
+			boost::mutex::scoped_lock lm (_mutex);
+			while (!_evict_needed) {
+				_evict_condition.wait (lm);
+			}
+			_added = 0;
+		}
+
+		uint64_t const total = evict ();
+
+		boost::mutex::scoped_lock lm (_mutex);
+		/* Anything put while we were looking may or may not have been counted in total;
+		   assume that it was not, so that we err on the side of a bigger cache.
+		*/
+		_size = total + _added;
+		_evict_needed = false;
+	}
+}
+catch (boost::thread_interrupted& e)
+{
+	/* The thread is being terminated */
+}
+
+/** Find out how big the cache is and, if it is too big, delete the least recently used
+ *  frames until it is comfortably below its maximum size.  We look at the directory each time
+ *  as other instances of DCP-o-matic may be using it too.  This is a boost::thread interruption point.
+ *  @return Total size of the cache in bytes afterwards.
+ */
+uint64_t
+J2KCache::evict () const
+{
+	struct Entry
+	{
+		Entry (boost::filesystem::path p, time_t t, uintmax_t s)
+			: path (p)
+			, time (t)
+			, size (s)
+		{}
+
+		bool operator< (Entry const & other) const {
+			return time < other.time;
+		}
+
+		boost::filesystem::path path;
+		time_t time;
+		uintmax_t size;
+	};
+
+	vector<Entry> entries;
+	uint64_t total = 0;
+
+	boost::system::error_code ec;
+	for (boost::filesystem::recursive_directory_iterator i (_directory, ec); !ec && i != boost::filesystem::recursive_directory_iterator(); i.increment (ec)) {
+		boost::this_thread::interruption_point ();
+		if (i->path().extension() != ".j2c") {
+			continue;
+		}
+		boost::system::error_code ec2;
+		uintmax_t const size = boost::filesystem::file_size (i->path(), ec2);
+		time_t const time = boost::filesystem::last_write_time (i->path(), ec2);
+		if (!ec2) {
+			entries.push_back (Entry (i->path(), time, size));
+			total += size;
+		}
+	}
+
+	if (total > _maximum_size) {
+		sort (entries.begin(), entries.end());
+		uint64_t const target = _maximum_size * 9 / 10;
+		int removed = 0;
+		BOOST_FOREACH (Entry const & i, entries) {
+			if (total <= target) {
+				break;
+			}
+			boost::system::error_code ec2;
+			if (boost::filesystem::remove (i.path, ec2)) {
+				total -= i.size;
+				++removed;
+			}
+		}
+		LOG_GENERAL (N_("Removed %1 frames from J2K cache"), removed);
+	}
+
+	return total;
+}
+
+/** @return Total size of the cache in bytes, as far as we know */
+uint64_t
+J2KCache::size () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _size;
+}
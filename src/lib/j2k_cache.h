@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_J2K_CACHE_H
+#define DCPOMATIC_J2K_CACHE_H
+
+/** @file  src/lib/j2k_cache.h
+ *  @brief J2KCache class.
+ */
+
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <string>
+
+/** @class J2KCache
+ *  @brief A directory of encoded J2K frames, named by DCPVideo::digest(), which
+ *  can be shared between films and between runs of DCP-o-matic.
+ *
+ *  Files are named by a digest of DCPVideo::digest() together with the cache format
+ *  and the versions of DCP-o-matic and libdcp, so that J2K data made by different
+ *  code is never used.
+ *
+ *  When the files in the directory come to more than a maximum size the ones
+ *  which were least recently used (according to their modification times, which
+ *  are updated when a frame is taken from the cache) are deleted by a thread of
+ *  our own.  Files left by other versions are never used, so they are deleted in time.
+ */
+class J2KCache : public boost::noncopyable
+{
+public:
+	J2KCache (boost::filesystem::path directory, uint64_t maximum_size);
+	~J2KCache ();
+
+	boost::optional<dcp::Data> get (std::string digest);
+	void put (std::string digest, dcp::Data data);
+
+	uint64_t size () const;
+
+private:
+	boost::filesystem::path file (std::string digest) const;
+	uint64_t evict () const;
+	void evict_thread ();
+
+	boost::filesystem::path _directory;
+	uint64_t _maximum_size;
+	/** description of the cache format and the code which makes the J2K data */
+	std::string _version;
+
+	/** mutex for the things below */
+	mutable boost::mutex _mutex;
+	/** total size of the files in the cache, as far as we know; this will be too small
+	 *  until evict_thread() has first looked at the directory.
+	 */
+	uint64_t _size;
+	/** bytes that have been added since evict_thread() started looking at the directory */
+	uint64_t _added;
+	/** true if evict_thread() has been asked to run and has not yet finished */
+	bool _evict_needed;
+	/** condition to wake evict_thread() */
+	boost::condition _evict_condition;
+
+	boost::thread* _evict_thread;
+};
+
+#endif
@@ -35,6 +35,10 @@
 #include "player.h"
 #include "player_video.h"
 #include "encode_server_description.h"
+#include "encode_server_connection.h"
+#include "j2k_cache.h"
+#include "sws_context_cache.h"
+#include "image_buffer_pool.h"
 #include "compose.hpp"
 #include <libcxml/cxml.h>
 #include <boost/foreach.hpp>
@@ -43,20 +47,43 @@
 #include "i18n.h"
 
 using std::list;
+using std::map;
+using std::max;
+using std::min;
+using std::pair;
+using std::string;
+using std::vector;
 using std::cout;
 using boost::shared_ptr;
 using boost::weak_ptr;
 using boost::optional;
 using dcp::Data;
 
+/** Multiple of a server's usual time per frame after which we say that a frame is late */
+static float const straggler_factor = 3;
+/** Minimum time in seconds before we say that a frame is late */
+static float const minimum_straggler_time = 10;
+/** Maximum size in bytes of the encoded frames that we keep in _recent */
+static uint64_t const recent_frames_size = 128 * 1024 * 1024;
+
 /** @param film Film that we are encoding.
  *  @param writer Writer that we are using.
  */
 J2KEncoder::J2KEncoder (shared_ptr<const Film> film, shared_ptr<Writer> writer)
 	: _film (film)
 	, _history (200)
+	, _recent (recent_frames_size)
 	, _writer (writer)
 {
+	int const cache_size = Config::instance()->j2k_cache_size ();
+	if (cache_size > 0) {
+		try {
+			_cache.reset (new J2KCache (Config::instance()->j2k_cache_directory(), uint64_t (cache_size) * 1000000000));
+		} catch (std::exception& e) {
+			LOG_ERROR (N_("Could not open J2K cache (%1)"), e.what ());
+		}
+	}
+
 	servers_list_changed ();
 }
 
@@ -97,24 +124,26 @@ J2KEncoder::call_servers_list_changed (weak_ptr<J2KEncoder> encoder)
 void
 J2KEncoder::end ()
 {
-	boost::mutex::scoped_lock lock (_queue_mutex);
-
-	LOG_GENERAL (N_("Clearing queue of %1"), _queue.size ());
+	LOG_GENERAL (N_("Clearing queue of %1"), _scheduler.size ());
 
-	/* Keep waking workers until the queue is empty */
-	while (!_queue.empty ()) {
+	/* Wait until the workers have taken everything */
+	while (_scheduler.size() > 0) {
 		rethrow ();
-		_empty_condition.notify_all ();
-		_full_condition.wait (lock);
+		_scheduler.wait_until_below (1);
 	}
 
-	lock.unlock ();
+	/* Wait for servers to finish what they have, while the local threads are still around
+	   to help with any frames that are late.
+	*/
+	wait_for_stragglers ();
 
 	LOG_GENERAL_NC (N_("Terminating encoder threads"));
 
 	terminate_threads ();
 
-	LOG_GENERAL (N_("Mopping up %1"), _queue.size());
+	list<shared_ptr<DCPVideo> > left = _scheduler.take_all ();
+
+	LOG_GENERAL (N_("Mopping up %1"), left.size());
 
 	/* The following sequence of events can occur in the above code:
 	     1. a remote worker takes the last image off the queue
@@ -125,15 +154,50 @@ J2KEncoder::end ()
 	     So just mop up anything left in the queue here.
 	*/
 
-	for (list<shared_ptr<DCPVideo> >::iterator i = _queue.begin(); i != _queue.end(); ++i) {
-		LOG_GENERAL (N_("Encode left-over frame %1"), (*i)->index ());
+	/* Use as many threads as we would for a normal local encode, since they are all stopped now */
+	int const threads = min (int (left.size()), max (1, Config::instance()->master_encoding_threads ()));
+	boost::mutex mutex;
+	boost::thread_group group;
+	for (int i = 0; i < threads; ++i) {
+		group.create_thread (boost::bind (&J2KEncoder::mop_up_thread, this, &left, &mutex));
+	}
+	group.join_all ();
+
+	/* Anything which is still waiting for an identical frame must have missed it somehow */
+	list<shared_ptr<DCPVideo> > waiting = _recent.take_waiting ();
+	if (!waiting.empty ()) {
+		LOG_GENERAL (N_("Mopping up %1 repeated frames"), waiting.size());
+		mop_up_thread (&waiting, &mutex);
+	}
+
+	LOG_GENERAL (N_("Scaler contexts: %1 reused, %2 made"), SwsContextCache::hits(), SwsContextCache::misses());
+	ImageBufferPool* pool = ImageBufferPool::instance ();
+	LOG_GENERAL (
+		N_("Image buffers: %1 reused, %2 allocated, %3MB kept for re-use"), pool->hits(), pool->misses(), pool->held() / 1000000
+		);
+}
+
+/** Thread to encode frames which were left over when the encoder threads were stopped.
+ *  @param left Frames to encode.
+ *  @param mutex Mutex for \p left.
+ */
+void
+J2KEncoder::mop_up_thread (list<shared_ptr<DCPVideo> >* left, boost::mutex* mutex)
+{
+	while (true) {
+		shared_ptr<DCPVideo> vf;
+		{
+			boost::mutex::scoped_lock lm (*mutex);
+			if (left->empty ()) {
+				return;
+			}
+			vf = left->front ();
+			left->pop_front ();
+		}
+
+		LOG_GENERAL (N_("Encode left-over frame %1"), vf->index ());
 		try {
-			_writer->write (
-				(*i)->encode_locally(),
-				(*i)->index(),
-				(*i)->eyes()
-				);
-			frame_done ();
+			write (vf, useful_digest(vf), vf->encode_locally());
 		} catch (std::exception& e) {
 			LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
 		}
@@ -149,6 +213,13 @@ J2KEncoder::current_encoding_rate () const
 	return _history.rate ();
 }
 
+/** @return Host names of servers that are taking much longer than the others to encode their frames */
+vector<string>
+J2KEncoder::slow_servers () const
+{
+	return _throughput.slow_servers ();
+}
+
 /** @return Number of video frames that have been queued for encoding */
 int
 J2KEncoder::video_frames_enqueued () const
@@ -183,18 +254,16 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 	size_t threads = 0;
 	{
 		boost::mutex::scoped_lock threads_lock (_threads_mutex);
-		threads = _threads.size ();
+		threads = frames_in_flight ();
 	}
 
-	boost::mutex::scoped_lock queue_lock (_queue_mutex);
-
 	/* Wait until the queue has gone down a bit.  Allow one thing in the queue even
 	   when there are no threads.
 	*/
-	while (_queue.size() >= (threads * 2) + 1) {
-		LOG_TIMING ("decoder-sleep queue=%1 threads=%2", _queue.size(), threads);
-		_full_condition.wait (queue_lock);
-		LOG_TIMING ("decoder-wake queue=%1 threads=%2", _queue.size(), threads);
+	while (_scheduler.size() >= (threads * 2) + 1) {
+		LOG_TIMING ("decoder-sleep queue=%1 threads=%2", _scheduler.size(), threads);
+		_scheduler.wait_until_below ((threads * 2) + 1);
+		LOG_TIMING ("decoder-wake queue=%1 threads=%2", _scheduler.size(), threads);
 	}
 
 	_writer->rethrow ();
@@ -221,21 +290,16 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 	} else {
 		LOG_DEBUG_ENCODE("Frame @ %1 ENCODE", to_string(time));
 		/* Queue this new frame for encoding */
-		LOG_TIMING ("add-frame-to-queue queue=%1", _queue.size ());
-		_queue.push_back (shared_ptr<DCPVideo> (
-					  new DCPVideo (
-						  pv,
-						  position,
-						  _film->video_frame_rate(),
-						  _film->j2k_bandwidth(),
-						  _film->resolution()
-						  )
-					  ));
-
-		/* The queue might not be empty any more, so notify anything which is
-		   waiting on that.
-		*/
-		_empty_condition.notify_all ();
+		LOG_TIMING ("add-frame-to-queue queue=%1", _scheduler.size ());
+		_scheduler.push (shared_ptr<DCPVideo> (
+					 new DCPVideo (
+						 pv,
+						 position,
+						 _film->video_frame_rate(),
+						 _film->j2k_bandwidth(),
+						 _film->resolution()
+						 )
+					 ));
 	}
 
 	_last_player_video[pv->eyes()] = pv;
@@ -245,28 +309,81 @@ J2KEncoder::encode (shared_ptr<PlayerVideo> pv, DCPTime time)
 void
 J2KEncoder::terminate_threads ()
 {
-	boost::mutex::scoped_lock threads_lock (_threads_mutex);
+	list<Thread> threads;
+
+	{
+		boost::mutex::scoped_lock threads_lock (_threads_mutex);
+		threads.swap (_threads);
+	}
+
+	terminate (threads);
+}
 
+/** @return Number of frames that our threads can be encoding at once; must be called with _threads_mutex held */
+int
+J2KEncoder::frames_in_flight () const
+{
 	int n = 0;
-	for (list<boost::thread *>::iterator i = _threads.begin(); i != _threads.end(); ++i) {
-		LOG_GENERAL ("Terminating thread %1 of %2", n + 1, _threads.size ());
-		(*i)->interrupt ();
-		DCPOMATIC_ASSERT ((*i)->joinable ());
+	BOOST_FOREACH (Thread const & i, _threads) {
+		n += i.frames;
+	}
+	return n;
+}
+
+/** Stop some threads which have already been removed from _threads */
+void
+J2KEncoder::terminate (list<Thread> threads)
+{
+	/* Interrupt everything first so that the threads can finish what they are doing in parallel */
+	for (list<Thread>::iterator i = threads.begin(); i != threads.end(); ++i) {
+		i->thread->interrupt ();
+	}
+
+	int n = 0;
+	for (list<Thread>::iterator i = threads.begin(); i != threads.end(); ++i) {
+		LOG_GENERAL ("Terminating thread %1 of %2", n + 1, threads.size ());
+		DCPOMATIC_ASSERT (i->thread->joinable ());
 		try {
-			(*i)->join ();
+			i->thread->join ();
 		} catch (boost::thread_interrupted& e) {
 			/* This is to be expected */
 		}
-		delete *i;
+		delete i->thread;
+		/* Anything still in this worker's queue will be given to someone else */
+		_scheduler.remove_worker (i->worker);
 		LOG_GENERAL_NC ("Thread terminated");
 		++n;
 	}
+}
 
-	_threads.clear ();
+/** Take some frames from _scheduler, waiting until the server is allowed to have them.
+ *  @param worker ID of the worker that is asking.
+ *  @param server Host name of the server, or empty for local encoding.
+ *  @param max_frames Maximum number of frames to take.
+ *  @return Frames, which have been reserved in _throughput.
+ */
+list<shared_ptr<DCPVideo> >
+J2KEncoder::pop (int worker, string server, int max_frames)
+{
+	int const reserved = _throughput.reserve (server, max_frames);
+
+	list<shared_ptr<DCPVideo> > frames;
+	try {
+		frames = _scheduler.pop (worker, reserved);
+	} catch (...) {
+		_throughput.release (server, reserved);
+		throw;
+	}
+
+	_throughput.release (server, reserved - frames.size());
+	return frames;
 }
 
+/** @param server Server to send frames to, or empty to encode locally.
+ *  @param worker Our ID in _scheduler.
+ */
 void
-J2KEncoder::encoder_thread (optional<EncodeServerDescription> server)
+J2KEncoder::encoder_thread (optional<EncodeServerDescription> server, int worker)
 try
 {
 	if (server) {
@@ -281,141 +398,526 @@ try
 	*/
 	int remote_backoff = 0;
 
+	string const name = server ? server->host_name() : "";
+	/* A remote server can encode as many frames at once as it has threads, so take that many
+	   at a time; we will send them one after another.
+	*/
+	int const batch = server ? max (1, server->threads ()) : 1;
+
 	while (true) {
 
 		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
-		boost::mutex::scoped_lock lock (_queue_mutex);
-		while (_queue.empty ()) {
-			_empty_condition.wait (lock);
-		}
+		/* pop() is an interruption point until it claims a frame, but not after */
+		list<shared_ptr<DCPVideo> > frames = pop (worker, name, batch);
+		DCPOMATIC_ASSERT (!frames.empty ());
 
-		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _queue.size());
-		shared_ptr<DCPVideo> vf = _queue.front ();
+		LOG_TIMING ("encoder-wake thread=%1 queue=%2", thread_id(), _scheduler.size());
 
-		/* We're about to commit to either encoding this frame or putting it back onto the queue,
+		/* We're about to commit to either encoding these frames or putting them back onto the queue,
 		   so we must not be interrupted until one or other of these things have happened.  This
 		   block has thread interruption disabled.
 		*/
 		{
 			boost::this_thread::disable_interruption dis;
 
-			LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
-			_queue.pop_front ();
+			/* true if the server failed on a frame in this batch */
+			bool failed = false;
+			/* Frames to put back onto the queue, in order */
+			list<shared_ptr<DCPVideo> > give_back;
 
-			lock.unlock ();
+			BOOST_FOREACH (shared_ptr<DCPVideo> vf, frames) {
 
-			optional<Data> encoded;
+				if (failed) {
+					/* The server failed on an earlier frame in this batch, so don't try it with this one */
+					_throughput.release (name, 1);
+					give_back.push_back (vf);
+					continue;
+				}
 
-			/* We need to encode this input */
-			if (server) {
-				try {
-					encoded = vf->encode_remotely (server.get ());
+				LOG_TIMING ("encoder-pop thread=%1 frame=%2 eyes=%3", thread_id(), vf->index(), (int) vf->eyes ());
 
-					if (remote_backoff > 0) {
-						LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server->host_name ());
+				/* If this is a copy of a frame that is late from a server, see if it is still needed */
+				bool const duplicate = !server && _in_flight.take_duplicate (vf);
+				if (duplicate && !_in_flight.contains (vf)) {
+					_throughput.release (name, 1);
+					continue;
+				}
+
+				/* See if this frame has been encoded before, either earlier in this encode or in _cache */
+				optional<string> const digest = useful_digest (vf);
+				if (!duplicate && digest) {
+					Data data;
+					RecentFrames::Result const r = _recent.get (*digest, vf, data);
+					if (r == RecentFrames::FOUND) {
+						LOG_DEBUG_ENCODE (N_("Frame %1 is the same as an earlier one"), vf->index ());
+						write (vf, digest, data);
+					}
+					if (r != RecentFrames::ENCODE || (_cache && write_from_cache (vf, *digest))) {
+						_throughput.release (name, 1);
+						continue;
 					}
+				}
 
-					/* This job succeeded, so remove any backoff */
-					remote_backoff = 0;
+				optional<Data> encoded;
+
+				/* We need to encode this input */
+				if (server) {
+					start_in_flight (vf, name);
+					try {
+						encoded = vf->encode_remotely (server.get ());
+
+						if (remote_backoff > 0) {
+							LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server->host_name ());
+						}
+
+						/* This job succeeded, so remove any backoff */
+						remote_backoff = 0;
+
+					} catch (std::exception& e) {
+						if (remote_backoff < 60) {
+							/* back off more */
+							remote_backoff += 10;
+						}
+						LOG_ERROR (
+							N_("Remote encode of %1 on %2 failed (%3); thread sleeping for %4s"),
+							vf->index(), server->host_name(), e.what(), remote_backoff
+							);
+					}
 
-				} catch (std::exception& e) {
-					if (remote_backoff < 60) {
-						/* back off more */
-						remote_backoff += 10;
+				} else {
+					try {
+						LOG_TIMING ("start-local-encode thread=%1 frame=%2", thread_id(), vf->index());
+						encoded = vf->encode_locally ();
+						LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf->index());
+					} catch (std::exception& e) {
+						/* This is very bad, so don't cope with it, just pass it on */
+						LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
+						throw;
 					}
-					LOG_ERROR (
-						N_("Remote encode of %1 on %2 failed (%3); thread sleeping for %4s"),
-						vf->index(), server->host_name(), e.what(), remote_backoff
-						);
 				}
 
-			} else {
-				try {
-					LOG_TIMING ("start-local-encode thread=%1 frame=%2", thread_id(), vf->index());
-					encoded = vf->encode_locally ();
-					LOG_TIMING ("finish-local-encode thread=%1 frame=%2", thread_id(), vf->index());
-				} catch (std::exception& e) {
-					/* This is very bad, so don't cope with it, just pass it on */
-					LOG_ERROR (N_("Local encode failed (%1)"), e.what ());
-					throw;
+				if (encoded) {
+					/* Frames from servers may also have been encoded locally, in which case the first one wins */
+					if ((!server && !duplicate) || _in_flight.finish (vf)) {
+						write (vf, digest, encoded.get());
+						if (_cache && digest) {
+							_cache->put (*digest, encoded.get());
+						}
+					}
+					_throughput.frame_done (name);
+				} else {
+					failed = true;
+					_throughput.release (name, 1);
+					if (_in_flight.fail (vf)) {
+						LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf->index());
+						give_back.push_back (vf);
+					}
 				}
 			}
 
-			if (encoded) {
-				_writer->write (encoded.get(), vf->index (), vf->eyes ());
-				frame_done ();
-			} else {
-				lock.lock ();
-				LOG_GENERAL (N_("[%1] J2KEncoder thread pushes frame %2 back onto queue after failure"), thread_id(), vf->index());
-				_queue.push_front (vf);
-				lock.unlock ();
+			/* Put the frames back in reverse so that they end up in their original order at the front of the queue */
+			BOOST_REVERSE_FOREACH (shared_ptr<DCPVideo> vf, give_back) {
+				_scheduler.push_front (vf);
 			}
 		}
 
 		if (remote_backoff > 0) {
 			boost::this_thread::sleep (boost::posix_time::seconds (remote_backoff));
 		}
+	}
+}
+catch (boost::thread_interrupted& e) {
+	/* Ignore these and just stop the thread */
+}
+catch (...)
+{
+	store_current ();
+	/* Wake anything waiting for the queue to go down so it can see the exception */
+	_scheduler.wake ();
+}
+
+/** Thread to send batches of frames down a persistent connection to a server.
+ *  @param server Server to send frames to.
+ *  @param worker Our ID in _scheduler.
+ */
+void
+J2KEncoder::pipelined_encoder_thread (EncodeServerDescription server, int worker)
+try
+{
+	LOG_TIMING ("start-encoder-thread thread=%1 server=%2 pipelined", thread_id (), server.host_name ());
+
+	EncodeServerConnection connection (server);
+
+	/* Number of seconds that we currently wait between attempts to connect to the server */
+	int remote_backoff = 0;
+
+	while (true) {
+
+		LOG_TIMING ("encoder-sleep thread=%1", thread_id ());
+		/* Take up to one frame for each of the server's threads, if it is allowed that many */
+		list<shared_ptr<DCPVideo> > frames = pop (worker, server.host_name(), server.threads ());
+		LOG_TIMING ("encoder-wake thread=%1 queue=%2 frames=%3", thread_id(), _scheduler.size(), frames.size());
+
+		/* As in encoder_thread() we must not be interrupted until the frames have been
+		   either encoded or put back.
+		*/
+		{
+			boost::this_thread::disable_interruption dis;
+
+			/* Anything that has been encoded before need not be sent.  We only look for frames
+			   whose digests are quick to make, so that the server is not kept waiting; others
+			   have their digests made by pipelined_frame_done() if they are needed.
+			*/
+			map<shared_ptr<DCPVideo>, string> digests;
+			list<shared_ptr<DCPVideo> >::iterator i = frames.begin ();
+			while (i != frames.end()) {
+				list<shared_ptr<DCPVideo> >::iterator j = i;
+				++i;
+				if (!(*j)->digest_is_cheap ()) {
+					continue;
+				}
+				string const digest = (*j)->digest ();
+				Data data;
+				RecentFrames::Result const r = _recent.get (digest, *j, data);
+				if (r == RecentFrames::FOUND) {
+					LOG_DEBUG_ENCODE (N_("Frame %1 is the same as an earlier one"), (*j)->index ());
+					write (*j, digest, data);
+				}
+				if (r != RecentFrames::ENCODE || (_cache && write_from_cache (*j, digest))) {
+					_throughput.release (server.host_name(), 1);
+					frames.erase (j);
+				} else {
+					digests[*j] = digest;
+				}
+			}
+
+			if (frames.empty ()) {
+				continue;
+			}
+
+			BOOST_FOREACH (shared_ptr<DCPVideo> i, frames) {
+				start_in_flight (i, server.host_name ());
+			}
+
+			try {
+				vector<shared_ptr<DCPVideo> > batch (frames.begin(), frames.end());
+				connection.encode (batch, boost::bind (&J2KEncoder::pipelined_frame_done, this, server.host_name(), _1, _2, &frames, &digests));
+
+				if (remote_backoff > 0) {
+					LOG_GENERAL ("%1 was lost, but now she is found; removing backoff", server.host_name ());
+				}
+
+				remote_backoff = 0;
+
+			} catch (std::exception& e) {
+				if (remote_backoff < 60) {
+					remote_backoff += 10;
+				}
+				LOG_ERROR (
+					N_("Remote encode of %1 frames on %2 failed (%3); thread sleeping for %4s"),
+					frames.size(), server.host_name(), e.what(), remote_backoff
+					);
+
+				_throughput.release (server.host_name(), frames.size());
 
-		/* The queue might not be full any more, so notify anything that is waiting on that */
-		lock.lock ();
-		_full_condition.notify_all ();
+				/* Put back whatever did not come back, keeping the order */
+				for (list<shared_ptr<DCPVideo> >::reverse_iterator i = frames.rbegin(); i != frames.rend(); ++i) {
+					if (_in_flight.fail (*i)) {
+						_scheduler.push_front (*i);
+					}
+				}
+			}
+		}
+
+		if (remote_backoff > 0) {
+			boost::this_thread::sleep (boost::posix_time::seconds (remote_backoff));
+		}
 	}
 }
 catch (boost::thread_interrupted& e) {
 	/* Ignore these and just stop the thread */
-	_full_condition.notify_all ();
 }
 catch (...)
 {
 	store_current ();
-	/* Wake anything waiting on _full_condition so it can see the exception */
-	_full_condition.notify_all ();
+	_scheduler.wake ();
 }
 
+/** Called when a frame has come back from a pipelined connection.
+ *  @param server Host name of the server.
+ *  @param waiting Frames that we are still waiting for; \p frame will be removed.
+ *  @param digests Digests of the frames that were sent, where they were made before sending.
+ */
 void
-J2KEncoder::servers_list_changed ()
+J2KEncoder::pipelined_frame_done (
+	string server, shared_ptr<DCPVideo> frame, Data encoded, list<shared_ptr<DCPVideo> >* waiting, map<shared_ptr<DCPVideo>, string> const * digests
+	)
 {
-	terminate_threads ();
+	if (_in_flight.finish (frame)) {
+		optional<string> digest;
+		map<shared_ptr<DCPVideo>, string>::const_iterator i = digests->find (frame);
+		if (i != digests->end()) {
+			digest = i->second;
+		} else {
+			digest = useful_digest (frame);
+		}
+		write (frame, digest, encoded);
+		if (_cache && digest) {
+			_cache->put (*digest, encoded);
+		}
+	}
+	_throughput.frame_done (server);
+	waiting->remove (frame);
+}
+
+/** @return DCPVideo::digest() of a frame if it is worth making: that is if it is quick to make,
+ *  so that _recent can look for the frame, or if we have a _cache which can use it.  Otherwise
+ *  we would spend a long time hashing a whole image which is very likely to be new.
+ */
+optional<string>
+J2KEncoder::useful_digest (shared_ptr<DCPVideo> frame) const
+{
+	if (frame->digest_is_cheap() || _cache) {
+		return frame->digest ();
+	}
+
+	return optional<string> ();
+}
+
+/** Write a frame from _cache, if it is there.
+ *  @param digest DCPVideo::digest() of the frame.
+ *  @return true if the frame was written.
+ */
+bool
+J2KEncoder::write_from_cache (shared_ptr<DCPVideo> frame, string digest)
+{
+	optional<Data> data = _cache->get (digest);
+	if (!data) {
+		return false;
+	}
+
+	LOG_DEBUG_ENCODE (N_("Frame %1 found in J2K cache"), frame->index ());
+	write (frame, digest, data.get());
+	return true;
+}
 
-	/* XXX: could re-use threads */
+/** Write an encoded frame, along with any identical frames which were waiting for it.
+ *  @param digest DCPVideo::digest() of the frame, if it was made.
+ */
+void
+J2KEncoder::write (shared_ptr<DCPVideo> frame, optional<string> digest, Data encoded)
+{
+	_writer->write (encoded, frame->index(), frame->eyes());
+	frame_done ();
+
+	if (!digest) {
+		return;
+	}
+
+	BOOST_FOREACH (shared_ptr<DCPVideo> i, _recent.put (*digest, encoded)) {
+		LOG_DEBUG_ENCODE (N_("Frame %1 is the same as frame %2"), i->index(), frame->index());
+		_writer->write (encoded, i->index(), i->eyes());
+		frame_done ();
+	}
+}
 
-	boost::mutex::scoped_lock lm (_threads_mutex);
+/** Note that a frame has been sent to a server */
+void
+J2KEncoder::start_in_flight (shared_ptr<DCPVideo> frame, string server)
+{
+	optional<float> const latency = _throughput.latency (server);
+
+	struct timeval now;
+	gettimeofday (&now, 0);
+	double const deadline = seconds (now) + max (minimum_straggler_time, latency.get_value_or(0) * straggler_factor);
+
+	_in_flight.start (frame, server, deadline);
+}
+
+/** Wait until all frames that are with servers have come back.  Any that are late
+ *  are given to local threads as well, and the first copy to be finished is used.
+ */
+void
+J2KEncoder::wait_for_stragglers ()
+{
+	while (true) {
+		rethrow ();
+
+		bool local = false;
+		{
+			boost::mutex::scoped_lock lm (_threads_mutex);
+			BOOST_FOREACH (Thread const & i, _threads) {
+				if (!i.server) {
+					local = true;
+				}
+			}
+		}
+
+		if (_in_flight.empty() || !local) {
+			/* Either there's nothing to wait for, or nobody who can help */
+			return;
+		}
+
+		struct timeval now;
+		gettimeofday (&now, 0);
+
+		typedef pair<shared_ptr<DCPVideo>, string> Late;
+		BOOST_FOREACH (Late i, _in_flight.duplicate_late (seconds (now))) {
+			LOG_GENERAL (N_("Frame %1 is late from %2; encoding it locally as well"), i.first->index(), i.second);
+			_scheduler.push_speculative (i.first);
+		}
+
+		_in_flight.wait (1);
+	}
+}
 
 #ifdef BOOST_THREAD_PLATFORM_WIN32
+static bool
+windows_xp ()
+{
 	OSVERSIONINFO info;
 	info.dwOSVersionInfoSize = sizeof (OSVERSIONINFO);
 	GetVersionEx (&info);
-	bool const windows_xp = (info.dwMajorVersion == 5 && info.dwMinorVersion == 1);
-	if (windows_xp) {
-		LOG_GENERAL_NC (N_("Setting thread affinity for Windows XP"));
-	}
+	return info.dwMajorVersion == 5 && info.dwMinorVersion == 1;
+}
 #endif
 
-	if (!Config::instance()->only_servers_encode ()) {
-		for (int i = 0; i < Config::instance()->master_encoding_threads (); ++i) {
-			boost::thread* t = new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, optional<EncodeServerDescription> ()));
+/** Start a thread to encode locally; must be called with _threads_mutex held.
+ *  @param n Index of this thread among the local ones.
+ */
+void
+J2KEncoder::add_local_thread (int n)
+{
+	int const worker = _scheduler.add_worker (true);
+	boost::thread* t = new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, optional<EncodeServerDescription> (), worker));
 #ifdef DCPOMATIC_LINUX
-			pthread_setname_np (t->native_handle(), "encode-worker");
+	pthread_setname_np (t->native_handle(), "encode-worker");
 #endif
-			_threads.push_back (t);
+	_threads.push_back (Thread (t, worker, optional<EncodeServerDescription> (), 1));
 #ifdef BOOST_THREAD_PLATFORM_WIN32
-			if (windows_xp) {
-				SetThreadAffinityMask (t->native_handle(), 1 << i);
+	if (windows_xp ()) {
+		SetThreadAffinityMask (t->native_handle(), 1 << n);
+	}
+#else
+	(void) n;
+#endif
+}
+
+/** Start a thread to send frames to a server; must be called with _threads_mutex held */
+void
+J2KEncoder::add_remote_thread (EncodeServerDescription server)
+{
+	int const worker = _scheduler.add_worker (false);
+	if (server.pipelined ()) {
+		boost::thread* t = new boost::thread (boost::bind (&J2KEncoder::pipelined_encoder_thread, this, server, worker));
+		_threads.push_back (Thread (t, worker, server, server.threads ()));
+	} else {
+		boost::thread* t = new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, optional<EncodeServerDescription> (server), worker));
+		_threads.push_back (Thread (t, worker, server, 1));
+	}
+}
+
+/** @return Number of threads that we should use to send frames to a server */
+static int
+threads_for_server (EncodeServerDescription const & server)
+{
+	/* With pipelined connections two are enough to keep the server busy; one can be
+	   sending or receiving while the server works on the other's frames.
+	*/
+	return server.pipelined() ? 2 : server.threads();
+}
+
+/** Bring our threads into line with the configuration and the servers that
+ *  EncodeServerFinder knows about.  Threads for servers which are still there
+ *  with the same description, and local threads, are left alone.
+ */
+void
+J2KEncoder::servers_list_changed ()
+{
+	list<Thread> finished;
+
+	{
+		boost::mutex::scoped_lock lm (_threads_mutex);
+
+		/* Work out how many threads we want for each server */
+		map<string, EncodeServerDescription> servers;
+		BOOST_FOREACH (EncodeServerDescription i, EncodeServerFinder::instance()->servers()) {
+			if (i.current_link_version()) {
+				servers[i.host_name()] = i;
+			}
+		}
+
+		int const local_wanted = Config::instance()->only_servers_encode() ? 0 : Config::instance()->master_encoding_threads();
+
+		/* Take out any threads that we no longer need */
+		int local = 0;
+		map<string, int> remote;
+		list<Thread>::iterator i = _threads.begin ();
+		while (i != _threads.end()) {
+			list<Thread>::iterator j = i;
+			++i;
+
+			bool keep = false;
+			if (!j->server) {
+				keep = local < local_wanted;
+				if (keep) {
+					++local;
+				}
+			} else {
+				/* If the server's description has changed (e.g. it has been upgraded and is now
+				   pipelined, or has a different number of threads) this thread is using the old
+				   one, so it must be replaced.
+				*/
+				string const host = j->server->host_name ();
+				map<string, EncodeServerDescription>::const_iterator s = servers.find (host);
+				keep = s != servers.end() && s->second == *j->server && remote[host] < threads_for_server (s->second);
+				if (keep) {
+					++remote[host];
+				}
+			}
+
+			if (!keep) {
+				finished.splice (finished.end(), _threads, j);
+			}
+		}
+
+		if (local < local_wanted) {
+			LOG_GENERAL (N_("Adding %1 local worker threads"), local_wanted - local);
+#ifdef BOOST_THREAD_PLATFORM_WIN32
+			if (windows_xp ()) {
+				LOG_GENERAL_NC (N_("Setting thread affinity for Windows XP"));
 			}
 #endif
 		}
-	}
 
-	BOOST_FOREACH (EncodeServerDescription i, EncodeServerFinder::instance()->servers()) {
-		if (!i.current_link_version()) {
-			continue;
+		for (int i = local; i < local_wanted; ++i) {
+			add_local_thread (i);
 		}
 
-		LOG_GENERAL (N_("Adding %1 worker threads for remote %2"), i.threads(), i.host_name ());
-		for (int j = 0; j < i.threads(); ++j) {
-			_threads.push_back (new boost::thread (boost::bind (&J2KEncoder::encoder_thread, this, i)));
+		for (map<string, EncodeServerDescription>::const_iterator i = servers.begin(); i != servers.end(); ++i) {
+			int const running = remote[i->first];
+			int const wanted = threads_for_server (i->second);
+			if (running < wanted) {
+				LOG_GENERAL (N_("Adding %1 worker threads for remote %2"), wanted - running, i->first);
+			}
+			for (int j = running; j < wanted; ++j) {
+				add_remote_thread (i->second);
+			}
+		}
+
+		_writer->set_encoder_threads (frames_in_flight ());
+
+		map<string, int> frames;
+		BOOST_FOREACH (Thread const & i, _threads) {
+			frames[i.server ? i.server->host_name() : ""] += i.frames;
 		}
+		_throughput.set_servers (frames);
+	}
+
+	if (!finished.empty ()) {
+		LOG_GENERAL (N_("Removing %1 worker threads"), finished.size ());
 	}
 
-	_writer->set_encoder_threads (_threads.size ());
+	/* Do this without the lock held as it may have to wait for some encodes to finish */
+	terminate (finished);
 }
@@ -29,6 +29,11 @@
 #include "cross.h"
 #include "event_history.h"
 #include "exception_store.h"
+#include "encode_scheduler.h"
+#include "encode_server_throughput.h"
+#include "recent_frames.h"
+#include "in_flight_frames.h"
+#include "encode_server_description.h"
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
@@ -37,14 +42,17 @@
 #include <boost/signals2.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
 #include <stdint.h>
 
 class Film;
-class EncodeServerDescription;
 class DCPVideo;
 class Writer;
 class Job;
 class PlayerVideo;
+class J2KCache;
 
 /** @class J2KEncoder
  *  @brief Class to manage encoding to J2K.
@@ -69,18 +77,56 @@ public:
 	void end ();
 
 	float current_encoding_rate () const;
+	std::vector<std::string> slow_servers () const;
 	int video_frames_enqueued () const;
 
 	void servers_list_changed ();
 
 private:
 
+	struct Thread
+	{
+		Thread (boost::thread* t, int w, boost::optional<EncodeServerDescription> s, int f)
+			: thread (t)
+			, worker (w)
+			, server (s)
+			, frames (f)
+		{}
+
+		boost::thread* thread;
+		/** ID of this thread's worker in _scheduler */
+		int worker;
+		/** the server that this thread sends to, as it was when the thread was started, or empty if it encodes locally */
+		boost::optional<EncodeServerDescription> server;
+		/** maximum number of frames that this thread will have in flight at once */
+		int frames;
+	};
+
 	static void call_servers_list_changed (boost::weak_ptr<J2KEncoder> encoder);
 
 	void frame_done ();
 
-	void encoder_thread (boost::optional<EncodeServerDescription>);
+	void encoder_thread (boost::optional<EncodeServerDescription>, int worker);
+	void pipelined_encoder_thread (EncodeServerDescription server, int worker);
+	void pipelined_frame_done (
+		std::string server,
+		boost::shared_ptr<DCPVideo> frame,
+		dcp::Data encoded,
+		std::list<boost::shared_ptr<DCPVideo> >* waiting,
+		std::map<boost::shared_ptr<DCPVideo>, std::string> const * digests
+		);
+	boost::optional<std::string> useful_digest (boost::shared_ptr<DCPVideo> frame) const;
+	bool write_from_cache (boost::shared_ptr<DCPVideo> frame, std::string digest);
+	void write (boost::shared_ptr<DCPVideo> frame, boost::optional<std::string> digest, dcp::Data encoded);
+	std::list<boost::shared_ptr<DCPVideo> > pop (int worker, std::string server, int max_frames);
 	void terminate_threads ();
+	void mop_up_thread (std::list<boost::shared_ptr<DCPVideo> >* left, boost::mutex* mutex);
+	void terminate (std::list<Thread> threads);
+	int frames_in_flight () const;
+	void add_local_thread (int n);
+	void add_remote_thread (EncodeServerDescription server);
+	void start_in_flight (boost::shared_ptr<DCPVideo> frame, std::string server);
+	void wait_for_stragglers ();
 
 	/** Film that we are encoding */
 	boost::shared_ptr<const Film> _film;
@@ -89,13 +135,19 @@ private:
 
 	/** Mutex for _threads */
 	mutable boost::mutex _threads_mutex;
-	std::list<boost::thread *> _threads;
-	mutable boost::mutex _queue_mutex;
-	std::list<boost::shared_ptr<DCPVideo> > _queue;
-	/** condition to manage thread wakeups when we have nothing to do */
-	boost::condition _empty_condition;
-	/** condition to manage thread wakeups when we have too much to do */
-	boost::condition _full_condition;
+	std::list<Thread> _threads;
+	/** frames waiting to be encoded */
+	EncodeScheduler _scheduler;
+	/** measurements of each server's speed, keyed by host name (or empty for local encoding) */
+	EncodeServerThroughput _throughput;
+
+	/** frames which have been encoded recently */
+	RecentFrames _recent;
+	/** cache of encoded frames, or 0 */
+	boost::shared_ptr<J2KCache> _cache;
+
+	/** frames which are being encoded by servers */
+	InFlightFrames _in_flight;
 
 	boost::shared_ptr<Writer> _writer;
 	Waker _waker;
@@ -22,6 +22,7 @@
 #include "dcpomatic_socket.h"
 #include "image.h"
 #include "dcpomatic_assert.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 #include <dcp/openjpeg_image.h>
 #include <dcp/mono_picture_frame.h>
@@ -220,6 +221,16 @@ J2KImageProxy::J2KImageProxy (Data data, dcp::Size size, AVPixelFormat pixel_for
 	DCPOMATIC_ASSERT (_pixel_format == AV_PIX_FMT_RGB48 || _pixel_format == AV_PIX_FMT_XYZ12LE);
 }
 
+void
+J2KImageProxy::add_digest (Digester& digester) const
+{
+	digester.add (_data.data().get(), _data.size());
+	digester.add (_size.width);
+	digester.add (_size.height);
+	digester.add (static_cast<int> (_pixel_format));
+	digester.add (_forced_reduction.get_value_or (-1));
+}
+
 size_t
 J2KImageProxy::memory_used () const
 {
@@ -69,6 +69,7 @@ public:
 	}
 
 	size_t memory_used () const;
+	void add_digest (Digester& digester) const;
 
 private:
 	friend struct client_server_test_j2k;
@@ -48,6 +48,7 @@
 #include "image_decoder.h"
 #include "compose.hpp"
 #include "shuffler.h"
+#include "rendered_text_cache.h"
 #include <dcp/reel.h>
 #include <dcp/reel_sound_asset.h>
 #include <dcp/reel_subtitle_asset.h>
@@ -247,6 +248,19 @@ Player::playlist_content_change (ChangeType type, int property, bool frequent)
 		/* A change in our content has gone through.  Re-build our pieces. */
 		setup_pieces ();
 		_suspended = false;
+
+		if (
+			property == TextContentProperty::FONTS ||
+			property == TextContentProperty::COLOUR ||
+			property == TextContentProperty::EFFECT ||
+			property == TextContentProperty::EFFECT_COLOUR ||
+			property == TextContentProperty::OUTLINE_WIDTH
+			) {
+			/* Any text images that we have rendered with the old appearance will not be used again,
+			   and a font file may have changed without its name changing.
+			*/
+			RenderedTextCache::instance()->clear ();
+		}
 	} else if (type == CHANGE_TYPE_CANCELLED) {
 		boost::mutex::scoped_lock lm (_mutex);
 		_suspended = false;
@@ -24,7 +24,11 @@
 #include "image.h"
 #include "image_proxy.h"
 #include "j2k_image_proxy.h"
+#include "raw_image_proxy.h"
 #include "film.h"
+#include "binary_encoding_request.h"
+#include "dcpomatic_assert.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 extern "C" {
 #include <libavutil/pixfmt.h>
@@ -96,6 +100,33 @@ PlayerVideo::PlayerVideo (shared_ptr<cxml::Node> node, shared_ptr<Socket> socket
 	}
 }
 
+PlayerVideo::PlayerVideo (BinaryEncodingRequest const & request, shared_ptr<Socket> socket)
+{
+	_crop = Crop (request.crop_left, request.crop_right, request.crop_top, request.crop_bottom);
+	if (request.has_fade) {
+		_fade = request.fade;
+	}
+
+	_inter_size = dcp::Size (request.inter_width, request.inter_height);
+	_out_size = dcp::Size (request.out_width, request.out_height);
+	_eyes = (Eyes) request.eyes;
+	_part = (Part) request.part;
+
+	_colour_conversion = ColourConversion::from_binary (request);
+
+	_in = image_proxy_factory (request, socket);
+
+	if (request.has_text) {
+		shared_ptr<Image> image (new Image (AV_PIX_FMT_BGRA, dcp::Size (request.text_width, request.text_height), true));
+		if (request.compressed) {
+			image->read_compressed_from_socket (socket);
+		} else {
+			image->read_from_socket (socket);
+		}
+		_text = PositionImage (image, Position<int> (request.text_x, request.text_y));
+	}
+}
+
 void
 PlayerVideo::set_text (PositionImage image)
 {
@@ -109,7 +140,10 @@ PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool a
 
 	boost::mutex::scoped_lock lm (_mutex);
 	if (!_image || _crop != _image_crop || _inter_size != _image_inter_size || _out_size != _image_out_size) {
-		make_image (pixel_format, aligned, fast);
+		/* If we are being asked to be fast (i.e. for the viewer) and the image was not prepared in advance
+		   someone is probably waiting for it, so use all our threads on this one frame.
+		*/
+		make_image (pixel_format, aligned, fast, fast);
 	}
 	return _image;
 }
@@ -120,9 +154,10 @@ PlayerVideo::image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool a
  *  output pixel format.  Two functions force and keep_xyz_or_rgb are provided for use here.
  *  @param aligned true if the output image should be aligned to 32-byte boundaries.
  *  @param fast true to be fast at the expense of quality.
+ *  @param parallel true to split up the scaling of the image between threads.
  */
 void
-PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const
+PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast, bool parallel) const
 {
 	_image_crop = _crop;
 	_image_inter_size = _inter_size;
@@ -165,7 +200,7 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, b
 	}
 
 	_image = im->crop_scale_window (
-		total_crop, _inter_size, _out_size, yuv_to_rgb, pixel_format (im->pixel_format()), aligned, fast
+		total_crop, _inter_size, _out_size, yuv_to_rgb, pixel_format (im->pixel_format()), aligned, fast, parallel
 		);
 
 	if (_text) {
@@ -173,7 +208,14 @@ PlayerVideo::make_image (function<AVPixelFormat (AVPixelFormat)> pixel_format, b
 	}
 
 	if (_fade) {
-		_image->fade (_fade.get ());
+		/* Only the part that crop_scale_window wrote, and any text, can be anything other than black */
+		dcpomatic::Rect<int> area (
+			(_out_size.width - _inter_size.width) / 2, (_out_size.height - _inter_size.height) / 2, _inter_size.width, _inter_size.height
+			);
+		if (_text) {
+			area.extend (dcpomatic::Rect<int> (_text->position, _text->image->size().width, _text->image->size().height));
+		}
+		_image->fade (_fade.get (), area);
 	}
 }
 
@@ -202,6 +244,59 @@ PlayerVideo::add_metadata (xmlpp::Node* node) const
 	}
 }
 
+/** Describe this frame in a BinaryEncodingRequest.
+ *  @return false if it cannot be described that way, in which case add_metadata() must be used instead.
+ */
+bool
+PlayerVideo::add_binary_metadata (BinaryEncodingRequest& request) const
+{
+	if (!_in->add_binary_metadata (request)) {
+		return false;
+	}
+
+	request.crop_left = _crop.left;
+	request.crop_right = _crop.right;
+	request.crop_top = _crop.top;
+	request.crop_bottom = _crop.bottom;
+	request.has_fade = static_cast<bool> (_fade);
+	if (_fade) {
+		request.fade = _fade.get ();
+	}
+	request.inter_width = _inter_size.width;
+	request.inter_height = _inter_size.height;
+	request.out_width = _out_size.width;
+	request.out_height = _out_size.height;
+	request.eyes = static_cast<int> (_eyes);
+	request.part = static_cast<int> (_part);
+	if (_colour_conversion) {
+		_colour_conversion.get().as_binary (request);
+	}
+	request.has_text = static_cast<bool> (_text);
+	if (_text) {
+		request.text_width = _text->image->size().width;
+		request.text_height = _text->image->size().height;
+		request.text_x = _text->position.x;
+		request.text_y = _text->position.y;
+	}
+
+	return true;
+}
+
+/** As send_binary(), but sending the images with Image::write_compressed_to_socket().
+ *  This may only be used if add_binary_metadata() succeeded.
+ */
+void
+PlayerVideo::send_compressed (shared_ptr<Socket> socket) const
+{
+	/* Only a RawImageProxy can be described by a BinaryEncodingRequest */
+	shared_ptr<const RawImageProxy> raw = dynamic_pointer_cast<const RawImageProxy> (_in);
+	DCPOMATIC_ASSERT (raw);
+	raw->send_compressed (socket);
+	if (_text) {
+		_text->image->write_compressed_to_socket (socket);
+	}
+}
+
 void
 PlayerVideo::send_binary (shared_ptr<Socket> socket) const
 {
@@ -285,8 +380,60 @@ PlayerVideo::prepare (function<AVPixelFormat (AVPixelFormat)> pixel_format, bool
 	_in->prepare (_inter_size);
 	boost::mutex::scoped_lock lm (_mutex);
 	if (!_image) {
-		make_image (pixel_format, aligned, fast);
+		make_image (pixel_format, aligned, fast, false);
+	}
+}
+
+/** Add everything that affects the image that we will make to a Digester.
+ *  If our input's digest would be slow to make we describe where the image came
+ *  from instead, when we know that.  That description leaves out the content's
+ *  position and trims, so that the digest of a frame does not change when the
+ *  content is moved or trimmed; the things that we do to the image (crop, fade
+ *  and so on) are added below in either case.
+ */
+void
+PlayerVideo::add_digest (Digester& digester) const
+{
+	shared_ptr<Content> content = _content.lock ();
+	if (!_in->digest_is_cheap() && content && _video_frame) {
+		digester.add (content->digest ());
+		digester.add (content->image_identifier ());
+		/* Frame index within the content's files */
+		digester.add (_video_frame.get ());
+		/* Both eyes of some 3D content come from the same frame */
+		digester.add (static_cast<int> (_eyes));
+	} else {
+		/* Our eyes are not included, as they do not change the image */
+		_in->add_digest (digester);
+	}
+
+	digester.add (_crop.left);
+	digester.add (_crop.right);
+	digester.add (_crop.top);
+	digester.add (_crop.bottom);
+	digester.add (_fade.get_value_or (-1));
+	digester.add (_inter_size.width);
+	digester.add (_inter_size.height);
+	digester.add (_out_size.width);
+	digester.add (_out_size.height);
+	digester.add (static_cast<int> (_part));
+	if (_colour_conversion) {
+		digester.add (_colour_conversion->identifier ());
+	} else {
+		digester.add (string ("none"));
 	}
+	if (_text) {
+		_text->image->add_digest (digester);
+		digester.add (_text->position.x);
+		digester.add (_text->position.y);
+	}
+}
+
+/** @return true if add_digest() is quick */
+bool
+PlayerVideo::digest_is_cheap () const
+{
+	return _in->digest_is_cheap() || (!_content.expired() && _video_frame);
 }
 
 size_t
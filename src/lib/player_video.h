@@ -37,6 +37,8 @@ class Image;
 class ImageProxy;
 class Film;
 class Socket;
+class BinaryEncodingRequest;
+class Digester;
 
 /** Everything needed to describe a video frame coming out of the player, but with the
  *  bits still their raw form.  We may want to combine the bits on a remote machine,
@@ -59,6 +61,7 @@ public:
 		);
 
 	PlayerVideo (boost::shared_ptr<cxml::Node>, boost::shared_ptr<Socket>);
+	PlayerVideo (BinaryEncodingRequest const &, boost::shared_ptr<Socket>);
 
 	boost::shared_ptr<PlayerVideo> shallow_copy () const;
 
@@ -71,7 +74,9 @@ public:
 	static AVPixelFormat keep_xyz_or_rgb (AVPixelFormat);
 
 	void add_metadata (xmlpp::Node* node) const;
+	bool add_binary_metadata (BinaryEncodingRequest& request) const;
 	void send_binary (boost::shared_ptr<Socket> socket) const;
+	void send_compressed (boost::shared_ptr<Socket> socket) const;
 
 	bool reset_metadata (boost::shared_ptr<const Film> film, dcp::Size video_container_size, dcp::Size film_frame_size);
 
@@ -101,13 +106,15 @@ public:
 	bool same (boost::shared_ptr<const PlayerVideo> other) const;
 
 	size_t memory_used () const;
+	void add_digest (Digester& digester) const;
+	bool digest_is_cheap () const;
 
 	boost::weak_ptr<Content> content () const {
 		return _content;
 	}
 
 private:
-	void make_image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast) const;
+	void make_image (boost::function<AVPixelFormat (AVPixelFormat)> pixel_format, bool aligned, bool fast, bool parallel) const;
 
 	boost::shared_ptr<const ImageProxy> _in;
 	Crop _crop;
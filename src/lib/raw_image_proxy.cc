@@ -20,6 +20,8 @@
 
 #include "raw_image_proxy.h"
 #include "image.h"
+#include "binary_encoding_request.h"
+#include "digester.h"
 #include <dcp/raw_convert.h>
 #include <dcp/util.h>
 #include <libcxml/cxml.h>
@@ -54,6 +56,17 @@ RawImageProxy::RawImageProxy (shared_ptr<cxml::Node> xml, shared_ptr<Socket> soc
 	_image->read_from_socket (socket);
 }
 
+RawImageProxy::RawImageProxy (BinaryEncodingRequest const & request, shared_ptr<Socket> socket)
+{
+	dcp::Size size (request.image_width, request.image_height);
+	_image.reset (new Image (static_cast<AVPixelFormat> (request.image_pixel_format), size, true));
+	if (request.compressed) {
+		_image->read_compressed_from_socket (socket);
+	} else {
+		_image->read_from_socket (socket);
+	}
+}
+
 pair<shared_ptr<Image>, int>
 RawImageProxy::image (optional<dcp::Size>) const
 {
@@ -69,12 +82,27 @@ RawImageProxy::add_metadata (xmlpp::Node* node) const
 	node->add_child("PixelFormat")->add_child_text (raw_convert<string> (static_cast<int> (_image->pixel_format ())));
 }
 
+bool
+RawImageProxy::add_binary_metadata (BinaryEncodingRequest& request) const
+{
+	request.image_width = _image->size().width;
+	request.image_height = _image->size().height;
+	request.image_pixel_format = static_cast<int> (_image->pixel_format ());
+	return true;
+}
+
 void
 RawImageProxy::send_binary (shared_ptr<Socket> socket) const
 {
 	_image->write_to_socket (socket);
 }
 
+void
+RawImageProxy::send_compressed (shared_ptr<Socket> socket) const
+{
+	_image->write_compressed_to_socket (socket);
+}
+
 bool
 RawImageProxy::same (shared_ptr<const ImageProxy> other) const
 {
@@ -86,6 +114,12 @@ RawImageProxy::same (shared_ptr<const ImageProxy> other) const
 	return (*_image.get()) == (*rp->image().first.get());
 }
 
+void
+RawImageProxy::add_digest (Digester& digester) const
+{
+	_image->add_digest (digester);
+}
+
 size_t
 RawImageProxy::memory_used () const
 {
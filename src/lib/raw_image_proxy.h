@@ -28,15 +28,23 @@ class RawImageProxy : public ImageProxy
 public:
 	explicit RawImageProxy (boost::shared_ptr<Image>);
 	RawImageProxy (boost::shared_ptr<cxml::Node> xml, boost::shared_ptr<Socket> socket);
+	RawImageProxy (BinaryEncodingRequest const & request, boost::shared_ptr<Socket> socket);
 
 	std::pair<boost::shared_ptr<Image>, int> image (
 		boost::optional<dcp::Size> size = boost::optional<dcp::Size> ()
 		) const;
 
 	void add_metadata (xmlpp::Node *) const;
+	bool add_binary_metadata (BinaryEncodingRequest& request) const;
 	void send_binary (boost::shared_ptr<Socket>) const;
+	void send_compressed (boost::shared_ptr<Socket>) const;
 	bool same (boost::shared_ptr<const ImageProxy>) const;
 	size_t memory_used () const;
+	void add_digest (Digester& digester) const;
+
+	bool digest_is_cheap () const {
+		return false;
+	}
 
 private:
 	boost::shared_ptr<Image> _image;
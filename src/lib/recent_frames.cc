@@ -0,0 +1,131 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/recent_frames.cc
+ *  @brief RecentFrames class.
+ */
+
+#include "recent_frames.h"
+#include "dcp_video.h"
+
+using std::list;
+using std::map;
+using std::string;
+using boost::shared_ptr;
+using dcp::Data;
+
+/** @param maximum_size Maximum total size of the J2K data to keep, in bytes */
+RecentFrames::RecentFrames (uint64_t maximum_size)
+	: _maximum_size (maximum_size)
+	, _size (0)
+{
+
+}
+
+/** Look for a frame.
+ *  @param digest DCPVideo::digest() of the frame.
+ *  @param frame The frame.
+ *  @param data Filled in with the J2K data if the result is FOUND.
+ *  @return What to do with the frame.  If this is ENCODE the caller must later call put()
+ *  with the result, as other frames may be waiting for it.
+ */
+RecentFrames::Result
+RecentFrames::get (string digest, shared_ptr<DCPVideo> frame, Data& data)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, list<Entry>::iterator>::iterator i = _index.find (digest);
+	if (i != _index.end()) {
+		/* Move this frame to the front as it has just been used */
+		_entries.splice (_entries.begin(), _entries, i->second);
+		data = i->second->data;
+		return FOUND;
+	}
+
+	map<string, Encoding>::iterator j = _encoding.find (digest);
+	if (j == _encoding.end()) {
+		_encoding[digest].frame = frame;
+		return ENCODE;
+	}
+
+	if (j->second.frame == frame) {
+		/* This is the frame that is being encoded, probably coming round again after a failure */
+		return ENCODE;
+	}
+
+	j->second.waiting.push_back (frame);
+	return WAIT;
+}
+
+/** Add some J2K data.
+ *  @param digest DCPVideo::digest() of the frame that was encoded.
+ *  @param data J2K data.
+ *  @return Frames which were waiting for this data, and which should now be written with it.
+ */
+list<shared_ptr<DCPVideo> >
+RecentFrames::put (string digest, Data data)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	list<shared_ptr<DCPVideo> > waiting;
+	map<string, Encoding>::iterator i = _encoding.find (digest);
+	if (i != _encoding.end()) {
+		waiting = i->second.waiting;
+		_encoding.erase (i);
+	}
+
+	if (_index.find (digest) != _index.end() || uint64_t (data.size()) > _maximum_size) {
+		return waiting;
+	}
+
+	_entries.push_front (Entry (digest, data));
+	_index[digest] = _entries.begin ();
+	_size += data.size ();
+
+	while (_size > _maximum_size) {
+		_size -= _entries.back().data.size ();
+		_index.erase (_entries.back().digest);
+		_entries.pop_back ();
+	}
+
+	return waiting;
+}
+
+/** @return All frames which are waiting for others to be encoded; they will no longer be returned by put() */
+list<shared_ptr<DCPVideo> >
+RecentFrames::take_waiting ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	list<shared_ptr<DCPVideo> > waiting;
+	for (map<string, Encoding>::iterator i = _encoding.begin(); i != _encoding.end(); ++i) {
+		waiting.splice (waiting.end(), i->second.waiting);
+	}
+
+	return waiting;
+}
+
+/** @return Total size of the J2K data that we are keeping, in bytes */
+uint64_t
+RecentFrames::size () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _size;
+}
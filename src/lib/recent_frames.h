@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_RECENT_FRAMES_H
+#define DCPOMATIC_RECENT_FRAMES_H
+
+/** @file  src/lib/recent_frames.h
+ *  @brief RecentFrames class.
+ */
+
+#include <dcp/data.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+
+class DCPVideo;
+
+/** @class RecentFrames
+ *  @brief The J2K data of frames which have been encoded recently, keyed by DCPVideo::digest(),
+ *  so that a frame which is the same as one seen earlier in an encode can be written without
+ *  encoding it again.
+ *
+ *  The least recently used frames are forgotten when their total size goes over a maximum.
+ *  We also remember which frame is being encoded for each digest, so that identical frames which
+ *  arrive while that is happening can wait for its result rather than being encoded too.
+ */
+class RecentFrames : public boost::noncopyable
+{
+public:
+	explicit RecentFrames (uint64_t maximum_size);
+
+	enum Result {
+		/** the J2K data for the frame has been found */
+		FOUND,
+		/** an identical frame is being encoded; this frame will be returned by put() when it is done */
+		WAIT,
+		/** the frame should be encoded */
+		ENCODE
+	};
+
+	Result get (std::string digest, boost::shared_ptr<DCPVideo> frame, dcp::Data& data);
+	std::list<boost::shared_ptr<DCPVideo> > put (std::string digest, dcp::Data data);
+	std::list<boost::shared_ptr<DCPVideo> > take_waiting ();
+
+	uint64_t size () const;
+
+private:
+	struct Entry
+	{
+		Entry (std::string d, dcp::Data da)
+			: digest (d)
+			, data (da)
+		{}
+
+		std::string digest;
+		dcp::Data data;
+	};
+
+	/** A frame which is being encoded, and those which are waiting for it */
+	struct Encoding
+	{
+		boost::shared_ptr<DCPVideo> frame;
+		std::list<boost::shared_ptr<DCPVideo> > waiting;
+	};
+
+	uint64_t _maximum_size;
+
+	/** mutex for everything below */
+	mutable boost::mutex _mutex;
+	/** frames that we know, most recently used first */
+	std::list<Entry> _entries;
+	/** iterators into _entries, keyed by digest */
+	std::map<std::string, std::list<Entry>::iterator> _index;
+	/** total size of the data in _entries */
+	uint64_t _size;
+	/** frames being encoded, keyed by digest */
+	std::map<std::string, Encoding> _encoding;
+};
+
+#endif
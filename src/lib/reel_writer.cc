@@ -29,6 +29,7 @@
 #include "compose.hpp"
 #include "audio_buffers.h"
 #include "image.h"
+#include "frame_info_file.h"
 #include <dcp/mono_picture_asset.h>
 #include <dcp/stereo_picture_asset.h>
 #include <dcp/sound_asset.h>
@@ -60,8 +61,6 @@ using boost::dynamic_pointer_cast;
 using dcp::Data;
 using dcp::raw_convert;
 
-int const ReelWriter::_info_size = 48;
-
 ReelWriter::ReelWriter (
 	shared_ptr<const Film> film, DCPTimePeriod period, shared_ptr<Job> job, int reel_index, int reel_count, optional<string> content_summary
 	)
@@ -72,6 +71,7 @@ ReelWriter::ReelWriter (
 	, _reel_index (reel_index)
 	, _reel_count (reel_count)
 	, _content_summary (content_summary)
+	, _picture_finished (false)
 {
 	/* Create our picture asset in a subdirectory, named according to those
 	   film's parameters which affect the video output.  We will hard-link
@@ -97,6 +97,8 @@ ReelWriter::ReelWriter (
 		_film->internal_video_asset_dir() / _film->internal_video_asset_filename(_period)
 		);
 
+	_info_file.reset (new FrameInfoFile (_film->info_file (_period)));
+
 	job->sub (_("Checking existing image data"));
 	_first_nonexistant_frame = check_existing_picture_asset ();
 
@@ -126,60 +128,10 @@ ReelWriter::ReelWriter (
 }
 
 /** @param frame reel-relative frame */
-void
-ReelWriter::write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const
-{
-	FILE* file = 0;
-	boost::filesystem::path info_file = _film->info_file (_period);
-
-	bool const read = boost::filesystem::exists (info_file);
-
-	if (read) {
-		file = fopen_boost (info_file, "r+b");
-	} else {
-		file = fopen_boost (info_file, "wb");
-	}
-	if (!file) {
-		throw OpenFileError (info_file, errno, read);
-	}
-	dcpomatic_fseek (file, frame_info_position (frame, eyes), SEEK_SET);
-	checked_fwrite (&info.offset, sizeof (info.offset), file, info_file);
-	checked_fwrite (&info.size, sizeof (info.size), file, info_file);
-	checked_fwrite (info.hash.c_str(), info.hash.size(), file, info_file);
-	fclose (file);
-}
-
 dcp::FrameInfo
-ReelWriter::read_frame_info (FILE* file, Frame frame, Eyes eyes) const
-{
-	dcp::FrameInfo info;
-	dcpomatic_fseek (file, frame_info_position (frame, eyes), SEEK_SET);
-	checked_fread (&info.offset, sizeof(info.offset), file, _film->info_file(_period));
-	checked_fread (&info.size, sizeof(info.size), file, _film->info_file(_period));
-
-	char hash_buffer[33];
-	checked_fread (hash_buffer, 32, file, _film->info_file(_period));
-	hash_buffer[32] = '\0';
-	info.hash = hash_buffer;
-
-	return info;
-}
-
-long
-ReelWriter::frame_info_position (Frame frame, Eyes eyes) const
+ReelWriter::read_frame_info (Frame frame, Eyes eyes) const
 {
-	switch (eyes) {
-	case EYES_BOTH:
-		return frame * _info_size;
-	case EYES_LEFT:
-		return frame * _info_size * 2;
-	case EYES_RIGHT:
-		return frame * _info_size * 2 + _info_size;
-	default:
-		DCPOMATIC_ASSERT (false);
-	}
-
-	DCPOMATIC_ASSERT (false);
+	return _info_file->read (frame, eyes);
 }
 
 Frame
@@ -207,17 +159,17 @@ ReelWriter::check_existing_picture_asset ()
 		LOG_GENERAL ("Opened existing asset at %1", asset.string());
 	}
 
-	/* Offset of the last dcp::FrameInfo in the info file */
-	int const n = (boost::filesystem::file_size (_film->info_file(_period)) / _info_size) - 1;
-	LOG_GENERAL ("The last FI is %1; info file is %2, info size %3", n, boost::filesystem::file_size (_film->info_file(_period)), _info_size);
-
-	FILE* info_file = fopen_boost (_film->info_file(_period), "rb");
-	if (!info_file) {
-		LOG_GENERAL_NC ("Could not open film info file");
+	int64_t const entries = _info_file->entries ();
+	if (entries == 0) {
+		LOG_GENERAL_NC ("Film info file is empty");
 		fclose (asset_file);
 		return 0;
 	}
 
+	/* Offset of the last dcp::FrameInfo in the info file */
+	int const n = entries - 1;
+	LOG_GENERAL ("The last FI is %1", n);
+
 	Frame first_nonexistant_frame;
 	if (_film->three_d ()) {
 		/* Start looking at the last left frame */
@@ -226,7 +178,7 @@ ReelWriter::check_existing_picture_asset ()
 		first_nonexistant_frame = n;
 	}
 
-	while (!existing_picture_frame_ok(asset_file, info_file, first_nonexistant_frame) && first_nonexistant_frame > 0) {
+	while (!existing_picture_frame_ok(asset_file, first_nonexistant_frame) && first_nonexistant_frame > 0) {
 		--first_nonexistant_frame;
 	}
 
@@ -240,7 +192,6 @@ ReelWriter::check_existing_picture_asset ()
 	LOG_GENERAL ("Proceeding with first nonexistant frame %1", first_nonexistant_frame);
 
 	fclose (asset_file);
-	fclose (info_file);
 
 	return first_nonexistant_frame;
 }
@@ -248,8 +199,9 @@ ReelWriter::check_existing_picture_asset ()
 void
 ReelWriter::write (optional<Data> encoded, Frame frame, Eyes eyes)
 {
+	DCPOMATIC_ASSERT (!_picture_finished);
 	dcp::FrameInfo fin = _picture_asset_writer->write (encoded->data().get (), encoded->size());
-	write_frame_info (frame, eyes, fin);
+	_info_file->write (frame, eyes, fin);
 	_last_written[eyes] = encoded;
 	_last_written_video_frame = frame;
 	_last_written_eyes = eyes;
@@ -258,6 +210,7 @@ ReelWriter::write (optional<Data> encoded, Frame frame, Eyes eyes)
 void
 ReelWriter::fake_write (Frame frame, Eyes eyes, int size)
 {
+	DCPOMATIC_ASSERT (!_picture_finished);
 	_picture_asset_writer->fake_write (size);
 	_last_written_video_frame = frame;
 	_last_written_eyes = eyes;
@@ -266,29 +219,32 @@ ReelWriter::fake_write (Frame frame, Eyes eyes, int size)
 void
 ReelWriter::repeat_write (Frame frame, Eyes eyes)
 {
+	DCPOMATIC_ASSERT (!_picture_finished);
 	dcp::FrameInfo fin = _picture_asset_writer->write (
 		_last_written[eyes]->data().get(),
 		_last_written[eyes]->size()
 		);
-	write_frame_info (frame, eyes, fin);
+	_info_file->write (frame, eyes, fin);
 	_last_written_video_frame = frame;
 	_last_written_eyes = eyes;
 }
 
+/** Finish our picture asset and hard-link it into the DCP.  This can be called as soon
+ *  as the last picture frame has been written; otherwise finish() will call it.  No more
+ *  picture frames may be written afterwards.
+ */
 void
-ReelWriter::finish ()
+ReelWriter::finish_picture ()
 {
+	DCPOMATIC_ASSERT (!_picture_finished);
+	_picture_finished = true;
+
 	if (!_picture_asset_writer->finalize ()) {
 		/* Nothing was written to the picture asset */
 		LOG_GENERAL ("Nothing was written to reel %1 of %2", _reel_index, _reel_count);
 		_picture_asset.reset ();
 	}
 
-	if (_sound_asset_writer && !_sound_asset_writer->finalize ()) {
-		/* Nothing was written to the sound asset */
-		_sound_asset.reset ();
-	}
-
 	/* Hard-link any video asset file into the DCP */
 	if (_picture_asset) {
 		DCPOMATIC_ASSERT (_picture_asset->file());
@@ -310,6 +266,19 @@ ReelWriter::finish ()
 
 		_picture_asset->set_file (video_to);
 	}
+}
+
+void
+ReelWriter::finish ()
+{
+	if (!_picture_finished) {
+		finish_picture ();
+	}
+
+	if (_sound_asset_writer && !_sound_asset_writer->finalize ()) {
+		/* Nothing was written to the sound asset */
+		_sound_asset.reset ();
+	}
 
 	/* Move the audio asset into the DCP */
 	if (_sound_asset) {
@@ -517,6 +486,18 @@ ReelWriter::create_reel (list<ReferencedReelAsset> const & refs, list<shared_ptr
 	return reel;
 }
 
+/** Calculate the digest of our picture asset, which must have been finished.  The digest is
+ *  kept by the asset so calculate_digests() will not have to calculate it again.
+ */
+void
+ReelWriter::calculate_picture_digest ()
+{
+	DCPOMATIC_ASSERT (_picture_finished);
+	if (_picture_asset) {
+		_picture_asset->hash ();
+	}
+}
+
 void
 ReelWriter::calculate_digests (boost::function<void (float)> set_progress)
 {
@@ -630,14 +611,14 @@ ReelWriter::write (PlayerText subs, TextType type, optional<DCPTextTrack> track,
 }
 
 bool
-ReelWriter::existing_picture_frame_ok (FILE* asset_file, FILE* info_file, Frame frame) const
+ReelWriter::existing_picture_frame_ok (FILE* asset_file, Frame frame) const
 {
 	LOG_GENERAL ("Checking existing picture frame %1", frame);
 
 	/* Read the data from the info file; for 3D we just check the left
 	   frames until we find a good one.
 	*/
-	dcp::FrameInfo const info = read_frame_info (info_file, frame, _film->three_d () ? EYES_LEFT : EYES_BOTH);
+	dcp::FrameInfo const info = read_frame_info (frame, _film->three_d () ? EYES_LEFT : EYES_BOTH);
 
 	bool ok = true;
 
@@ -30,6 +30,7 @@ class Film;
 class Job;
 class Font;
 class AudioBuffers;
+class FrameInfoFile;
 
 namespace dcp {
 	class MonoPictureAsset;
@@ -63,8 +64,10 @@ public:
 	void write (boost::shared_ptr<const AudioBuffers> audio);
 	void write (PlayerText text, TextType type, boost::optional<DCPTextTrack> track, DCPTimePeriod period);
 
+	void finish_picture ();
 	void finish ();
 	boost::shared_ptr<dcp::Reel> create_reel (std::list<ReferencedReelAsset> const & refs, std::list<boost::shared_ptr<Font> > const & fonts);
+	void calculate_picture_digest ();
 	void calculate_digests (boost::function<void (float)> set_progress);
 
 	Frame start () const;
@@ -85,14 +88,12 @@ public:
 		return _first_nonexistant_frame;
 	}
 
-	dcp::FrameInfo read_frame_info (FILE* file, Frame frame, Eyes eyes) const;
+	dcp::FrameInfo read_frame_info (Frame frame, Eyes eyes) const;
 
 private:
 
-	void write_frame_info (Frame frame, Eyes eyes, dcp::FrameInfo info) const;
-	long frame_info_position (Frame frame, Eyes eyes) const;
 	Frame check_existing_picture_asset ();
-	bool existing_picture_frame_ok (FILE* asset_file, FILE* info_file, Frame frame) const;
+	bool existing_picture_frame_ok (FILE* asset_file, Frame frame) const;
 
 	boost::shared_ptr<const Film> _film;
 
@@ -112,10 +113,12 @@ private:
 
 	boost::shared_ptr<dcp::PictureAsset> _picture_asset;
 	boost::shared_ptr<dcp::PictureAssetWriter> _picture_asset_writer;
+	/** true if finish_picture() has been called */
+	bool _picture_finished;
 	boost::shared_ptr<dcp::SoundAsset> _sound_asset;
 	boost::shared_ptr<dcp::SoundAssetWriter> _sound_asset_writer;
 	boost::shared_ptr<dcp::SubtitleAsset> _subtitle_asset;
 	std::map<DCPTextTrack, boost::shared_ptr<dcp::SubtitleAsset> > _closed_caption_assets;
-
-	static int const _info_size;
+	/** information about each frame that has been written to _picture_asset, kept open while we are writing */
+	boost::shared_ptr<FrameInfoFile> _info_file;
 };
@@ -24,6 +24,8 @@
 #include "cross.h"
 #include "font.h"
 #include "dcpomatic_assert.h"
+#include "digester.h"
+#include "rendered_text_cache.h"
 #include <dcp/raw_convert.h>
 #include <fontconfig/fontconfig.h>
 #include <cairomm/cairomm.h>
@@ -87,6 +89,83 @@ set_source_rgba (Cairo::RefPtr<Cairo::Context> context, dcp::Colour colour, floa
 	context->set_source_rgba (float(colour.r) / 255, float(colour.g) / 255, float(colour.b) / 255, fade_factor);
 }
 
+/** @param subtitle Subtitle.
+ *  @param time Time of the frame that the subtitle is going on.
+ *  @param frame_rate DCP frame rate.
+ *  @return Amount that the subtitle should be faded by at this time; 0 is invisible, 1 is no fade.
+ */
+static float
+calculate_fade_factor (StringText const & subtitle, DCPTime time, int frame_rate)
+{
+	float fade_factor = 1;
+
+	/* Round the fade start/end to the nearest frame start.  Otherwise if a subtitle starts just after
+	   the start of a frame it will be faded out.
+	*/
+	DCPTime const fade_in_start = DCPTime::from_seconds(subtitle.in().as_seconds()).round(frame_rate);
+	DCPTime const fade_in_end = fade_in_start + DCPTime::from_seconds (subtitle.fade_up_time().as_seconds ());
+	DCPTime const fade_out_end =  DCPTime::from_seconds (subtitle.out().as_seconds()).round(frame_rate);
+	DCPTime const fade_out_start = fade_out_end - DCPTime::from_seconds (subtitle.fade_down_time().as_seconds ());
+
+	if (fade_in_start <= time && time <= fade_in_end && fade_in_start != fade_in_end) {
+		fade_factor *= DCPTime(time - fade_in_start).seconds() / DCPTime(fade_in_end - fade_in_start).seconds();
+	}
+	if (fade_out_start <= time && time <= fade_out_end && fade_out_start != fade_out_end) {
+		fade_factor *= 1 - DCPTime(time - fade_out_start).seconds() / DCPTime(fade_out_end - fade_out_start).seconds();
+	}
+	if (time < fade_in_start || time > fade_out_end) {
+		fade_factor = 0;
+	}
+
+	return fade_factor;
+}
+
+static void
+add_colour (Digester& digester, dcp::Colour colour)
+{
+	digester.add (colour.r);
+	digester.add (colour.g);
+	digester.add (colour.b);
+}
+
+/** @return Key for RenderedTextCache, made from everything that render_line uses to draw these subtitles */
+static string
+cache_key (list<StringText> const & subtitles, list<shared_ptr<Font> > const & fonts, dcp::Size target, float fade_factor)
+{
+	Digester digester;
+
+	digester.add (target.width);
+	digester.add (target.height);
+	digester.add (fade_factor);
+
+	BOOST_FOREACH (StringText const & i, subtitles) {
+		digester.add (static_cast<bool> (i.font ()));
+		digester.add (i.font().get_value_or (""));
+		digester.add (i.italic ());
+		digester.add (i.bold ());
+		digester.add (i.underline ());
+		add_colour (digester, i.colour ());
+		digester.add (i.size ());
+		digester.add (i.aspect_adjust ());
+		digester.add (i.h_position ());
+		digester.add (i.h_align ());
+		digester.add (i.v_position ());
+		digester.add (i.v_align ());
+		digester.add (i.effect ());
+		add_colour (digester, i.effect_colour ());
+		digester.add (i.outline_width);
+		digester.add (i.text ());
+	}
+
+	BOOST_FOREACH (shared_ptr<Font> i, fonts) {
+		if (i->id() == subtitles.front().font() && i->file()) {
+			digester.add (i->file()->string ());
+		}
+	}
+
+	return digester.get ();
+}
+
 /** @param subtitles A list of subtitles that are all on the same line,
  *  at the same time and with the same fade in/out.
  */
@@ -99,6 +178,14 @@ render_line (list<StringText> subtitles, list<shared_ptr<Font> > fonts, dcp::Siz
 
 	DCPOMATIC_ASSERT (!subtitles.empty ());
 
+	float const fade_factor = calculate_fade_factor (subtitles.front(), time, frame_rate);
+
+	string const key = cache_key (subtitles, fonts, target, fade_factor);
+	optional<PositionImage> cached = RenderedTextCache::instance()->get (key);
+	if (cached) {
+		return *cached;
+	}
+
 	/* Calculate x and y scale factors.  These are only used to stretch
 	   the font away from its normal aspect ratio.
 	*/
@@ -229,27 +316,6 @@ render_line (list<StringText> subtitles, list<shared_ptr<Font> > fonts, dcp::Siz
 
 	context->set_line_width (1);
 
-	/* Compute fade factor */
-	float fade_factor = 1;
-
-	/* Round the fade start/end to the nearest frame start.  Otherwise if a subtitle starts just after
-	   the start of a frame it will be faded out.
-	*/
-	DCPTime const fade_in_start = DCPTime::from_seconds(subtitles.front().in().as_seconds()).round(frame_rate);
-	DCPTime const fade_in_end = fade_in_start + DCPTime::from_seconds (subtitles.front().fade_up_time().as_seconds ());
-	DCPTime const fade_out_end =  DCPTime::from_seconds (subtitles.front().out().as_seconds()).round(frame_rate);
-	DCPTime const fade_out_start = fade_out_end - DCPTime::from_seconds (subtitles.front().fade_down_time().as_seconds ());
-
-	if (fade_in_start <= time && time <= fade_in_end && fade_in_start != fade_in_end) {
-		fade_factor *= DCPTime(time - fade_in_start).seconds() / DCPTime(fade_in_end - fade_in_start).seconds();
-	}
-	if (fade_out_start <= time && time <= fade_out_end && fade_out_start != fade_out_end) {
-		fade_factor *= 1 - DCPTime(time - fade_out_start).seconds() / DCPTime(fade_out_end - fade_out_start).seconds();
-	}
-	if (time < fade_in_start || time > fade_out_end) {
-		fade_factor = 0;
-	}
-
 	/* Render the subtitle at the top left-hand corner of image */
 
 	Pango::FontDescription font (font_name);
@@ -337,7 +403,9 @@ render_line (list<StringText> subtitles, list<shared_ptr<Font> > fonts, dcp::Siz
 		break;
 	}
 
-	return PositionImage (image, Position<int> (max (0, x), max (0, y)));
+	PositionImage rendered (image, Position<int> (max (0, x), max (0, y)));
+	RenderedTextCache::instance()->put (key, rendered);
+	return rendered;
 }
 
 /** @param time Time of the frame that these subtitles are going on.
@@ -0,0 +1,134 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** @file  src/lib/rendered_text_cache.cc
+ *  @brief RenderedTextCache class.
+ */
+
+#include "rendered_text_cache.h"
+#include "image.h"
+
+using std::map;
+using std::string;
+using std::make_pair;
+using boost::optional;
+
+/** Largest amount of image data that we will keep, in bytes; each line of text for a 2K
+ *  DCP is around 2MB, so this is enough for a couple of minutes of typical subtitles.
+ */
+static size_t const rendered_text_cache_size = 64 * 1024 * 1024;
+
+RenderedTextCache* RenderedTextCache::_instance = 0;
+boost::mutex RenderedTextCache::_instance_mutex;
+
+RenderedTextCache::RenderedTextCache ()
+	: _held (0)
+	, _hits (0)
+	, _misses (0)
+{
+
+}
+
+RenderedTextCache*
+RenderedTextCache::instance ()
+{
+	boost::mutex::scoped_lock lm (_instance_mutex);
+	if (!_instance) {
+		_instance = new RenderedTextCache ();
+	}
+
+	return _instance;
+}
+
+/** @param key Digest of everything that affects how the image looks.
+ *  @return Image, if we have one for that key.
+ */
+optional<PositionImage>
+RenderedTextCache::get (string const & key)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	map<string, List::iterator>::iterator i = _index.find (key);
+	if (i == _index.end ()) {
+		++_misses;
+		return optional<PositionImage> ();
+	}
+
+	/* Move it to the front as it is now the most recently used */
+	_images.splice (_images.begin(), _images, i->second);
+	++_hits;
+	return i->second->second;
+}
+
+void
+RenderedTextCache::put (string const & key, PositionImage image)
+{
+	size_t const size = image.image ? image.image->memory_used() : 0;
+	if (size > rendered_text_cache_size) {
+		return;
+	}
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	if (_index.find (key) != _index.end ()) {
+		/* Someone else made the same image while we were making ours */
+		return;
+	}
+
+	_images.push_front (make_pair (key, image));
+	_index[key] = _images.begin ();
+	_held += size;
+
+	while (_held > rendered_text_cache_size) {
+		PositionImage const & last = _images.back().second;
+		_held -= last.image ? last.image->memory_used() : 0;
+		_index.erase (_images.back().first);
+		_images.pop_back ();
+	}
+}
+
+void
+RenderedTextCache::clear ()
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	_images.clear ();
+	_index.clear ();
+	_held = 0;
+}
+
+uint64_t
+RenderedTextCache::hits () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _hits;
+}
+
+uint64_t
+RenderedTextCache::misses () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _misses;
+}
+
+size_t
+RenderedTextCache::held () const
+{
+	boost::mutex::scoped_lock lm (_mutex);
+	return _held;
+}
@@ -0,0 +1,80 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef DCPOMATIC_RENDERED_TEXT_CACHE_H
+#define DCPOMATIC_RENDERED_TEXT_CACHE_H
+
+/** @file  src/lib/rendered_text_cache.h
+ *  @brief RenderedTextCache class.
+ */
+
+#include "position_image.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+
+/** @class RenderedTextCache
+ *  @brief A store of the images that render_text() has made recently.
+ *
+ *  A subtitle is usually on screen, looking exactly the same, for many frames; this
+ *  saves laying it out and drawing it again for each one.  Images are keyed by a digest
+ *  of everything that affects how they look, and the least recently used are dropped
+ *  when the cache gets too big.  The images are shared by everything that gets them
+ *  from the cache, so they must not be modified.
+ */
+class RenderedTextCache : public boost::noncopyable
+{
+public:
+	boost::optional<PositionImage> get (std::string const & key);
+	void put (std::string const & key, PositionImage image);
+	void clear ();
+
+	/** @return number of times that get() has found an image */
+	uint64_t hits () const;
+	/** @return number of times that get() has not found an image */
+	uint64_t misses () const;
+	/** @return total memory used by the images in the cache, in bytes */
+	size_t held () const;
+
+	static RenderedTextCache* instance ();
+
+private:
+	RenderedTextCache ();
+
+	typedef std::list<std::pair<std::string, PositionImage> > List;
+
+	/** mutex for everything below */
+	mutable boost::mutex _mutex;
+	/** images with their keys, most recently used first */
+	List _images;
+	/** iterators into _images, keyed by key */
+	std::map<std::string, List::iterator> _index;
+	size_t _held;
+	uint64_t _hits;
+	uint64_t _misses;
+
+	static RenderedTextCache* _instance;
+	static boost::mutex _instance_mutex;
+};
+
+#endif
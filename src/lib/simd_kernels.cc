@@ -0,0 +1,56 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** @file  src/lib/simd_kernels.cc
+ *  @brief SIMDKernels class.
+ */
+
+#include "simd_kernels.h"
+
+/** @return true if this CPU can use a particular kernel */
+bool
+SIMDKernels::supported (Kernel kernel)
+{
+	switch (kernel) {
+	case KERNEL_SCALAR:
+		return true;
+#ifdef DCPOMATIC_X86
+	case KERNEL_SSE2:
+		return __builtin_cpu_supports ("sse2");
+	case KERNEL_AVX2:
+		return __builtin_cpu_supports ("avx2");
+#endif
+	default:
+		return false;
+	}
+}
+
+/** @param fastest Fastest kernel that the caller has code for.
+ *  @return The fastest kernel, no faster than `fastest', that this CPU can use.
+ */
+SIMDKernels::Kernel
+SIMDKernels::best_kernel (Kernel fastest)
+{
+	int k = fastest;
+	while (k > KERNEL_SCALAR && !supported (static_cast<Kernel> (k))) {
+		--k;
+	}
+
+	return static_cast<Kernel> (k);
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef DCPOMATIC_SIMD_KERNELS_H
+#define DCPOMATIC_SIMD_KERNELS_H
+
+/** @file  src/lib/simd_kernels.h
+ *  @brief SIMDKernels class.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DCPOMATIC_X86
+#endif
+
+/** @class SIMDKernels
+ *  @brief The choice of kernel for classes which have SIMD versions of some code
+ *  (AlphaBlender, Fader and XYZConverter), and which of them this CPU can use.
+ *
+ *  Every kernel of such a class gives exactly the same results as its scalar code: the SIMD
+ *  versions do the same sums, in the same precision and order, and convert to integers in the
+ *  same way.  They must not be built with FMA as that would round differently.  This means that
+ *  our output does not depend on the CPU that made it, so that (for example) frames from
+ *  different machines can be compared or cached.
+ */
+class SIMDKernels
+{
+public:
+	/** Kernels, in order of speed.  Each CPU which can use a kernel can also use the ones
+	 *  before it, so a class without code for a kernel uses the code for the fastest one
+	 *  before it that it does have.
+	 */
+	enum Kernel {
+		KERNEL_SCALAR,
+		KERNEL_SSE2,
+		KERNEL_AVX2
+	};
+
+	static bool supported (Kernel kernel);
+
+protected:
+	static Kernel best_kernel (Kernel fastest);
+};
+
+#endif
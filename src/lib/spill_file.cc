@@ -0,0 +1,207 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/spill_file.cc
+ *  @brief SpillFile class.
+ */
+
+#include "spill_file.h"
+#include "cross.h"
+#include "util.h"
+#include "exceptions.h"
+#include "dcpomatic_assert.h"
+
+using std::list;
+using std::pair;
+using std::make_pair;
+using boost::optional;
+using boost::bind;
+using dcp::Data;
+
+/** @param path File to use; anything that is already there will be overwritten.
+ *  @param maximum_pending Number of frames that put() can be given before it waits for
+ *  some of them to be written.
+ */
+SpillFile::SpillFile (boost::filesystem::path path, int maximum_pending)
+	: _path (path)
+	, _maximum_pending (maximum_pending)
+	, _end (0)
+	, _writing_taken (false)
+{
+	_file = fopen_boost (_path, "w+b");
+	if (!_file) {
+		throw OpenFileError (_path, errno, false);
+	}
+
+	_thread = new boost::thread (bind (&SpillFile::thread, this));
+#ifdef DCPOMATIC_LINUX
+	pthread_setname_np (_thread->native_handle(), "spill-file");
+#endif
+}
+
+SpillFile::~SpillFile ()
+{
+	_thread->interrupt ();
+	try {
+		_thread->join ();
+	} catch (boost::thread_interrupted& e) {
+		/* No problem */
+	}
+	delete _thread;
+
+	fclose (_file);
+	boost::system::error_code ec;
+	boost::filesystem::remove (_path, ec);
+}
+
+/** Add a frame to the file.  This will only wait for the disk if there are already
+ *  too many frames waiting to be written.
+ */
+void
+SpillFile::put (Frame frame, Eyes eyes, Data data)
+{
+	boost::mutex::scoped_lock lm (_mutex);
+
+	while (int(_pending.size()) >= _maximum_pending && !_error) {
+		_room_condition.wait (lm);
+	}
+
+	if (_error) {
+		boost::rethrow_exception (_error);
+	}
+
+	_pending.push_back (make_pair (Key (frame, eyes), data));
+	_pending_condition.notify_all ();
+}
+
+/** Take a frame out of the file; it must have been given to put() and not
+ *  already taken out.
+ */
+Data
+SpillFile::get (Frame frame, Eyes eyes)
+{
+	Key const key (frame, eyes);
+
+	boost::mutex::scoped_lock lm (_mutex);
+
+	/* We may still have the data in memory */
+
+	for (list<pair<Key, Data> >::iterator i = _pending.begin(); i != _pending.end(); ++i) {
+		if (i->first == key) {
+			Data const data = i->second;
+			_pending.erase (i);
+			_room_condition.notify_all ();
+			return data;
+		}
+	}
+
+	if (_writing && _writing->first == key) {
+		/* Our thread will not put this in _index when it has finished writing it */
+		_writing_taken = true;
+		return _writing->second;
+	}
+
+	if (_error) {
+		boost::rethrow_exception (_error);
+	}
+
+	std::map<Key, pair<int64_t, int> >::iterator i = _index.find (key);
+	DCPOMATIC_ASSERT (i != _index.end());
+	pair<int64_t, int> const position = i->second;
+	_index.erase (i);
+
+	Data data (position.second);
+
+	{
+		boost::mutex::scoped_lock fm (_file_mutex);
+		dcpomatic_fseek (_file, position.first, SEEK_SET);
+		checked_fread (data.data().get(), data.size(), _file, _path);
+	}
+
+	empty_if_unused ();
+	return data;
+}
+
+/** Empty the file if nothing in it is needed and nothing is about to be written to it,
+ *  so that it does not get any bigger than it needs to.  Caller must hold a lock on _mutex.
+ */
+void
+SpillFile::empty_if_unused ()
+{
+	if (!_index.empty() || !_pending.empty() || _writing) {
+		return;
+	}
+
+	boost::mutex::scoped_lock fm (_file_mutex);
+	if (_end == 0) {
+		return;
+	}
+
+	fclose (_file);
+	_file = fopen_boost (_path, "w+b");
+	if (!_file) {
+		throw OpenFileError (_path, errno, false);
+	}
+	_end = 0;
+}
+
+void
+SpillFile::thread ()
+try
+{
+	while (true) {
+		boost::mutex::scoped_lock lm (_mutex);
+
+		while (_pending.empty ()) {
+			_pending_condition.wait (lm);
+		}
+
+		_writing = _pending.front ();
+		_writing_taken = false;
+		_pending.pop_front ();
+		_room_condition.notify_all ();
+		Data const data = _writing->second;
+
+		lm.unlock ();
+
+		int64_t offset = 0;
+		{
+			boost::mutex::scoped_lock fm (_file_mutex);
+			offset = _end;
+			dcpomatic_fseek (_file, _end, SEEK_SET);
+			checked_fwrite (data.data().get(), data.size(), _file, _path);
+			_end += data.size ();
+		}
+
+		lm.lock ();
+
+		if (!_writing_taken) {
+			_index[_writing->first] = make_pair (offset, data.size());
+		}
+		_writing = optional<pair<Key, Data> > ();
+		empty_if_unused ();
+	}
+} catch (boost::thread_interrupted& e) {
+	/* The thread is being terminated */
+} catch (...) {
+	boost::mutex::scoped_lock lm (_mutex);
+	_error = boost::current_exception ();
+	_room_condition.notify_all ();
+}
@@ -0,0 +1,93 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_SPILL_FILE_H
+#define DCPOMATIC_SPILL_FILE_H
+
+/** @file  src/lib/spill_file.h
+ *  @brief SpillFile class.
+ */
+
+#include "types.h"
+#include <dcp/data.h>
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/optional.hpp>
+#include <boost/exception_ptr.hpp>
+#include <list>
+#include <map>
+
+/** @class SpillFile
+ *  @brief A file to hold JPEG2000 frames for one reel which Writer has had to take out of memory
+ *  before it could write them to the reel's picture asset.
+ *
+ *  Frames are appended to the file by a thread of our own, so put() does not have to wait for
+ *  the disk unless there are already too many frames waiting to be written.  The file is emptied
+ *  whenever everything in it has been taken out with get(), and it is deleted when the
+ *  SpillFile is destroyed.
+ */
+class SpillFile : public boost::noncopyable
+{
+public:
+	SpillFile (boost::filesystem::path path, int maximum_pending);
+	~SpillFile ();
+
+	void put (Frame frame, Eyes eyes, dcp::Data data);
+	dcp::Data get (Frame frame, Eyes eyes);
+
+private:
+	typedef std::pair<Frame, Eyes> Key;
+
+	void thread ();
+	void empty_if_unused ();
+
+	boost::filesystem::path _path;
+	/** maximum number of frames that put() will hold before waiting for them to be written */
+	int _maximum_pending;
+
+	/** mutex to protect _file and _end */
+	boost::mutex _file_mutex;
+	FILE* _file;
+	/** offset in _file at which to write the next frame */
+	int64_t _end;
+
+	/** mutex to protect the things below */
+	boost::mutex _mutex;
+	/** frames waiting to be written, in the order that put() was given them */
+	std::list<std::pair<Key, dcp::Data> > _pending;
+	/** frame that the thread is writing, if any */
+	boost::optional<std::pair<Key, dcp::Data> > _writing;
+	/** true if the frame that the thread is writing has been taken by get() */
+	bool _writing_taken;
+	/** offsets and sizes of the frames in _file which have not been taken by get() */
+	std::map<Key, std::pair<int64_t, int> > _index;
+	/** exception thrown by the thread, if there was one */
+	boost::exception_ptr _error;
+	/** condition to wake our thread when there is something to write */
+	boost::condition _pending_condition;
+	/** condition to wake put() when there may be room in _pending */
+	boost::condition _room_condition;
+
+	boost::thread* _thread;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/sws_context_cache.cc
+ *  @brief SwsContextCache class.
+ */
+
+#include "sws_context_cache.h"
+#include "dcpomatic_assert.h"
+extern "C" {
+#include <libswscale/swscale.h>
+}
+#include <boost/thread/tss.hpp>
+#include <stdexcept>
+
+#include "i18n.h"
+
+using std::list;
+using std::runtime_error;
+
+/** Number of contexts that each thread keeps */
+static size_t const contexts_per_thread = 8;
+
+static boost::thread_specific_ptr<SwsContextCache> caches;
+
+boost::mutex SwsContextCache::_counters_mutex;
+uint64_t SwsContextCache::_hits = 0;
+uint64_t SwsContextCache::_misses = 0;
+
+SwsContextCache::~SwsContextCache ()
+{
+	for (list<Entry>::const_iterator i = _entries.begin(); i != _entries.end(); ++i) {
+		sws_freeContext (i->context);
+	}
+}
+
+/** @return A context for a conversion, which belongs to the cache and must not be freed.
+ *  It may be used until the next call to get() in this thread.
+ */
+SwsContext*
+SwsContextCache::get (
+	dcp::Size in_size, AVPixelFormat in_format, dcp::Size out_size, AVPixelFormat out_format, int flags, dcp::YUVToRGB yuv_to_rgb
+	)
+{
+	if (!caches.get ()) {
+		caches.reset (new SwsContextCache ());
+	}
+
+	list<Entry>& entries = caches->_entries;
+
+	for (list<Entry>::iterator i = entries.begin(); i != entries.end(); ++i) {
+		if (
+			i->in_size == in_size && i->in_format == in_format &&
+			i->out_size == out_size && i->out_format == out_format &&
+			i->flags == flags && i->yuv_to_rgb == yuv_to_rgb
+			) {
+
+			entries.splice (entries.begin(), entries, i);
+			boost::mutex::scoped_lock lm (_counters_mutex);
+			++_hits;
+			return entries.front().context;
+		}
+	}
+
+	SwsContext* context = sws_getContext (
+		in_size.width, in_size.height, in_format,
+		out_size.width, out_size.height, out_format,
+		flags, 0, 0, 0
+		);
+
+	if (!context) {
+		throw runtime_error (N_("Could not allocate SwsContext"));
+	}
+
+	DCPOMATIC_ASSERT (yuv_to_rgb < dcp::YUV_TO_RGB_COUNT);
+	int const lut[dcp::YUV_TO_RGB_COUNT] = {
+		SWS_CS_ITU601,
+		SWS_CS_ITU709
+	};
+
+	/* The 3rd parameter here is:
+	   0 -> source range MPEG (i.e. "video", 16-235)
+	   1 -> source range JPEG (i.e. "full", 0-255)
+	   And the 5th:
+	   0 -> destination range MPEG (i.e. "video", 16-235)
+	   1 -> destination range JPEG (i.e. "full", 0-255)
+
+	   But remember: sws_setColorspaceDetails ignores
+	   these parameters unless the image isYUV or isGray
+	   (if it's neither, it uses video range for source
+	   and destination).
+	*/
+	sws_setColorspaceDetails (
+		context,
+		sws_getCoefficients (lut[yuv_to_rgb]), 0,
+		sws_getCoefficients (lut[yuv_to_rgb]), 0,
+		0, 1 << 16, 1 << 16
+		);
+
+	Entry e;
+	e.in_size = in_size;
+	e.in_format = in_format;
+	e.out_size = out_size;
+	e.out_format = out_format;
+	e.flags = flags;
+	e.yuv_to_rgb = yuv_to_rgb;
+	e.context = context;
+	entries.push_front (e);
+
+	while (entries.size() > contexts_per_thread) {
+		sws_freeContext (entries.back().context);
+		entries.pop_back ();
+	}
+
+	boost::mutex::scoped_lock lm (_counters_mutex);
+	++_misses;
+	return context;
+}
+
+/** @return Number of times that get() has found an existing context, in any thread */
+uint64_t
+SwsContextCache::hits ()
+{
+	boost::mutex::scoped_lock lm (_counters_mutex);
+	return _hits;
+}
+
+/** @return Number of times that get() has had to make a new context, in any thread */
+uint64_t
+SwsContextCache::misses ()
+{
+	boost::mutex::scoped_lock lm (_counters_mutex);
+	return _misses;
+}
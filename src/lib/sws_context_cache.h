@@ -0,0 +1,79 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_SWS_CONTEXT_CACHE_H
+#define DCPOMATIC_SWS_CONTEXT_CACHE_H
+
+/** @file  src/lib/sws_context_cache.h
+ *  @brief SwsContextCache class.
+ */
+
+#include <dcp/types.h>
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdint.h>
+#include <list>
+
+struct SwsContext;
+
+/** @class SwsContextCache
+ *  @brief A cache of swscale contexts, so that the same conversion done on frame
+ *  after frame does not need its filter coefficients to be worked out each time.
+ *
+ *  A SwsContext cannot be used by more than one thread at once, so each thread
+ *  has its own cache of the few contexts that it used most recently.
+ */
+class SwsContextCache : public boost::noncopyable
+{
+public:
+	~SwsContextCache ();
+
+	static SwsContext* get (
+		dcp::Size in_size, AVPixelFormat in_format, dcp::Size out_size, AVPixelFormat out_format, int flags, dcp::YUVToRGB yuv_to_rgb
+		);
+
+	static uint64_t hits ();
+	static uint64_t misses ();
+
+private:
+	struct Entry
+	{
+		dcp::Size in_size;
+		AVPixelFormat in_format;
+		dcp::Size out_size;
+		AVPixelFormat out_format;
+		int flags;
+		dcp::YUVToRGB yuv_to_rgb;
+		SwsContext* context;
+	};
+
+	/** contexts, most recently used first */
+	std::list<Entry> _entries;
+
+	/** mutex for _hits and _misses */
+	static boost::mutex _counters_mutex;
+	static uint64_t _hits;
+	static uint64_t _misses;
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/thread_pool.cc
+ *  @brief ThreadPool class.
+ */
+
+#include "thread_pool.h"
+#include "exception_store.h"
+#include <boost/bind.hpp>
+#include <boost/thread/condition.hpp>
+
+using std::max;
+using std::vector;
+using boost::function;
+
+ThreadPool* ThreadPool::_instance = 0;
+boost::mutex ThreadPool::_instance_mutex;
+
+ThreadPool::ThreadPool ()
+	: _work (new boost::asio::io_service::work (_service))
+	, _threads (max (1, int (boost::thread::hardware_concurrency ())))
+{
+	/* The calling thread does some of the work, so we need one fewer, but we must have at least
+	   one so that jobs get done however many of them there are.
+	*/
+	for (int i = 0; i < max (1, _threads - 1); ++i) {
+		_pool.create_thread (boost::bind (&boost::asio::io_service::run, &_service));
+	}
+}
+
+ThreadPool*
+ThreadPool::instance ()
+{
+	boost::mutex::scoped_lock lm (_instance_mutex);
+	if (!_instance) {
+		_instance = new ThreadPool ();
+	}
+
+	return _instance;
+}
+
+/** State shared between ThreadPool::run() and the jobs that it starts */
+class Jobs : public ExceptionStore
+{
+public:
+	explicit Jobs (int n)
+		: _remaining (n)
+	{}
+
+	void run (function<void ()> job)
+	{
+		try {
+			job ();
+		} catch (...) {
+			store_current ();
+		}
+
+		boost::mutex::scoped_lock lm (_mutex);
+		--_remaining;
+		_condition.notify_all ();
+	}
+
+	void wait ()
+	{
+		boost::mutex::scoped_lock lm (_mutex);
+		while (_remaining > 0) {
+			_condition.wait (lm);
+		}
+	}
+
+private:
+	boost::mutex _mutex;
+	boost::condition _condition;
+	int _remaining;
+};
+
+/** Run some jobs in parallel, one of them in the calling thread, and wait for them all to finish.
+ *  If any of them throws an exception it will be re-thrown here.
+ */
+void
+ThreadPool::run (vector<function<void ()> > jobs)
+{
+	if (jobs.empty ()) {
+		return;
+	}
+
+	Jobs state (jobs.size ());
+
+	for (size_t i = 1; i < jobs.size(); ++i) {
+		_service.post (boost::bind (&Jobs::run, &state, jobs[i]));
+	}
+
+	state.run (jobs[0]);
+	state.wait ();
+	state.rethrow ();
+}
@@ -0,0 +1,65 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_THREAD_POOL_H
+#define DCPOMATIC_THREAD_POOL_H
+
+/** @file  src/lib/thread_pool.h
+ *  @brief ThreadPool class.
+ */
+
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+/** @class ThreadPool
+ *  @brief A set of threads, one for each CPU, which can be used to split up
+ *  work on a single image.
+ *
+ *  Each thread keeps running for the life of the program so that per-thread
+ *  state (such as SwsContextCache) is kept from one job to the next.
+ */
+class ThreadPool : public boost::noncopyable
+{
+public:
+	int threads () const {
+		return _threads;
+	}
+
+	void run (std::vector<boost::function<void ()> > jobs);
+
+	static ThreadPool* instance ();
+
+private:
+	ThreadPool ();
+
+	boost::asio::io_service _service;
+	boost::shared_ptr<boost::asio::io_service::work> _work;
+	boost::thread_group _pool;
+	int _threads;
+
+	static ThreadPool* _instance;
+	static boost::mutex _instance_mutex;
+};
+
+#endif
@@ -32,6 +32,7 @@
 #include "dcpomatic_log.h"
 #include "compose.hpp"
 #include "analytics.h"
+#include <boost/foreach.hpp>
 #include <iostream>
 #include <iomanip>
 
@@ -40,6 +41,7 @@
 using std::string;
 using std::fixed;
 using std::setprecision;
+using std::vector;
 using std::cout;
 using boost::shared_ptr;
 using boost::dynamic_pointer_cast;
@@ -138,7 +140,21 @@ TranscodeJob::status () const
 		}
 	}
 
-	return buffer;
+	string s = buffer;
+
+	vector<string> slow = _encoder->slow_servers ();
+	if (!slow.empty ()) {
+		string hosts;
+		BOOST_FOREACH (string i, slow) {
+			if (!hosts.empty ()) {
+				hosts += ", ";
+			}
+			hosts += i;
+		}
+		s += String::compose (_("; slow servers: %1"), hosts);
+	}
+
+	return s;
 }
 
 /** @return Approximate remaining time in seconds */
@@ -46,7 +46,15 @@ namespace xmlpp {
  *  with servers.  Intended to be bumped when incompatibilities
  *  are introduced.  v2 uses 64+n
  */
-#define SERVER_LINK_VERSION (64+0)
+#define SERVER_LINK_VERSION (64+3)
+/** The oldest server link version that we can still talk to */
+#define SERVER_LINK_VERSION_MINIMUM (64+0)
+/** The first server link version that supports pipelined connections (see EncodeServerConnection) */
+#define SERVER_LINK_VERSION_PIPELINED (64+1)
+/** The first server link version that understands BinaryEncodingRequest */
+#define SERVER_LINK_VERSION_BINARY_REQUEST (64+2)
+/** The first server link version that can accept images compressed by Image::write_compressed_to_socket() */
+#define SERVER_LINK_VERSION_COMPRESSED_IMAGES (64+3)
 
 /** A film of F seconds at f FPS will be Ff frames;
     Consider some delta FPS d, so if we run the same
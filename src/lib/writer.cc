@@ -36,6 +36,7 @@
 #include "util.h"
 #include "reel_writer.h"
 #include "text_content.h"
+#include "spill_file.h"
 #include <dcp/cpl.h>
 #include <dcp/locale_convert.h>
 #include <boost/foreach.hpp>
@@ -46,6 +47,9 @@
 
 #include "i18n.h"
 
+/** Number of frames that a writer thread can give to a SpillFile before it must wait for them to be written to disk */
+#define MAXIMUM_PENDING_SPILL_FRAMES 8
+
 /* OS X strikes again */
 #undef set_key
 
@@ -58,6 +62,7 @@ using std::map;
 using std::min;
 using std::max;
 using std::vector;
+using std::multiset;
 using boost::shared_ptr;
 using boost::weak_ptr;
 using boost::dynamic_pointer_cast;
@@ -67,7 +72,6 @@ using dcp::Data;
 Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 	: _film (film)
 	, _job (j)
-	, _thread (0)
 	, _finish (false)
 	, _queued_full_in_memory (0)
 	/* These will be reset to sensible values when J2KEncoder is created */
@@ -87,6 +91,12 @@ Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 		_reels.push_back (ReelWriter (film, p, job, reel_index++, reels.size(), _film->content_summary(p)));
 	}
 
+	_spill_files.resize (_reels.size ());
+
+	for (size_t i = 0; i < _reels.size(); ++i) {
+		_last_video_frame.push_back (last_video_frame (i));
+	}
+
 	/* We can keep track of the current audio, subtitle and closed caption reels easily because audio
 	   and captions arrive to the Writer in sequence.  This is not so for video.
 	*/
@@ -103,18 +113,24 @@ Writer::Writer (shared_ptr<const Film> film, weak_ptr<Job> j)
 	}
 }
 
+/** Start a thread for each reel, so that the frames for a reel can be written as soon as they
+ *  are in sequence within it without waiting for the previous reels to be finished.
+ */
 void
 Writer::start ()
 {
-	_thread = new boost::thread (boost::bind (&Writer::thread, this));
+	for (size_t i = 0; i < _reels.size(); ++i) {
+		boost::thread* t = new boost::thread (boost::bind (&Writer::thread, this, i));
 #ifdef DCPOMATIC_LINUX
-	pthread_setname_np (_thread->native_handle(), "writer");
+		pthread_setname_np (t->native_handle(), "writer");
 #endif
+		_threads.push_back (t);
+	}
 }
 
 Writer::~Writer ()
 {
-	terminate_thread (false);
+	terminate_threads (false);
 }
 
 /** Pass a video frame to the writer for writing to disk at some point.
@@ -129,8 +145,8 @@ Writer::write (Data encoded, Frame frame, Eyes eyes)
 	boost::mutex::scoped_lock lock (_state_mutex);
 
 	while (_queued_full_in_memory > _maximum_frames_in_memory) {
-		/* There are too many full frames in memory; wake the main writer thread and
-		   wait until it sorts everything out */
+		/* There are too many full frames in memory; wake the writer threads and
+		   wait until they sort everything out */
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
 	}
@@ -144,14 +160,14 @@ Writer::write (Data encoded, Frame frame, Eyes eyes)
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		/* 2D material in a 3D DCP; fake the 3D */
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		++_queued_full_in_memory;
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		++_queued_full_in_memory;
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		++_queued_full_in_memory;
 	}
 
@@ -174,9 +190,9 @@ Writer::repeat (Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
-		/* The queue is too big, and the main writer thread can run and fix it, so
-		   wake it and wait until it has done.
+	while (_queue.size() > _maximum_queue_size && have_sequenced_image()) {
+		/* The queue is too big, and a writer thread can run and fix it, so
+		   wake them and wait until one has done so.
 		*/
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
@@ -188,12 +204,12 @@ Writer::repeat (Frame frame, Eyes eyes)
 	qi.frame = frame - _reels[qi.reel].start ();
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -205,9 +221,9 @@ Writer::fake_write (Frame frame, Eyes eyes)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
 
-	while (_queue.size() > _maximum_queue_size && have_sequenced_image_at_queue_head()) {
-		/* The queue is too big, and the main writer thread can run and fix it, so
-		   wake it and wait until it has done.
+	while (_queue.size() > _maximum_queue_size && have_sequenced_image()) {
+		/* The queue is too big, and a writer thread can run and fix it, so
+		   wake them and wait until one has done so.
 		*/
 		_empty_condition.notify_all ();
 		_full_condition.wait (lock);
@@ -216,12 +232,7 @@ Writer::fake_write (Frame frame, Eyes eyes)
 	size_t const reel = video_reel (frame);
 	Frame const reel_frame = frame - _reels[reel].start ();
 
-	FILE* file = fopen_boost (_film->info_file(_reels[reel].period()), "rb");
-	if (!file) {
-		throw ReadFileError (_film->info_file(_reels[reel].period()));
-	}
-	dcp::FrameInfo info = _reels[reel].read_frame_info (file, reel_frame, eyes);
-	fclose (file);
+	dcp::FrameInfo info = _reels[reel].read_frame_info (reel_frame, eyes);
 
 	QueueItem qi;
 	qi.type = QueueItem::FAKE;
@@ -230,12 +241,12 @@ Writer::fake_write (Frame frame, Eyes eyes)
 	qi.frame = reel_frame;
 	if (_film->three_d() && eyes == EYES_BOTH) {
 		qi.eyes = EYES_LEFT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 		qi.eyes = EYES_RIGHT;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	} else {
 		qi.eyes = eyes;
-		_queue.push_back (qi);
+		_queue.insert (qi);
 	}
 
 	/* Now there's something to do: wake anything wait()ing on _empty_condition */
@@ -302,18 +313,36 @@ Writer::write (shared_ptr<const AudioBuffers> audio, DCPTime const time)
 	}
 }
 
-/** This must be called from Writer::thread() with an appropriate lock held */
+/** @return The first item in the queue for a reel, or _queue.end() if there is none.
+ *  This must be called with a lock held on _state_mutex.
+ */
+multiset<QueueItem>::const_iterator
+Writer::queue_head (size_t reel) const
+{
+	QueueItem first;
+	first.reel = reel;
+	first.frame = 0;
+	first.eyes = EYES_BOTH;
+
+	multiset<QueueItem>::const_iterator i = _queue.lower_bound (first);
+	if (i == _queue.end() || i->reel != reel) {
+		return _queue.end ();
+	}
+
+	return i;
+}
+
+/** This must be called with a lock held on _state_mutex */
 bool
-Writer::have_sequenced_image_at_queue_head ()
+Writer::have_sequenced_image_at_queue_head (size_t reel_index) const
 {
-	if (_queue.empty ()) {
+	multiset<QueueItem>::const_iterator i = queue_head (reel_index);
+	if (i == _queue.end ()) {
 		return false;
 	}
 
-	_queue.sort ();
-
-	QueueItem const & f = _queue.front();
-	ReelWriter const & reel = _reels[f.reel];
+	QueueItem const & f = *i;
+	ReelWriter const & reel = _reels[reel_index];
 
 	/* The queue should contain only EYES_LEFT/EYES_RIGHT pairs or EYES_BOTH */
 
@@ -335,41 +364,94 @@ Writer::have_sequenced_image_at_queue_head ()
 	return false;
 }
 
+/** @return true if any reel has a sequenced image at the head of its part of the queue.
+ *  This must be called with a lock held on _state_mutex.
+ */
+bool
+Writer::have_sequenced_image () const
+{
+	for (size_t i = 0; i < _reels.size(); ++i) {
+		if (have_sequenced_image_at_queue_head (i)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/** @return The FULL item with data in memory which is furthest from being written, or _queue.end()
+ *  if there is none.  This must be called with a lock held on _state_mutex.
+ */
+multiset<QueueItem>::const_iterator
+Writer::furthest_in_memory () const
+{
+	multiset<QueueItem>::const_reverse_iterator r = _queue.rbegin ();
+	while (r != _queue.rend() && (r->type != QueueItem::FULL || !r->encoded)) {
+		++r;
+	}
+
+	if (r == _queue.rend ()) {
+		return _queue.end ();
+	}
+
+	/* r refers to the item before r.base(), so it would move if something were inserted
+	   between the two; return an iterator which refers to the item itself.
+	*/
+	return --r.base ();
+}
+
+/** @return true if there are too many FULL frames in memory and the one that should be pushed to
+ *  disk is for a given reel.  Only a reel's own thread pushes its frames to disk, as it is the only
+ *  thread which takes them out of the queue.  This must be called with a lock held on _state_mutex.
+ */
+bool
+Writer::must_push_to_disk (size_t reel) const
+{
+	if (_queued_full_in_memory <= _maximum_frames_in_memory) {
+		return false;
+	}
+
+	multiset<QueueItem>::const_iterator i = furthest_in_memory ();
+	return i != _queue.end() && i->reel == reel;
+}
+
+/** Thread to write the picture frames for one reel, in order, as they arrive in the queue.
+ *  @param reel_index Index of the reel in _reels.
+ */
 void
-Writer::thread ()
+Writer::thread (size_t reel_index)
 try
 {
+	ReelWriter& reel = _reels[reel_index];
+
 	while (true)
 	{
 		boost::mutex::scoped_lock lock (_state_mutex);
 
 		while (true) {
 
-			if (_finish || _queued_full_in_memory > _maximum_frames_in_memory || have_sequenced_image_at_queue_head ()) {
+			if (_finish || have_sequenced_image_at_queue_head (reel_index) || must_push_to_disk (reel_index)) {
 				/* We've got something to do: go and do it */
 				break;
 			}
 
 			/* Nothing to do: wait until something happens which may indicate that we do */
-			LOG_TIMING (N_("writer-sleep queue=%1"), _queue.size());
+			LOG_TIMING (N_("writer-sleep reel=%1 queue=%2"), reel_index, _queue.size());
 			_empty_condition.wait (lock);
-			LOG_TIMING (N_("writer-wake queue=%1"), _queue.size());
-		}
-
-		if (_finish && _queue.empty()) {
-			return;
+			LOG_TIMING (N_("writer-wake reel=%1 queue=%2"), reel_index, _queue.size());
 		}
 
-		/* We stop here if we have been asked to finish, and if either the queue
-		   is empty or we do not have a sequenced image at its head (if this is the
-		   case we will never terminate as no new frames will be sent once
+		/* We stop here if we have been asked to finish, and if either this reel's part
+		   of the queue is empty or we do not have a sequenced image at its head (if this
+		   is the case we will never terminate as no new frames will be sent once
 		   _finish is true).
 		*/
-		if (_finish && (!have_sequenced_image_at_queue_head() || _queue.empty())) {
+		if (_finish && !have_sequenced_image_at_queue_head (reel_index)) {
 			/* (Hopefully temporarily) log anything that was not written */
-			if (!_queue.empty() && !have_sequenced_image_at_queue_head()) {
-				LOG_WARNING (N_("Finishing writer with a left-over queue of %1:"), _queue.size());
-				for (list<QueueItem>::const_iterator i = _queue.begin(); i != _queue.end(); ++i) {
+			multiset<QueueItem>::const_iterator i = queue_head (reel_index);
+			if (i != _queue.end()) {
+				LOG_WARNING (N_("Finishing writer for reel %1 with a left-over queue:"), reel_index);
+				for (; i != _queue.end() && i->reel == reel_index; ++i) {
 					if (i->type == QueueItem::FULL) {
 						LOG_WARNING (N_("- type FULL, frame %1, eyes %2"), i->frame, (int) i->eyes);
 					} else {
@@ -381,76 +463,91 @@ try
 		}
 
 		/* Write any frames that we can write; i.e. those that are in sequence. */
-		while (have_sequenced_image_at_queue_head ()) {
-			QueueItem qi = _queue.front ();
-			_queue.pop_front ();
+		while (have_sequenced_image_at_queue_head (reel_index)) {
+			multiset<QueueItem>::const_iterator head = queue_head (reel_index);
+			QueueItem qi = *head;
+			_queue.erase (head);
 			if (qi.type == QueueItem::FULL && qi.encoded) {
 				--_queued_full_in_memory;
 			}
 
 			lock.unlock ();
 
-			ReelWriter& reel = _reels[qi.reel];
-
 			switch (qi.type) {
 			case QueueItem::FULL:
-				LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2)"), qi.frame, (int) qi.eyes);
+				LOG_DEBUG_ENCODE (N_("Writer FULL-writes %1 (%2) in reel %3"), qi.frame, (int) qi.eyes, reel_index);
 				if (!qi.encoded) {
-					qi.encoded = Data (_film->j2c_path (qi.reel, qi.frame, qi.eyes, false));
+					qi.encoded = spill_file(reel_index)->get (qi.frame, qi.eyes);
 				}
 				reel.write (qi.encoded, qi.frame, qi.eyes);
-				++_full_written;
 				break;
 			case QueueItem::FAKE:
-				LOG_DEBUG_ENCODE (N_("Writer FAKE-writes %1"), qi.frame);
+				LOG_DEBUG_ENCODE (N_("Writer FAKE-writes %1 in reel %2"), qi.frame, reel_index);
 				reel.fake_write (qi.frame, qi.eyes, qi.size);
-				++_fake_written;
 				break;
 			case QueueItem::REPEAT:
-				LOG_DEBUG_ENCODE (N_("Writer REPEAT-writes %1"), qi.frame);
+				LOG_DEBUG_ENCODE (N_("Writer REPEAT-writes %1 in reel %2"), qi.frame, reel_index);
 				reel.repeat_write (qi.frame, qi.eyes);
-				++_repeat_written;
 				break;
 			}
 
+			if (qi.frame == _last_video_frame[reel_index] && qi.eyes != EYES_LEFT) {
+				/* Finish this reel's picture asset and calculate its digest now, while other
+				   reels are still being written and the asset is probably still in the disk
+				   cache, rather than reading it all back in finish().
+				*/
+				LOG_GENERAL ("Finishing picture asset for reel %1", reel_index);
+				reel.finish_picture ();
+				reel.calculate_picture_digest ();
+			}
+
 			lock.lock ();
+
+			switch (qi.type) {
+			case QueueItem::FULL:
+				++_full_written;
+				break;
+			case QueueItem::FAKE:
+				++_fake_written;
+				break;
+			case QueueItem::REPEAT:
+				++_repeat_written;
+				break;
+			}
+
 			_full_condition.notify_all ();
+			if (_queued_full_in_memory > _maximum_frames_in_memory) {
+				/* The frame that must be pushed to disk may now be for another reel */
+				_empty_condition.notify_all ();
+			}
 		}
 
-		while (_queued_full_in_memory > _maximum_frames_in_memory) {
-			/* Too many frames in memory which can't yet be written to the stream.
-			   Write some FULL frames to disk.
+		while (must_push_to_disk (reel_index)) {
+			/* Too many frames in memory which can't yet be written to the stream,
+			   and the one furthest from being written is ours.  Write it to disk.
 			*/
 
-			/* Find one from the back of the queue */
-			_queue.sort ();
-			list<QueueItem>::reverse_iterator i = _queue.rbegin ();
-			while (i != _queue.rend() && (i->type != QueueItem::FULL || !i->encoded)) {
-				++i;
-			}
-
-			DCPOMATIC_ASSERT (i != _queue.rend());
+			multiset<QueueItem>::const_iterator i = furthest_in_memory ();
 			++_pushed_to_disk;
 			/* For the log message below */
-			int const awaiting = _reels[_queue.front().reel].last_written_video_frame() + 1;
+			int const awaiting = reel.last_written_video_frame() + 1;
 			lock.unlock ();
 
 			/* i is valid here, even though we don't hold a lock on the mutex,
-			   since list iterators are unaffected by insertion and only this
-			   thread could erase the last item in the list.
+			   since set iterators are unaffected by insertion and only this
+			   thread erases this reel's items from the set.
 			*/
 
-			LOG_GENERAL ("Writer full; pushes %1 to disk while awaiting %2", i->frame, awaiting);
+			LOG_GENERAL ("Writer full; pushes %1 in reel %2 to disk while awaiting %3", i->frame, reel_index, awaiting);
 
-			i->encoded->write_via_temp (
-				_film->j2c_path (i->reel, i->frame, i->eyes, true),
-				_film->j2c_path (i->reel, i->frame, i->eyes, false)
-				);
+			spill_file(reel_index)->put (i->frame, i->eyes, *i->encoded);
 
 			lock.lock ();
 			i->encoded.reset ();
 			--_queued_full_in_memory;
 			_full_condition.notify_all ();
+			/* The next frame to push to disk may be for another reel */
+			_empty_condition.notify_all ();
 		}
 	}
 }
@@ -459,11 +556,22 @@ catch (...)
 	store_current ();
 }
 
+/** @return SpillFile for a reel, creating it if necessary; must only be called from the reel's thread */
+shared_ptr<SpillFile>
+Writer::spill_file (size_t reel)
+{
+	if (!_spill_files[reel]) {
+		_spill_files[reel].reset (new SpillFile (_film->spill_file (reel), MAXIMUM_PENDING_SPILL_FRAMES));
+	}
+
+	return _spill_files[reel];
+}
+
 void
-Writer::terminate_thread (bool can_throw)
+Writer::terminate_threads (bool can_throw)
 {
 	boost::mutex::scoped_lock lock (_state_mutex);
-	if (_thread == 0) {
+	if (_threads.empty ()) {
 		return;
 	}
 
@@ -472,28 +580,32 @@ Writer::terminate_thread (bool can_throw)
 	_full_condition.notify_all ();
 	lock.unlock ();
 
-	if (_thread->joinable ()) {
-		_thread->join ();
+	BOOST_FOREACH (boost::thread* i, _threads) {
+		if (i->joinable ()) {
+			i->join ();
+		}
 	}
 
 	if (can_throw) {
 		rethrow ();
 	}
 
-	delete _thread;
-	_thread = 0;
+	BOOST_FOREACH (boost::thread* i, _threads) {
+		delete i;
+	}
+	_threads.clear ();
 }
 
 void
 Writer::finish ()
 {
-	if (!_thread) {
+	if (_threads.empty ()) {
 		return;
 	}
 
-	LOG_GENERAL_NC ("Terminating writer thread");
+	LOG_GENERAL_NC ("Terminating writer threads");
 
-	terminate_thread (true);
+	terminate_threads (true);
 
 	LOG_GENERAL_NC ("Finishing ReelWriters");
 
@@ -764,6 +876,27 @@ Writer::video_reel (int frame) const
 	return i;
 }
 
+/** @return Index within a reel of the last video frame that video_reel() will put into it,
+ *  or -1 if it will put none there.
+ */
+Frame
+Writer::last_video_frame (size_t reel) const
+{
+	int const rate = _film->video_frame_rate ();
+	DCPTimePeriod const period = _reels[reel].period ();
+
+	Frame f = period.to.frames_ceil (rate);
+	while (f >= 0 && DCPTime::from_frames (f, rate) >= period.to) {
+		--f;
+	}
+
+	if (f < 0 || !period.contains (DCPTime::from_frames (f, rate))) {
+		return -1;
+	}
+
+	return f - _reels[reel].start ();
+}
+
 void
 Writer::set_digest_progress (Job* job, float progress)
 {
@@ -31,6 +31,7 @@
 #include <boost/thread.hpp>
 #include <boost/thread/condition.hpp>
 #include <list>
+#include <set>
 
 namespace dcp {
 	class Data;
@@ -42,6 +43,7 @@ class Job;
 class Font;
 class ReferencedReelAsset;
 class ReelWriter;
+class SpillFile;
 
 struct QueueItem
 {
@@ -64,8 +66,10 @@ public:
 		REPEAT,
 	} type;
 
-	/** encoded data for FULL */
-	boost::optional<dcp::Data> encoded;
+	/** encoded data for FULL; mutable as it is not used for ordering, and it is
+	 *  reset when the data is pushed to disk while the item is in Writer's queue.
+	 */
+	mutable boost::optional<dcp::Data> encoded;
 	/** size of data for FAKE */
 	int size;
 	/** reel index */
@@ -113,27 +117,39 @@ public:
 	void set_encoder_threads (int threads);
 
 private:
-	void thread ();
-	void terminate_thread (bool);
-	bool have_sequenced_image_at_queue_head ();
+	void thread (size_t reel);
+	void terminate_threads (bool);
+	std::multiset<QueueItem>::const_iterator queue_head (size_t reel) const;
+	bool have_sequenced_image_at_queue_head (size_t reel) const;
+	bool have_sequenced_image () const;
+	std::multiset<QueueItem>::const_iterator furthest_in_memory () const;
+	bool must_push_to_disk (size_t reel) const;
 	size_t video_reel (int frame) const;
+	Frame last_video_frame (size_t reel) const;
 	void set_digest_progress (Job* job, float progress);
 	void write_cover_sheet ();
+	boost::shared_ptr<SpillFile> spill_file (size_t reel);
 
 	/** our Film */
 	boost::shared_ptr<const Film> _film;
 	boost::weak_ptr<Job> _job;
 	std::vector<ReelWriter> _reels;
+	/** index within each reel of its last video frame, from last_video_frame(); when this frame
+	 *  has been written the reel's picture asset can be finished.
+	 */
+	std::vector<Frame> _last_video_frame;
 	std::vector<ReelWriter>::iterator _audio_reel;
 	std::vector<ReelWriter>::iterator _subtitle_reel;
 	std::map<DCPTextTrack, std::vector<ReelWriter>::iterator> _caption_reels;
 
-	/** our thread, or 0 */
-	boost::thread* _thread;
-	/** true if our thread should finish */
+	/** our threads, one for each reel, or empty if we have not been started */
+	std::vector<boost::thread*> _threads;
+	/** true if our threads should finish */
 	bool _finish;
-	/** queue of things to write to disk */
-	std::list<QueueItem> _queue;
+	/** queue of things to write to disk, kept in the order that they must be written;
+	 *  the items for each reel are contiguous and are written by that reel's thread.
+	 */
+	std::multiset<QueueItem> _queue;
 	/** number of FULL frames whose JPEG200 data is currently held in RAM */
 	int _queued_full_in_memory;
 	/** mutex for thread state */
@@ -157,6 +173,8 @@ private:
 	    due to the limit of frames to be held in memory.
 	*/
 	int _pushed_to_disk;
+	/** files to push frames for each reel to, created when they are first needed; each is only used by its reel's thread */
+	std::vector<boost::shared_ptr<SpillFile> > _spill_files;
 
 	boost::mutex _digest_progresses_mutex;
 	std::map<boost::thread::id, float> _digest_progresses;
@@ -0,0 +1,309 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  src/lib/xyz_converter.cc
+ *  @brief XYZConverter class.
+ */
+
+#include "xyz_converter.h"
+#include "colour_conversion.h"
+#include "dcpomatic_assert.h"
+#include "compose.hpp"
+#include <dcp/openjpeg_image.h>
+#include <dcp/transfer_function.h>
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+#include <cmath>
+
+#ifdef DCPOMATIC_X86
+#include <immintrin.h>
+#endif
+
+using std::map;
+using std::max;
+using std::min;
+using std::string;
+using boost::shared_ptr;
+
+/** Scale factor to go from the 48cd/m^2 of DCI white to the 52.37cd/m^2 of XYZ 1.0 */
+#define DCI_COEFFICIENT (48.0 / 52.37)
+
+static boost::mutex converters_mutex;
+/** converters that we have made, keyed by ColourConversion::identifier() */
+static map<string, shared_ptr<const XYZConverter> > converters;
+
+XYZConverter::XYZConverter (ColourConversion const & conversion)
+	: _in (new double[4096])
+	, _out (new int32_t[65536])
+{
+	double const * in = conversion.in()->lut (12, false);
+	std::copy (in, in + 4096, _in.get());
+
+	double const * out = conversion.out()->lut (16, true);
+	for (int i = 0; i < 65536; ++i) {
+		_out[i] = lrint (out[i] * 4095);
+	}
+
+	boost::numeric::ublas::matrix<double> const rgb_to_xyz = conversion.rgb_to_xyz ();
+	boost::numeric::ublas::matrix<double> const bradford = conversion.bradford ();
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			_matrix[i * 3 + j] = (
+				bradford (i, 0) * rgb_to_xyz (0, j) +
+				bradford (i, 1) * rgb_to_xyz (1, j) +
+				bradford (i, 2) * rgb_to_xyz (2, j)
+				) * DCI_COEFFICIENT * 65535;
+		}
+	}
+}
+
+/** @return A converter for a ColourConversion, which will be made only once for each different conversion */
+shared_ptr<const XYZConverter>
+XYZConverter::get (ColourConversion const & conversion)
+{
+	string const id = conversion.identifier ();
+
+	boost::mutex::scoped_lock lm (converters_mutex);
+	map<string, shared_ptr<const XYZConverter> >::const_iterator i = converters.find (id);
+	if (i != converters.end()) {
+		return i->second;
+	}
+
+	shared_ptr<const XYZConverter> c (new XYZConverter (conversion));
+	converters[id] = c;
+	return c;
+}
+
+/** @return The fastest kernel that this CPU can use */
+XYZConverter::Kernel
+XYZConverter::best_kernel ()
+{
+	return SIMDKernels::best_kernel (KERNEL_AVX2);
+}
+
+/** Convert an RGB48LE image to XYZ.
+ *  @param rgb RGB data.
+ *  @param size Size of the image in pixels.
+ *  @param stride Stride of the RGB data in bytes.
+ *  @param note Handler to tell about any clamped values.
+ *  @param kernel Kernel to use, which must be supported().
+ */
+shared_ptr<dcp::OpenJPEGImage>
+XYZConverter::convert (uint8_t const * rgb, dcp::Size size, int stride, dcp::NoteHandler note, Kernel kernel) const
+{
+	DCPOMATIC_ASSERT (supported (kernel));
+
+	shared_ptr<dcp::OpenJPEGImage> xyz (new dcp::OpenJPEGImage (size));
+
+	int* x = xyz->data (0);
+	int* y = xyz->data (1);
+	int* z = xyz->data (2);
+	int clamped = 0;
+
+	for (int i = 0; i < size.height; ++i) {
+		uint16_t const * p = reinterpret_cast<uint16_t const *> (rgb + i * stride);
+		switch (kernel) {
+		case KERNEL_SCALAR:
+			clamped += row_scalar (p, size.width, x, y, z);
+			break;
+		case KERNEL_SSE2:
+			clamped += row_sse2 (p, size.width, x, y, z);
+			break;
+		case KERNEL_AVX2:
+			clamped += row_avx2 (p, size.width, x, y, z);
+			break;
+		}
+		x += size.width;
+		y += size.width;
+		z += size.width;
+	}
+
+	if (clamped && note) {
+		note (dcp::DCP_NOTE, String::compose ("%1 XYZ value(s) clamped", clamped));
+	}
+
+	return xyz;
+}
+
+/** Convert some pixels.
+ *  @param p RGB48LE data.
+ *  @param width Number of pixels.
+ *  @param x, y, z Output.
+ *  @return Number of pixels which had to be clamped.
+ */
+int
+XYZConverter::row_scalar (uint16_t const * p, int width, int* x, int* y, int* z) const
+{
+	int clamped = 0;
+
+	for (int i = 0; i < width; ++i) {
+		/* In gamma LUT (converting 16-bit to 12-bit) */
+		double const r = _in[*p++ >> 4];
+		double const g = _in[*p++ >> 4];
+		double const b = _in[*p++ >> 4];
+
+		/* RGB to XYZ, Bradford transform and DCI companding */
+		double dx = r * _matrix[0] + g * _matrix[1] + b * _matrix[2];
+		double dy = r * _matrix[3] + g * _matrix[4] + b * _matrix[5];
+		double dz = r * _matrix[6] + g * _matrix[7] + b * _matrix[8];
+
+		if (dx < 0 || dy < 0 || dz < 0 || dx > 65535 || dy > 65535 || dz > 65535) {
+			++clamped;
+		}
+
+		dx = min (65535.0, max (0.0, dx));
+		dy = min (65535.0, max (0.0, dy));
+		dz = min (65535.0, max (0.0, dz));
+
+		/* Out gamma LUT */
+		*x++ = _out[lrint (dx)];
+		*y++ = _out[lrint (dy)];
+		*z++ = _out[lrint (dz)];
+	}
+
+	return clamped;
+}
+
+/* The SIMD versions below do the same sums in the same order as row_scalar() and convert to integer
+   using the current rounding mode, as lrint() does (see SIMDKernels).
+*/
+
+#ifdef DCPOMATIC_X86
+
+__attribute__((target("sse2")))
+int
+XYZConverter::row_sse2 (uint16_t const * p, int width, int* x, int* y, int* z) const
+{
+	__m128d const m0 = _mm_set1_pd (_matrix[0]);
+	__m128d const m1 = _mm_set1_pd (_matrix[1]);
+	__m128d const m2 = _mm_set1_pd (_matrix[2]);
+	__m128d const m3 = _mm_set1_pd (_matrix[3]);
+	__m128d const m4 = _mm_set1_pd (_matrix[4]);
+	__m128d const m5 = _mm_set1_pd (_matrix[5]);
+	__m128d const m6 = _mm_set1_pd (_matrix[6]);
+	__m128d const m7 = _mm_set1_pd (_matrix[7]);
+	__m128d const m8 = _mm_set1_pd (_matrix[8]);
+	__m128d const zero = _mm_setzero_pd ();
+	__m128d const top = _mm_set1_pd (65535);
+
+	int clamped = 0;
+	int i = 0;
+
+	for (; i + 2 <= width; i += 2) {
+		__m128d const r = _mm_setr_pd (_in[p[0] >> 4], _in[p[3] >> 4]);
+		__m128d const g = _mm_setr_pd (_in[p[1] >> 4], _in[p[4] >> 4]);
+		__m128d const b = _mm_setr_pd (_in[p[2] >> 4], _in[p[5] >> 4]);
+		p += 6;
+
+		__m128d dx = _mm_add_pd (_mm_add_pd (_mm_mul_pd (r, m0), _mm_mul_pd (g, m1)), _mm_mul_pd (b, m2));
+		__m128d dy = _mm_add_pd (_mm_add_pd (_mm_mul_pd (r, m3), _mm_mul_pd (g, m4)), _mm_mul_pd (b, m5));
+		__m128d dz = _mm_add_pd (_mm_add_pd (_mm_mul_pd (r, m6), _mm_mul_pd (g, m7)), _mm_mul_pd (b, m8));
+
+		__m128d const low = _mm_or_pd (_mm_or_pd (_mm_cmplt_pd (dx, zero), _mm_cmplt_pd (dy, zero)), _mm_cmplt_pd (dz, zero));
+		__m128d const high = _mm_or_pd (_mm_or_pd (_mm_cmpgt_pd (dx, top), _mm_cmpgt_pd (dy, top)), _mm_cmpgt_pd (dz, top));
+		clamped += __builtin_popcount (_mm_movemask_pd (_mm_or_pd (low, high)));
+
+		__m128i const ix = _mm_cvtpd_epi32 (_mm_min_pd (_mm_max_pd (dx, zero), top));
+		__m128i const iy = _mm_cvtpd_epi32 (_mm_min_pd (_mm_max_pd (dy, zero), top));
+		__m128i const iz = _mm_cvtpd_epi32 (_mm_min_pd (_mm_max_pd (dz, zero), top));
+
+		*x++ = _out[_mm_cvtsi128_si32 (ix)];
+		*x++ = _out[_mm_cvtsi128_si32 (_mm_srli_si128 (ix, 4))];
+		*y++ = _out[_mm_cvtsi128_si32 (iy)];
+		*y++ = _out[_mm_cvtsi128_si32 (_mm_srli_si128 (iy, 4))];
+		*z++ = _out[_mm_cvtsi128_si32 (iz)];
+		*z++ = _out[_mm_cvtsi128_si32 (_mm_srli_si128 (iz, 4))];
+	}
+
+	return clamped + row_scalar (p, width - i, x, y, z);
+}
+
+__attribute__((target("avx2")))
+int
+XYZConverter::row_avx2 (uint16_t const * p, int width, int* x, int* y, int* z) const
+{
+	__m256d const m0 = _mm256_set1_pd (_matrix[0]);
+	__m256d const m1 = _mm256_set1_pd (_matrix[1]);
+	__m256d const m2 = _mm256_set1_pd (_matrix[2]);
+	__m256d const m3 = _mm256_set1_pd (_matrix[3]);
+	__m256d const m4 = _mm256_set1_pd (_matrix[4]);
+	__m256d const m5 = _mm256_set1_pd (_matrix[5]);
+	__m256d const m6 = _mm256_set1_pd (_matrix[6]);
+	__m256d const m7 = _mm256_set1_pd (_matrix[7]);
+	__m256d const m8 = _mm256_set1_pd (_matrix[8]);
+	__m256d const zero = _mm256_setzero_pd ();
+	__m256d const top = _mm256_set1_pd (65535);
+
+	int clamped = 0;
+	int i = 0;
+
+	for (; i + 4 <= width; i += 4) {
+		__m256d const r = _mm256_i32gather_pd (_in.get(), _mm_setr_epi32 (p[0] >> 4, p[3] >> 4, p[6] >> 4, p[9] >> 4), 8);
+		__m256d const g = _mm256_i32gather_pd (_in.get(), _mm_setr_epi32 (p[1] >> 4, p[4] >> 4, p[7] >> 4, p[10] >> 4), 8);
+		__m256d const b = _mm256_i32gather_pd (_in.get(), _mm_setr_epi32 (p[2] >> 4, p[5] >> 4, p[8] >> 4, p[11] >> 4), 8);
+		p += 12;
+
+		__m256d dx = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (r, m0), _mm256_mul_pd (g, m1)), _mm256_mul_pd (b, m2));
+		__m256d dy = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (r, m3), _mm256_mul_pd (g, m4)), _mm256_mul_pd (b, m5));
+		__m256d dz = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (r, m6), _mm256_mul_pd (g, m7)), _mm256_mul_pd (b, m8));
+
+		__m256d const low = _mm256_or_pd (
+			_mm256_or_pd (_mm256_cmp_pd (dx, zero, _CMP_LT_OQ), _mm256_cmp_pd (dy, zero, _CMP_LT_OQ)),
+			_mm256_cmp_pd (dz, zero, _CMP_LT_OQ)
+			);
+		__m256d const high = _mm256_or_pd (
+			_mm256_or_pd (_mm256_cmp_pd (dx, top, _CMP_GT_OQ), _mm256_cmp_pd (dy, top, _CMP_GT_OQ)),
+			_mm256_cmp_pd (dz, top, _CMP_GT_OQ)
+			);
+		clamped += __builtin_popcount (_mm256_movemask_pd (_mm256_or_pd (low, high)));
+
+		__m128i const ix = _mm256_cvtpd_epi32 (_mm256_min_pd (_mm256_max_pd (dx, zero), top));
+		__m128i const iy = _mm256_cvtpd_epi32 (_mm256_min_pd (_mm256_max_pd (dy, zero), top));
+		__m128i const iz = _mm256_cvtpd_epi32 (_mm256_min_pd (_mm256_max_pd (dz, zero), top));
+
+		_mm_storeu_si128 (reinterpret_cast<__m128i*> (x), _mm_i32gather_epi32 (_out.get(), ix, 4));
+		_mm_storeu_si128 (reinterpret_cast<__m128i*> (y), _mm_i32gather_epi32 (_out.get(), iy, 4));
+		_mm_storeu_si128 (reinterpret_cast<__m128i*> (z), _mm_i32gather_epi32 (_out.get(), iz, 4));
+		x += 4;
+		y += 4;
+		z += 4;
+	}
+
+	return clamped + row_scalar (p, width - i, x, y, z);
+}
+
+#else
+
+int
+XYZConverter::row_sse2 (uint16_t const * p, int width, int* x, int* y, int* z) const
+{
+	return row_scalar (p, width, x, y, z);
+}
+
+int
+XYZConverter::row_avx2 (uint16_t const * p, int width, int* x, int* y, int* z) const
+{
+	return row_scalar (p, width, x, y, z);
+}
+
+#endif
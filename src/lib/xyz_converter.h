@@ -0,0 +1,73 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef DCPOMATIC_XYZ_CONVERTER_H
+#define DCPOMATIC_XYZ_CONVERTER_H
+
+/** @file  src/lib/xyz_converter.h
+ *  @brief XYZConverter class.
+ */
+
+#include "simd_kernels.h"
+#include <dcp/types.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+
+namespace dcp {
+	class OpenJPEGImage;
+}
+
+class ColourConversion;
+
+/** @class XYZConverter
+ *  @brief Conversion of RGB48LE images to 12-bit XYZ, giving the same results as dcp::rgb_to_xyz.
+ *
+ *  The input and output transfer function tables and the combined RGB to XYZ, Bradford and
+ *  DCI companding matrix are worked out once for each ColourConversion, and rows are then
+ *  processed using AVX2 or SSE2 where the CPU has them.
+ */
+class XYZConverter : public SIMDKernels, public boost::noncopyable
+{
+public:
+	explicit XYZConverter (ColourConversion const & conversion);
+
+	boost::shared_ptr<dcp::OpenJPEGImage> convert (
+		uint8_t const * rgb, dcp::Size size, int stride, dcp::NoteHandler note, Kernel kernel = best_kernel()
+		) const;
+
+	static boost::shared_ptr<const XYZConverter> get (ColourConversion const & conversion);
+	static Kernel best_kernel ();
+
+private:
+	int row_scalar (uint16_t const * p, int width, int* x, int* y, int* z) const;
+	int row_sse2 (uint16_t const * p, int width, int* x, int* y, int* z) const;
+	int row_avx2 (uint16_t const * p, int width, int* x, int* y, int* z) const;
+
+	/** input transfer function, indexed by 12-bit value */
+	boost::shared_array<double> _in;
+	/** output transfer function scaled to 12 bits, indexed by 16-bit value */
+	boost::shared_array<int32_t> _out;
+	/** product of the RGB to XYZ matrix, the Bradford transform and DCI companding (scaled to 16 bits) */
+	double _matrix[9];
+};
+
+#endif
@@ -603,12 +603,17 @@ private:
 
 		_panel->GetSizer()->Add (_servers_list, 1, wxEXPAND | wxALL, _border);
 
+		_compress_frames = new CheckBox (_panel, _("Compress frames before sending them to servers"));
+		_panel->GetSizer()->Add (_compress_frames, 0, wxALL, _border);
+
 		_use_any_servers->Bind (wxEVT_CHECKBOX, boost::bind (&EncodingServersPage::use_any_servers_changed, this));
+		_compress_frames->Bind (wxEVT_CHECKBOX, boost::bind (&EncodingServersPage::compress_frames_changed, this));
 	}
 
 	void config_changed ()
 	{
 		checked_set (_use_any_servers, Config::instance()->use_any_servers ());
+		checked_set (_compress_frames, Config::instance()->compress_frames_for_servers ());
 		_servers_list->refresh ();
 	}
 
@@ -617,6 +622,11 @@ private:
 		Config::instance()->set_use_any_servers (_use_any_servers->GetValue ());
 	}
 
+	void compress_frames_changed ()
+	{
+		Config::instance()->set_compress_frames_for_servers (_compress_frames->GetValue ());
+	}
+
 	string server_column (string s)
 	{
 		return s;
@@ -624,6 +634,7 @@ private:
 
 	wxCheckBox* _use_any_servers;
 	EditableList<string, ServerDialog>* _servers_list;
+	wxCheckBox* _compress_frames;
 };
 
 class TMSPage : public StandardPage
@@ -1431,6 +1442,24 @@ private:
 			table->Add (s, 1);
 		}
 
+		{
+			add_label_to_sizer (table, _panel, _("Maximum size of encoded frame cache"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_j2k_cache_size = new wxSpinCtrl (_panel);
+			s->Add (_j2k_cache_size, 1);
+			add_label_to_sizer (s, _panel, _("GB (0 for no cache)"), false);
+			table->Add (s, 1);
+		}
+
+		{
+			add_label_to_sizer (table, _panel, _("Memory to keep for re-use by new images"), true);
+			wxBoxSizer* s = new wxBoxSizer (wxHORIZONTAL);
+			_image_buffer_pool_size = new wxSpinCtrl (_panel);
+			s->Add (_image_buffer_pool_size, 1);
+			add_label_to_sizer (s, _panel, _("MB"), false);
+			table->Add (s, 1);
+		}
+
 		{
 			add_top_aligned_label_to_sizer (table, _panel, _("DCP metadata filename format"));
 			dcp::NameFormat::Map titles;
@@ -1494,6 +1523,10 @@ private:
 		_allow_any_container->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::allow_any_container_changed, this));
 		_only_servers_encode->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::only_servers_encode_changed, this));
 		_frames_in_memory_multiplier->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::frames_in_memory_multiplier_changed, this));
+		_j2k_cache_size->SetRange (0, 100000);
+		_j2k_cache_size->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::j2k_cache_size_changed, this));
+		_image_buffer_pool_size->SetRange (0, 65536);
+		_image_buffer_pool_size->Bind (wxEVT_SPINCTRL, boost::bind(&AdvancedPage::image_buffer_pool_size_changed, this));
 		_dcp_metadata_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_metadata_filename_format_changed, this));
 		_dcp_asset_filename_format->Changed.connect (boost::bind (&AdvancedPage::dcp_asset_filename_format_changed, this));
 		_log_general->Bind (wxEVT_CHECKBOX, boost::bind (&AdvancedPage::log_changed, this));
@@ -1524,6 +1557,8 @@ private:
 		checked_set (_log_debug_encode, config->log_types() & LogEntry::TYPE_DEBUG_ENCODE);
 		checked_set (_log_debug_email, config->log_types() & LogEntry::TYPE_DEBUG_EMAIL);
 		checked_set (_frames_in_memory_multiplier, config->frames_in_memory_multiplier());
+		checked_set (_j2k_cache_size, config->j2k_cache_size());
+		checked_set (_image_buffer_pool_size, config->image_buffer_pool_size());
 #ifdef DCPOMATIC_WINDOWS
 		checked_set (_win32_console, config->win32_console());
 #endif
@@ -1539,6 +1574,16 @@ private:
 		Config::instance()->set_frames_in_memory_multiplier (_frames_in_memory_multiplier->GetValue());
 	}
 
+	void j2k_cache_size_changed ()
+	{
+		Config::instance()->set_j2k_cache_size (_j2k_cache_size->GetValue());
+	}
+
+	void image_buffer_pool_size_changed ()
+	{
+		Config::instance()->set_image_buffer_pool_size (_image_buffer_pool_size->GetValue());
+	}
+
 	void allow_any_dcp_frame_rate_changed ()
 	{
 		Config::instance()->set_allow_any_dcp_frame_rate (_allow_any_dcp_frame_rate->GetValue ());
@@ -1600,6 +1645,8 @@ private:
 
 	wxSpinCtrl* _maximum_j2k_bandwidth;
 	wxSpinCtrl* _frames_in_memory_multiplier;
+	wxSpinCtrl* _j2k_cache_size;
+	wxSpinCtrl* _image_buffer_pool_size;
 	wxCheckBox* _allow_any_dcp_frame_rate;
 	wxCheckBox* _allow_any_container;
 	wxCheckBox* _only_servers_encode;
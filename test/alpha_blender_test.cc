@@ -0,0 +1,140 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/alpha_blender_test.cc
+ *  @brief Test AlphaBlender and its use by Image::alpha_blend.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/alpha_blender.h"
+#include "lib/image.h"
+#include "lib/timer.h"
+#include "lib/compose.hpp"
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+
+using boost::shared_ptr;
+
+static void
+fill_random (shared_ptr<Image> image)
+{
+	for (int i = 0; i < image->planes(); ++i) {
+		for (int y = 0; y < image->sample_size(i).height; ++y) {
+			uint8_t* p = image->data()[i] + y * image->stride()[i];
+			for (int x = 0; x < image->line_size()[i]; ++x) {
+				*p++ = rand ();
+			}
+		}
+	}
+}
+
+/** Make an overlay which looks a bit like a subtitle: transparent, apart from a band of
+ *  mostly-opaque pixels with some partially transparent ones at the edges of the "glyphs".
+ */
+static shared_ptr<Image>
+subtitle (AVPixelFormat format, dcp::Size size)
+{
+	shared_ptr<Image> image (new Image (format, size, true));
+	fill_random (image);
+	for (int y = 0; y < size.height; ++y) {
+		uint8_t* p = image->data()[0] + y * image->stride()[0];
+		for (int x = 0; x < size.width; ++x) {
+			if (y < size.height * 3 / 4 || x < size.width / 4 || x > size.width * 3 / 4) {
+				p[x * 4 + 3] = 0;
+			} else if (x % 11 == 0) {
+				p[x * 4 + 3] = rand ();
+			} else {
+				p[x * 4 + 3] = 255;
+			}
+		}
+	}
+	return image;
+}
+
+/** Check that every kernel gives the same results as the scalar one for every format that can be
+ *  blended onto, using sizes and positions which test the ends of rows and clipping.
+ */
+BOOST_AUTO_TEST_CASE (alpha_blender_test)
+{
+	AVPixelFormat const formats[] = {
+		AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA, AV_PIX_FMT_RGBA, AV_PIX_FMT_RGB48LE,
+		AV_PIX_FMT_XYZ12LE, AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P10, AV_PIX_FMT_YUV422P10LE
+	};
+
+	AVPixelFormat const overlay_formats[] = { AV_PIX_FMT_BGRA, AV_PIX_FMT_RGBA };
+	AlphaBlender::Kernel const kernels[] = { AlphaBlender::KERNEL_SSE2 };
+	Position<int> const positions[] = { Position<int> (0, 0), Position<int> (17, 9), Position<int> (-13, -5), Position<int> (200, 60) };
+
+	srand (1);
+
+	for (size_t i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i) {
+		shared_ptr<Image> base (new Image (formats[i], dcp::Size (242, 100), true));
+		fill_random (base);
+		for (size_t j = 0; j < sizeof (overlay_formats) / sizeof (overlay_formats[0]); ++j) {
+			shared_ptr<Image> overlay = subtitle (overlay_formats[j], dcp::Size (123, 40));
+			for (size_t k = 0; k < sizeof (kernels) / sizeof (kernels[0]); ++k) {
+				if (!AlphaBlender::supported (kernels[k])) {
+					continue;
+				}
+				for (size_t l = 0; l < sizeof (positions) / sizeof (positions[0]); ++l) {
+					shared_ptr<Image> a (new Image (*base.get()));
+					a->alpha_blend (overlay, positions[l], AlphaBlender::KERNEL_SCALAR);
+					shared_ptr<Image> b (new Image (*base.get()));
+					b->alpha_blend (overlay, positions[l], kernels[k]);
+					BOOST_CHECK_MESSAGE (*a.get() == *b.get(), "format " << formats[i] << " overlay " << overlay_formats[j] << " position " << l);
+				}
+			}
+		}
+	}
+}
+
+/** Compare the speed of the scalar blend with the best one on this CPU when burning a
+ *  subtitle into a 2K frame in the formats used for DCPs and the preview.
+ */
+BOOST_AUTO_TEST_CASE (alpha_blender_benchmark)
+{
+	AVPixelFormat const formats[] = { AV_PIX_FMT_RGB48LE, AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA };
+	dcp::Size const size (1998, 1080);
+	shared_ptr<Image> overlay = subtitle (AV_PIX_FMT_BGRA, size);
+	int const frames = 24;
+
+	for (size_t i = 0; i < sizeof (formats) / sizeof (formats[0]); ++i) {
+		shared_ptr<Image> base (new Image (formats[i], size, true));
+		fill_random (base);
+		shared_ptr<Image> scalar (new Image (*base.get()));
+		shared_ptr<Image> best (new Image (*base.get()));
+
+		{
+			PeriodTimer timer (String::compose ("alpha_blend of %1 frames onto format %2, scalar", frames, formats[i]));
+			for (int j = 0; j < frames; ++j) {
+				scalar->alpha_blend (overlay, Position<int> (0, 0), AlphaBlender::KERNEL_SCALAR);
+			}
+		}
+
+		{
+			PeriodTimer timer (String::compose ("alpha_blend of %1 frames onto format %2, best kernel", frames, formats[i]));
+			for (int j = 0; j < frames; ++j) {
+				best->alpha_blend (overlay, Position<int> (0, 0));
+			}
+		}
+
+		BOOST_CHECK (*scalar.get() == *best.get());
+	}
+}
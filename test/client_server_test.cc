@@ -35,12 +35,15 @@
 #include "lib/raw_image_proxy.h"
 #include "lib/j2k_image_proxy.h"
 #include "lib/encode_server_description.h"
+#include "lib/encode_server_connection.h"
 #include "lib/file_log.h"
 #include "lib/dcpomatic_log.h"
 #include <boost/test/unit_test.hpp>
 #include <boost/thread.hpp>
 
 using std::list;
+using std::map;
+using std::vector;
 using boost::shared_ptr;
 using boost::thread;
 using boost::optional;
@@ -324,3 +327,128 @@ BOOST_AUTO_TEST_CASE (client_server_test_j2k)
 	delete server_thread;
 	delete server;
 }
+
+static void
+pipelined_frame_done (shared_ptr<DCPVideo> frame, Data encoded, map<int, Data>* results)
+{
+	(*results)[frame->index()] = encoded;
+}
+
+/** Send batches of frames down one pipelined connection and check that they all come back correctly */
+BOOST_AUTO_TEST_CASE (client_server_test_pipelined)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), true));
+	uint8_t* p = image->data()[0];
+
+	for (int y = 0; y < 1080; ++y) {
+		uint8_t* q = p;
+		for (int x = 0; x < 1998; ++x) {
+			*q++ = x % 256;
+			*q++ = y % 256;
+			*q++ = (x + y) % 256;
+		}
+		p += image->stride()[0];
+	}
+
+	dcpomatic_log.reset (new FileLog("build/test/client_server_test_pipelined.log"));
+
+	shared_ptr<PlayerVideo> pvf (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (1998, 1080),
+			dcp::Size (1998, 1080),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion(),
+			weak_ptr<Content>(),
+			optional<Frame>()
+			)
+		);
+
+	vector<shared_ptr<DCPVideo> > frames;
+	for (int i = 0; i < 6; ++i) {
+		frames.push_back (shared_ptr<DCPVideo> (new DCPVideo (pvf, i, 24, 200000000, RESOLUTION_2K)));
+	}
+
+	Data locally_encoded = frames.front()->encode_locally ();
+
+	EncodeServer* server = new EncodeServer (true, 2);
+
+	thread* server_thread = new thread (boost::bind (&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep (1);
+
+	EncodeServerDescription description ("127.0.0.1", 2, SERVER_LINK_VERSION);
+	BOOST_REQUIRE (description.pipelined ());
+
+	{
+		EncodeServerConnection connection (description, 1200);
+
+		/* Two batches down the same connection */
+		for (int i = 0; i < 2; ++i) {
+			map<int, Data> results;
+			BOOST_REQUIRE_NO_THROW (connection.encode (frames, boost::bind (&pipelined_frame_done, _1, _2, &results)));
+			BOOST_CHECK_EQUAL (connection.link_version(), SERVER_LINK_VERSION);
+			BOOST_REQUIRE_EQUAL (results.size(), frames.size());
+			for (map<int, Data>::const_iterator j = results.begin(); j != results.end(); ++j) {
+				BOOST_REQUIRE_EQUAL (j->second.size(), locally_encoded.size());
+				BOOST_CHECK_EQUAL (memcmp (j->second.data().get(), locally_encoded.data().get(), locally_encoded.size()), 0);
+			}
+		}
+
+		/* Closing the connection here lets the server's thread for it finish */
+	}
+
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+}
+
+/** Destroying an EncodeServer should not wait for its pipelined connections' sockets to time out */
+BOOST_AUTO_TEST_CASE (client_server_test_pipelined_stop)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (1998, 1080), true));
+	image->make_black ();
+
+	shared_ptr<PlayerVideo> pvf (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (1998, 1080),
+			dcp::Size (1998, 1080),
+			EYES_BOTH,
+			PART_WHOLE,
+			ColourConversion(),
+			weak_ptr<Content>(),
+			optional<Frame>()
+			)
+		);
+
+	vector<shared_ptr<DCPVideo> > frames;
+	frames.push_back (shared_ptr<DCPVideo> (new DCPVideo (pvf, 0, 24, 200000000, RESOLUTION_2K)));
+
+	EncodeServer* server = new EncodeServer (true, 2);
+	thread* server_thread = new thread (boost::bind (&EncodeServer::run, server));
+
+	/* Let the server get itself ready */
+	dcpomatic_sleep (1);
+
+	EncodeServerDescription description ("127.0.0.1", 2, SERVER_LINK_VERSION);
+	EncodeServerConnection connection (description, 1200);
+	map<int, Data> results;
+	BOOST_REQUIRE_NO_THROW (connection.encode (frames, boost::bind (&pipelined_frame_done, _1, _2, &results)));
+	BOOST_REQUIRE_EQUAL (results.size(), 1U);
+
+	/* The server's thread for our connection is now waiting for another batch, which will never come */
+	time_t const start = time (0);
+	server->stop ();
+	server_thread->join ();
+	delete server_thread;
+	delete server;
+	BOOST_CHECK (time (0) - start < 10);
+}
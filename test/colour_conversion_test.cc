@@ -25,6 +25,7 @@
 
 #include "lib/colour_conversion.h"
 #include "lib/film.h"
+#include "lib/binary_encoding_request.h"
 #include <dcp/gamma_transfer_function.h>
 #include <libxml++/libxml++.h>
 #include <boost/test/unit_test.hpp>
@@ -114,3 +115,20 @@ BOOST_AUTO_TEST_CASE (colour_conversion_test4)
 		BOOST_CHECK (ColourConversion::from_xml (in, Film::current_state_version).get () == i.conversion);
 	}
 }
+
+/** Test a round trip via a BinaryEncodingRequest */
+BOOST_AUTO_TEST_CASE (colour_conversion_test5)
+{
+	BOOST_FOREACH (PresetColourConversion const & i, PresetColourConversion::all ()) {
+		BinaryEncodingRequest out;
+		i.conversion.as_binary (out);
+		uint8_t buffer[BinaryEncodingRequest::length];
+		out.write (buffer);
+		BinaryEncodingRequest in;
+		in.read (buffer);
+		BOOST_CHECK (ColourConversion::from_binary (in).get () == i.conversion);
+		BOOST_CHECK_EQUAL (ColourConversion::from_binary (in).get().identifier (), i.conversion.identifier ());
+	}
+
+	BOOST_CHECK (!ColourConversion::from_binary (BinaryEncodingRequest ()));
+}
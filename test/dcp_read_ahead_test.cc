@@ -0,0 +1,98 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/dcp_read_ahead_test.cc
+ *  @brief Test DCPReadAhead.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/dcp_read_ahead.h"
+#include <dcp/dcp.h>
+#include <dcp/cpl.h>
+#include <dcp/reel.h>
+#include <dcp/reel_picture_asset.h>
+#include <dcp/reel_sound_asset.h>
+#include <dcp/mono_picture_asset.h>
+#include <dcp/sound_asset.h>
+#include <dcp/mono_picture_frame.h>
+#include <dcp/sound_frame.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <vector>
+
+using std::list;
+using std::vector;
+using boost::shared_ptr;
+using boost::dynamic_pointer_cast;
+
+/** Check that a frame from a DCPReadAhead is the same as one read directly from the MXFs */
+static void
+check (DCPReadAhead& read_ahead, vector<shared_ptr<dcp::Reel> > reels, int reel, int64_t frame)
+{
+	DCPReadAhead::Frame f = read_ahead.get (reel, frame);
+	BOOST_REQUIRE_EQUAL (f.reel, reel);
+	BOOST_REQUIRE_EQUAL (f.frame, frame);
+
+	shared_ptr<dcp::Reel> r = reels[reel];
+
+	shared_ptr<dcp::MonoPictureAsset> picture = dynamic_pointer_cast<dcp::MonoPictureAsset> (r->main_picture()->asset());
+	BOOST_REQUIRE (picture);
+	shared_ptr<const dcp::MonoPictureFrame> ref_picture = picture->start_read()->get_frame (r->main_picture()->entry_point() + frame);
+	BOOST_REQUIRE (f.mono);
+	BOOST_REQUIRE (!f.stereo);
+	BOOST_REQUIRE_EQUAL (f.mono->j2k_size(), ref_picture->j2k_size());
+	BOOST_CHECK_EQUAL (memcmp (f.mono->j2k_data(), ref_picture->j2k_data(), ref_picture->j2k_size()), 0);
+
+	BOOST_REQUIRE (r->main_sound ());
+	shared_ptr<const dcp::SoundFrame> ref_sound = r->main_sound()->asset()->start_read()->get_frame (r->main_sound()->entry_point() + frame);
+	BOOST_REQUIRE (f.sound);
+	BOOST_REQUIRE_EQUAL (f.sound->size(), ref_sound->size());
+	BOOST_CHECK_EQUAL (memcmp (f.sound->data(), ref_sound->data(), ref_sound->size()), 0);
+}
+
+/** Read a multi-reel DCP through a DCPReadAhead which has room for only a few frames,
+ *  going through it in order, seeking and then jumping around without seeking.
+ */
+BOOST_AUTO_TEST_CASE (dcp_read_ahead_test)
+{
+	dcp::DCP dcp ("test/data/reels_test4");
+	dcp.read ();
+	BOOST_REQUIRE_EQUAL (dcp.cpls().size(), 1U);
+	list<shared_ptr<dcp::Reel> > reels = dcp.cpls().front()->reels();
+	BOOST_REQUIRE_EQUAL (reels.size(), 4U);
+	vector<shared_ptr<dcp::Reel> > reels_vector (reels.begin(), reels.end());
+
+	DCPReadAhead read_ahead (reels, true, true, 256 * 1024);
+
+	for (int i = 0; i < 4; ++i) {
+		for (int64_t j = 0; j < reels_vector[i]->main_picture()->duration(); ++j) {
+			check (read_ahead, reels_vector, i, j);
+		}
+	}
+
+	read_ahead.seek (2, 5);
+	check (read_ahead, reels_vector, 2, 5);
+	check (read_ahead, reels_vector, 2, 6);
+
+	check (read_ahead, reels_vector, 0, 3);
+	check (read_ahead, reels_vector, 0, 4);
+	check (read_ahead, reels_vector, 3, 23);
+	check (read_ahead, reels_vector, 1, 0);
+}
@@ -0,0 +1,187 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/encode_scheduler_test.cc
+ *  @brief Test EncodeScheduler.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/encode_scheduler.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/foreach.hpp>
+#include <set>
+
+using std::list;
+using std::min;
+using std::set;
+using boost::shared_ptr;
+
+static shared_ptr<DCPVideo>
+frame (int index)
+{
+	return shared_ptr<DCPVideo> (new DCPVideo (shared_ptr<const PlayerVideo>(), index, 24, 100000000, RESOLUTION_2K));
+}
+
+/** Frames pushed with no workers are still handed out, and failed frames come back first */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test1)
+{
+	EncodeScheduler s;
+	s.push (frame (0));
+	s.push (frame (1));
+	BOOST_CHECK_EQUAL (s.size(), 2U);
+
+	int const w = s.add_worker (true);
+	list<shared_ptr<DCPVideo> > got = s.pop (w, 1);
+	BOOST_REQUIRE_EQUAL (got.size(), 1U);
+	BOOST_CHECK_EQUAL (got.front()->index(), 0);
+
+	s.push_front (got.front ());
+	s.push (frame (2));
+	got = s.pop (w, 8);
+	BOOST_REQUIRE_EQUAL (got.size(), 3U);
+	BOOST_CHECK_EQUAL (got.front()->index(), 0);
+	BOOST_CHECK_EQUAL (s.size(), 0U);
+}
+
+/** A remote worker, which is given nothing, can steal from local ones, and
+ *  removing a worker hands its frames to everybody else.
+ */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test2)
+{
+	EncodeScheduler s;
+	int const local_a = s.add_worker (true);
+	int const local_b = s.add_worker (true);
+	int const remote = s.add_worker (false);
+
+	for (int i = 0; i < 10; ++i) {
+		s.push (frame (i));
+	}
+
+	list<shared_ptr<DCPVideo> > got = s.pop (remote, 4);
+	BOOST_CHECK_EQUAL (got.size(), 4U);
+
+	s.remove_worker (local_a);
+	got = s.pop (local_b, 100);
+	BOOST_CHECK_EQUAL (got.size(), 6U);
+	BOOST_CHECK (s.take_all().empty());
+}
+
+/** Speculative frames only go to local workers, and only when they have nothing else to do */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test4)
+{
+	EncodeScheduler s;
+	int const local = s.add_worker (true);
+	int const remote = s.add_worker (false);
+
+	s.push_speculative (frame (0));
+	s.push (frame (1));
+	BOOST_CHECK_EQUAL (s.size(), 1U);
+
+	list<shared_ptr<DCPVideo> > got = s.pop (local, 4);
+	BOOST_REQUIRE_EQUAL (got.size(), 1U);
+	BOOST_CHECK_EQUAL (got.front()->index(), 1);
+
+	s.push (frame (2));
+	got = s.pop (remote, 4);
+	BOOST_REQUIRE_EQUAL (got.size(), 1U);
+	BOOST_CHECK_EQUAL (got.front()->index(), 2);
+
+	got = s.pop (local, 4);
+	BOOST_REQUIRE_EQUAL (got.size(), 1U);
+	BOOST_CHECK_EQUAL (got.front()->index(), 0);
+	BOOST_CHECK_EQUAL (s.size(), 0U);
+}
+
+static void
+consume (EncodeScheduler* s, bool local, int count, boost::mutex* mutex, set<int>* seen)
+{
+	int const w = s->add_worker (local);
+	for (int i = 0; i < count; ++i) {
+		BOOST_FOREACH (shared_ptr<DCPVideo> j, s->pop (w, 1)) {
+			boost::mutex::scoped_lock lm (*mutex);
+			seen->insert (j->index ());
+		}
+	}
+}
+
+/** Every frame is encoded exactly once when several threads are taking them */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test3)
+{
+	EncodeScheduler s;
+	boost::mutex mutex;
+	set<int> seen;
+
+	boost::thread_group threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.create_thread (boost::bind (&consume, &s, i % 2, 250, &mutex, &seen));
+	}
+
+	for (int i = 0; i < 1000; ++i) {
+		s.wait_until_below (16);
+		s.push (frame (i));
+	}
+
+	threads.join_all ();
+	BOOST_CHECK_EQUAL (seen.size(), 1000U);
+	BOOST_CHECK_EQUAL (s.size(), 0U);
+}
+
+static void
+consume_batches (EncodeScheduler* s, bool local, int count, int batch, boost::mutex* mutex, set<int>* seen)
+{
+	int const w = s->add_worker (local);
+	while (count > 0) {
+		list<shared_ptr<DCPVideo> > got = s->pop (w, min (batch, count));
+		count -= got.size ();
+		boost::mutex::scoped_lock lm (*mutex);
+		BOOST_FOREACH (shared_ptr<DCPVideo> j, got) {
+			seen->insert (j->index ());
+		}
+	}
+	s->remove_worker (w);
+}
+
+/** Every frame is encoded exactly once when remote workers are stealing batches
+ *  and workers are leaving while frames are still being pushed.
+ */
+BOOST_AUTO_TEST_CASE (encode_scheduler_test5)
+{
+	EncodeScheduler s;
+	boost::mutex mutex;
+	set<int> seen;
+
+	boost::thread_group threads;
+	threads.create_thread (boost::bind (&consume_batches, &s, true, 100, 1, &mutex, &seen));
+	threads.create_thread (boost::bind (&consume_batches, &s, true, 300, 1, &mutex, &seen));
+	threads.create_thread (boost::bind (&consume_batches, &s, false, 300, 4, &mutex, &seen));
+	threads.create_thread (boost::bind (&consume_batches, &s, false, 300, 3, &mutex, &seen));
+
+	for (int i = 0; i < 1000; ++i) {
+		s.wait_until_below (16);
+		s.push (frame (i));
+	}
+
+	threads.join_all ();
+	BOOST_CHECK_EQUAL (seen.size(), 1000U);
+	BOOST_CHECK_EQUAL (s.size(), 0U);
+}
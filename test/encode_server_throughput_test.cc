@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/encode_server_throughput_test.cc
+ *  @brief Test EncodeServerThroughput.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/encode_server_throughput.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+using std::map;
+using std::string;
+using std::vector;
+
+/** Servers are allowed all their frames until we know better, and unknown servers are not limited */
+BOOST_AUTO_TEST_CASE (encode_server_throughput_test1)
+{
+	EncodeServerThroughput t;
+	map<string, int> servers;
+	servers["a"] = 4;
+	t.set_servers (servers);
+
+	BOOST_CHECK_EQUAL (t.try_reserve ("a", 3), 3);
+	BOOST_CHECK_EQUAL (t.try_reserve ("a", 3), 1);
+	BOOST_CHECK_EQUAL (t.try_reserve ("a", 3), 0);
+	t.release ("a", 2);
+	BOOST_CHECK_EQUAL (t.reserve ("a", 3), 2);
+	t.frame_done ("a");
+	BOOST_CHECK_EQUAL (t.reserve ("a", 3), 1);
+
+	BOOST_CHECK_EQUAL (t.try_reserve ("b", 5), 5);
+	BOOST_CHECK (t.slow_servers().empty());
+}
+
+/** A server which takes ten times as long as the others is noticed, and limited */
+BOOST_AUTO_TEST_CASE (encode_server_throughput_test2)
+{
+	EncodeServerThroughput t (4);
+	map<string, int> servers;
+	servers[""] = 4;
+	servers["fast"] = 4;
+	servers["slow"] = 4;
+	t.set_servers (servers);
+
+	BOOST_CHECK_EQUAL (t.try_reserve ("", 4), 4);
+	BOOST_CHECK_EQUAL (t.try_reserve ("fast", 4), 4);
+	BOOST_CHECK_EQUAL (t.try_reserve ("slow", 4), 4);
+
+	for (int i = 1; i <= 45; ++i) {
+		boost::this_thread::sleep (boost::posix_time::milliseconds (10));
+		t.frame_done ("");
+		t.try_reserve ("", 1);
+		t.frame_done ("fast");
+		t.try_reserve ("fast", 1);
+		if ((i % 10) == 0) {
+			t.frame_done ("slow");
+			t.try_reserve ("slow", 1);
+		}
+	}
+
+	vector<string> slow = t.slow_servers ();
+	BOOST_REQUIRE_EQUAL (slow.size(), 1U);
+	BOOST_CHECK_EQUAL (slow.front(), "slow");
+
+	BOOST_CHECK_EQUAL (t.allowed (""), 4);
+	BOOST_CHECK_EQUAL (t.allowed ("fast"), 4);
+	BOOST_CHECK (t.allowed ("slow") < 4);
+	BOOST_CHECK_EQUAL (t.try_reserve ("slow", 4), 0);
+}
@@ -0,0 +1,100 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/frame_info_file_test.cc
+ *  @brief Test FrameInfoFile.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/frame_info_file.h"
+#include "lib/compose.hpp"
+#include <boost/test/unit_test.hpp>
+
+static dcp::FrameInfo
+info (int n)
+{
+	dcp::FrameInfo i;
+	i.offset = n * 1000000;
+	i.size = n * 1000 + 42;
+	i.hash = String::compose ("%1", n);
+	i.hash.resize (32, 'x');
+	return i;
+}
+
+static void
+check (FrameInfoFile& file, Frame frame, Eyes eyes, int n)
+{
+	dcp::FrameInfo const i = file.read (frame, eyes);
+	BOOST_CHECK_EQUAL (i.offset, info(n).offset);
+	BOOST_CHECK_EQUAL (i.size, info(n).size);
+	BOOST_CHECK_EQUAL (i.hash, info(n).hash);
+}
+
+/** Write some 2D and 3D information, reading it back from the same FrameInfoFile while it
+ *  is open and then from a new one, as a resumed encode would.
+ */
+BOOST_AUTO_TEST_CASE (frame_info_file_test)
+{
+	boost::filesystem::path const two_d = "build/test/frame_info_file_test_2d";
+	boost::filesystem::path const three_d = "build/test/frame_info_file_test_3d";
+	boost::filesystem::remove (two_d);
+	boost::filesystem::remove (three_d);
+
+	{
+		FrameInfoFile file (two_d);
+		BOOST_CHECK_EQUAL (file.entries(), 0);
+		for (int i = 0; i < 10; ++i) {
+			file.write (i, EYES_BOTH, info(i));
+			BOOST_CHECK_EQUAL (file.entries(), i + 1);
+		}
+		check (file, 4, EYES_BOTH, 4);
+		file.write (4, EYES_BOTH, info(99));
+		check (file, 4, EYES_BOTH, 99);
+		check (file, 5, EYES_BOTH, 5);
+		BOOST_CHECK_EQUAL (file.entries(), 10);
+	}
+
+	{
+		FrameInfoFile file (two_d);
+		BOOST_CHECK_EQUAL (file.entries(), 10);
+		check (file, 0, EYES_BOTH, 0);
+		check (file, 4, EYES_BOTH, 99);
+		check (file, 9, EYES_BOTH, 9);
+		file.write (10, EYES_BOTH, info(10));
+		BOOST_CHECK_EQUAL (file.entries(), 11);
+	}
+
+	{
+		FrameInfoFile file (three_d);
+		for (int i = 0; i < 5; ++i) {
+			file.write (i, EYES_LEFT, info(i * 2));
+			file.write (i, EYES_RIGHT, info(i * 2 + 1));
+		}
+		BOOST_CHECK_EQUAL (file.entries(), 10);
+	}
+
+	{
+		FrameInfoFile file (three_d);
+		for (int i = 0; i < 5; ++i) {
+			check (file, i, EYES_LEFT, i * 2);
+			check (file, i, EYES_RIGHT, i * 2 + 1);
+		}
+	}
+}
@@ -26,13 +26,29 @@
 
 #include "lib/image.h"
 #include "lib/ffmpeg_image_proxy.h"
+#include "lib/sws_context_cache.h"
+#include "lib/image_buffer_pool.h"
+#include "lib/fader.h"
+#include "lib/exceptions.h"
+#include "lib/dcpomatic_socket.h"
+#include "lib/film.h"
+#include "lib/ffmpeg_content.h"
+#include "lib/ffmpeg_decoder.h"
+#include "lib/video_decoder.h"
+#include "lib/content_video.h"
+#include "lib/image_proxy.h"
 #include "test.h"
+extern "C" {
+#include <libavutil/frame.h>
+}
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 
 using std::string;
 using std::list;
 using std::cout;
+using std::pair;
+using std::make_pair;
 using boost::shared_ptr;
 
 BOOST_AUTO_TEST_CASE (aligned_image_test)
@@ -267,6 +283,299 @@ BOOST_AUTO_TEST_CASE (crop_scale_window_test)
 	check_image("test/data/crop_scale_window_test.png", "build/test/crop_scale_window_test.png");
 }
 
+/** Test that scaling the same way twice re-uses a scaler context and gives the same result */
+BOOST_AUTO_TEST_CASE (crop_scale_window_context_cache_test)
+{
+	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/3d_test/000001.png"));
+	shared_ptr<Image> raw = proxy->image().first;
+
+	uint64_t const hits = SwsContextCache::hits ();
+	uint64_t const misses = SwsContextCache::misses ();
+
+	shared_ptr<Image> a = raw->crop_scale_window(Crop(), dcp::Size(1023, 541), dcp::Size(1024, 541), dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, false, false);
+	shared_ptr<Image> b = raw->crop_scale_window(Crop(), dcp::Size(1023, 541), dcp::Size(1024, 541), dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, false, false);
+
+	BOOST_CHECK_EQUAL (SwsContextCache::misses(), misses + 1);
+	BOOST_CHECK_EQUAL (SwsContextCache::hits(), hits + 1);
+
+	for (int y = 0; y < a->size().height; ++y) {
+		BOOST_REQUIRE_EQUAL (memcmp (a->data()[0] + y * a->stride()[0], b->data()[0] + y * b->stride()[0], a->line_size()[0]), 0);
+	}
+}
+
+/** Test that crop_scale_window gives the same result when it splits the image into bands, at least
+ *  when there is no vertical scaling.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_parallel_test)
+{
+	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/3d_test/000001.png"));
+	shared_ptr<Image> raw = proxy->image().first;
+
+	Crop crop (6, 8, 4, 2);
+	dcp::Size const inter (raw->size().width - 40, raw->size().height - 6);
+	dcp::Size const out (raw->size().width, raw->size().height);
+
+	shared_ptr<Image> a = raw->crop_scale_window(crop, inter, out, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, false, false);
+	shared_ptr<Image> b = raw->crop_scale_window(crop, inter, out, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB48LE, true, false, true);
+
+	for (int y = 0; y < a->size().height; ++y) {
+		BOOST_REQUIRE_EQUAL (memcmp (a->data()[0] + y * a->stride()[0], b->data()[0] + y * b->stride()[0], a->line_size()[0]), 0);
+	}
+}
+
+/** Test that the memory of an image is re-used by the next image of the same size */
+BOOST_AUTO_TEST_CASE (image_buffer_pool_test)
+{
+	ImageBufferPool* pool = ImageBufferPool::instance ();
+	pool->clear ();
+
+	shared_ptr<Image> a (new Image (AV_PIX_FMT_YUV420P, dcp::Size (1998, 1080), true));
+	uint8_t* const a_data = a->data()[0];
+	a.reset ();
+
+	BOOST_CHECK (Image::pooled_memory() > 1998 * 1080);
+
+	uint64_t const hits = pool->hits ();
+	shared_ptr<Image> b (new Image (AV_PIX_FMT_YUV420P, dcp::Size (1998, 1080), true));
+	BOOST_CHECK_EQUAL (pool->hits(), hits + 3);
+	BOOST_CHECK (b->data()[0] == a_data);
+	BOOST_CHECK_EQUAL (Image::pooled_memory(), 0U);
+}
+
+/** Test that an Image made from an AVFrame shares the frame's data until it is changed */
+BOOST_AUTO_TEST_CASE (image_from_frame_test)
+{
+	AVFrame* frame = av_frame_alloc ();
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = 640;
+	frame->height = 480;
+	BOOST_REQUIRE (av_frame_get_buffer (frame, 32) >= 0);
+	for (int i = 0; i < 3; ++i) {
+		memset (frame->data[i], 42, frame->linesize[i] * (i ? 240 : 480));
+	}
+
+	shared_ptr<Image> image (new Image (frame));
+	shared_ptr<const Image> const_image = image;
+	for (int i = 0; i < 3; ++i) {
+		BOOST_CHECK (const_image->data()[i] == frame->data[i]);
+		BOOST_CHECK_EQUAL (image->stride()[i], frame->linesize[i]);
+	}
+
+	/* Nobody may write to the frame's data through the image */
+	BOOST_CHECK_THROW (image->data(), ProgrammingError);
+
+	/* Changing the image must copy it, leaving the frame alone */
+	shared_ptr<Image> copy (new Image (*image.get()));
+	shared_ptr<Image> other (new Image (frame));
+	image->make_black ();
+	BOOST_CHECK (image->data()[0] != frame->data[0]);
+	BOOST_CHECK_EQUAL (frame->data[0][0], 42);
+	BOOST_CHECK (*other.get() == *copy.get());
+	BOOST_CHECK (!(*image.get() == *copy.get()));
+
+	/* The image's reference must keep the data alive after the frame has gone */
+	av_frame_free (&frame);
+	BOOST_CHECK (*other.get() == *copy.get());
+}
+
+/** Test that an Image made from an AVFrame whose buffer has no room after the last line copies the data */
+BOOST_AUTO_TEST_CASE (image_from_small_frame_test)
+{
+	AVFrame* frame = av_frame_alloc ();
+	frame->format = AV_PIX_FMT_RGB24;
+	frame->width = 640;
+	frame->height = 480;
+	frame->linesize[0] = 640 * 3;
+	frame->buf[0] = av_buffer_alloc (frame->linesize[0] * frame->height);
+	BOOST_REQUIRE (frame->buf[0]);
+	frame->data[0] = frame->buf[0]->data;
+	memset (frame->data[0], 42, frame->buf[0]->size);
+
+	shared_ptr<Image> image (new Image (frame));
+	BOOST_CHECK (image->data()[0] != frame->data[0]);
+	BOOST_CHECK_EQUAL (image->data()[0][0], 42);
+	BOOST_CHECK_EQUAL (image->data()[0][(frame->height - 1) * image->stride()[0] + frame->linesize[0] - 1], 42);
+
+	av_frame_free (&frame);
+}
+
+static void
+store_decoded (list<pair<shared_ptr<Image>, shared_ptr<Image> > >* decoded, ContentVideo video)
+{
+	shared_ptr<Image> image = video.image->image().first;
+	/* Keep the image along with a copy of what it looked like when it was decoded */
+	decoded->push_back (make_pair (image, shared_ptr<Image> (new Image (*image.get()))));
+}
+
+/** Test that Images made from frames which come out of FFmpegDecoder share the decoder's data,
+ *  and that the data is left alone while the decoder carries on decoding.
+ */
+BOOST_AUTO_TEST_CASE (image_from_decoded_frame_test)
+{
+	shared_ptr<Film> film = new_test_film2 ("image_from_decoded_frame_test");
+	shared_ptr<FFmpegContent> content (new FFmpegContent ("test/data/test.mp4"));
+	film->examine_and_add_content (content);
+	BOOST_REQUIRE (!wait_for_jobs ());
+
+	list<pair<shared_ptr<Image>, shared_ptr<Image> > > decoded;
+	shared_ptr<FFmpegDecoder> decoder (new FFmpegDecoder (film, content, false));
+	decoder->video->Data.connect (bind (&store_decoded, &decoded, _1));
+	while (decoded.size() < 24 && !decoder->pass ()) {}
+	BOOST_REQUIRE_EQUAL (decoded.size(), 24U);
+
+	for (list<pair<shared_ptr<Image>, shared_ptr<Image> > >::const_iterator i = decoded.begin(); i != decoded.end(); ++i) {
+		/* Sharing, so nobody may write to it */
+		BOOST_CHECK_THROW (i->first->data(), ProgrammingError);
+		BOOST_CHECK (*i->first.get() == *i->second.get());
+	}
+
+	decoder.reset ();
+	BOOST_CHECK (*decoded.front().first.get() == *decoded.front().second.get());
+}
+
+/** Test that each Fader kernel gives the same results as the scalar one */
+BOOST_AUTO_TEST_CASE (fader_test)
+{
+	float const fades[] = { 0, 0.25, 0.5, 0.9999, 1, 1.5 };
+	srand (1);
+
+	for (size_t i = 0; i < sizeof (fades) / sizeof (fades[0]); ++i) {
+		/* Use a length which is not a multiple of the SIMD kernels' step so that the ends are tested */
+		int const N = 1021;
+		uint8_t a8[N];
+		uint16_t a16[N];
+		for (int j = 0; j < N; ++j) {
+			a8[j] = rand ();
+			a16[j] = rand ();
+		}
+
+		uint8_t b8[N];
+		uint8_t c8[N];
+		memcpy (b8, a8, N);
+		memcpy (c8, a8, N);
+		Fader::fade_8 (b8, N, fades[i], Fader::KERNEL_SCALAR);
+		Fader::fade_8 (c8, N, fades[i]);
+		BOOST_CHECK_EQUAL (memcmp (b8, c8, N), 0);
+
+		for (int big_endian = 0; big_endian < 2; ++big_endian) {
+			uint16_t b16[N];
+			uint16_t c16[N];
+			memcpy (b16, a16, N * 2);
+			memcpy (c16, a16, N * 2);
+			Fader::fade_16 (b16, N, fades[i], big_endian, Fader::KERNEL_SCALAR);
+			Fader::fade_16 (c16, N, fades[i], big_endian);
+			BOOST_CHECK_EQUAL (memcmp (b16, c16, N * 2), 0);
+		}
+	}
+}
+
+/** Test that fading part of an image fades that part in the same way as fading the whole image,
+ *  and leaves the rest alone.
+ */
+BOOST_AUTO_TEST_CASE (fade_area_test)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB48LE, dcp::Size (317, 200), true));
+	srand (1);
+	for (int y = 0; y < image->size().height; ++y) {
+		uint8_t* p = image->data()[0] + y * image->stride()[0];
+		for (int x = 0; x < image->line_size()[0]; ++x) {
+			*p++ = rand ();
+		}
+	}
+
+	shared_ptr<Image> whole (new Image (*image.get()));
+	whole->fade (0.3);
+	shared_ptr<Image> part (new Image (*image.get()));
+	dcpomatic::Rect<int> const area (21, 40, 250, 100);
+	part->fade (0.3, area);
+
+	for (int y = 0; y < image->size().height; ++y) {
+		for (int x = 0; x < image->size().width; ++x) {
+			bool const inside = x >= area.x && x < (area.x + area.width) && y >= area.y && y < (area.y + area.height);
+			int const offset = y * image->stride()[0] + x * 6;
+			shared_ptr<Image> check = inside ? whole : image;
+			BOOST_REQUIRE_EQUAL (memcmp (part->data()[0] + offset, check->data()[0] + offset, 6), 0);
+		}
+	}
+}
+
+/** Test that crop_scale_window makes the padding above and below a letterboxed image black,
+ *  even if it is given memory which was not.
+ */
+BOOST_AUTO_TEST_CASE (crop_scale_window_letterbox_test)
+{
+	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/3d_test/000001.png"));
+	shared_ptr<Image> raw = proxy->image().first;
+
+	dcp::Size const out (raw->size().width, raw->size().height + 100);
+	dcp::Size const inter (raw->size().width, raw->size().height - 40);
+
+	{
+		/* Leave some memory in the pool for the output image to use */
+		shared_ptr<Image> dirty (new Image (AV_PIX_FMT_RGB24, out, true, (out.width - inter.width) / 2));
+		memset (dirty->data()[0], 0xff, dirty->stride()[0] * out.height);
+	}
+
+	shared_ptr<Image> scaled = raw->crop_scale_window (Crop (), inter, out, dcp::YUV_TO_RGB_REC709, AV_PIX_FMT_RGB24, true, false);
+	int const top = (out.height - inter.height) / 2;
+	for (int y = 0; y < out.height; ++y) {
+		if (y >= top && y < (top + inter.height)) {
+			continue;
+		}
+		uint8_t* p = scaled->data()[0] + y * scaled->stride()[0];
+		for (int x = 0; x < scaled->line_size()[0]; ++x) {
+			BOOST_REQUIRE_EQUAL (p[x], 0);
+		}
+	}
+}
+
+/** @return Two Sockets which are connected to each other over the loopback interface */
+static pair<shared_ptr<Socket>, shared_ptr<Socket> >
+connected_sockets ()
+{
+	boost::asio::io_service io_service;
+	boost::asio::ip::tcp::acceptor acceptor (io_service, boost::asio::ip::tcp::endpoint (boost::asio::ip::address_v4::loopback(), 0));
+	shared_ptr<Socket> a (new Socket);
+	shared_ptr<Socket> b (new Socket);
+	a->connect (acceptor.local_endpoint ());
+	acceptor.accept (b->socket ());
+	return make_pair (a, b);
+}
+
+/** Test that an image survives write_compressed_to_socket() and read_compressed_from_socket() */
+BOOST_AUTO_TEST_CASE (compressed_socket_test)
+{
+	shared_ptr<Image> in (new Image (AV_PIX_FMT_YUV420P, dcp::Size (64, 48), true));
+	for (int i = 0; i < in->planes(); ++i) {
+		for (int y = 0; y < in->sample_size(i).height; ++y) {
+			uint8_t* p = in->data()[i] + y * in->stride()[i];
+			for (int x = 0; x < in->line_size()[i]; ++x) {
+				*p++ = (x * 7 + y * 3 + i * 50) & 0xff;
+			}
+		}
+	}
+
+	pair<shared_ptr<Socket>, shared_ptr<Socket> > sockets = connected_sockets ();
+	in->write_compressed_to_socket (sockets.first);
+
+	shared_ptr<Image> out (new Image (AV_PIX_FMT_YUV420P, dcp::Size (64, 48), true));
+	out->read_compressed_from_socket (sockets.second);
+	BOOST_CHECK (*in.get() == *out.get());
+}
+
+/** Test that read_compressed_from_socket() refuses a length which could not have come from write_compressed_to_socket() */
+BOOST_AUTO_TEST_CASE (compressed_socket_bad_length_test)
+{
+	shared_ptr<Image> out (new Image (AV_PIX_FMT_YUV420P, dcp::Size (64, 48), true));
+
+	pair<shared_ptr<Socket>, shared_ptr<Socket> > sockets = connected_sockets ();
+	sockets.first->write (0xffffffff);
+	BOOST_CHECK_THROW (out->read_compressed_from_socket (sockets.second), NetworkError);
+
+	sockets.first->write (1000000);
+	BOOST_CHECK_THROW (out->read_compressed_from_socket (sockets.second), NetworkError);
+}
+
 BOOST_AUTO_TEST_CASE (as_png_test)
 {
 	shared_ptr<FFmpegImageProxy> proxy(new FFmpegImageProxy("test/data/3d_test/000001.png"));
@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/in_flight_frames_test.cc
+ *  @brief Test InFlightFrames, along with the EncodeScheduler that J2KEncoder gives late frames to.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/in_flight_frames.h"
+#include "lib/encode_scheduler.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+using std::list;
+using std::pair;
+using std::string;
+using boost::shared_ptr;
+
+static shared_ptr<DCPVideo>
+frame (int index)
+{
+	return shared_ptr<DCPVideo> (new DCPVideo (shared_ptr<const PlayerVideo>(), index, 24, 100000000, RESOLUTION_2K));
+}
+
+/** Do what J2KEncoder::wait_for_stragglers() does with late frames */
+static void
+duplicate_late (InFlightFrames& in_flight, EncodeScheduler& scheduler, double now)
+{
+	typedef pair<shared_ptr<DCPVideo>, string> Late;
+	BOOST_FOREACH (Late i, in_flight.duplicate_late (now)) {
+		scheduler.push_speculative (i.first);
+	}
+}
+
+/** A frame which fails on a server and has no local copy is put back */
+BOOST_AUTO_TEST_CASE (in_flight_frames_test1)
+{
+	InFlightFrames in_flight;
+	shared_ptr<DCPVideo> f = frame (0);
+
+	in_flight.start (f, "server", 10);
+	BOOST_CHECK (in_flight.contains (f));
+	BOOST_CHECK (in_flight.duplicate_late(5).empty ());
+	BOOST_CHECK (in_flight.fail (f));
+	BOOST_CHECK (!in_flight.contains (f));
+	BOOST_CHECK (in_flight.empty ());
+
+	/* If it then comes back from the server after all it must not be written */
+	BOOST_CHECK (!in_flight.finish (f));
+}
+
+/** A late frame whose local copy finishes first, after which the server fails, is written once and not put back */
+BOOST_AUTO_TEST_CASE (in_flight_frames_test2)
+{
+	InFlightFrames in_flight;
+	EncodeScheduler scheduler;
+	int const local = scheduler.add_worker (true);
+	shared_ptr<DCPVideo> f = frame (0);
+
+	in_flight.start (f, "server", 10);
+	duplicate_late (in_flight, scheduler, 11);
+	/* It is only duplicated once */
+	BOOST_CHECK (in_flight.duplicate_late(12).empty ());
+
+	list<shared_ptr<DCPVideo> > got = scheduler.pop (local, 1);
+	BOOST_REQUIRE_EQUAL (got.size(), 1U);
+	BOOST_REQUIRE (got.front() == f);
+	BOOST_CHECK (in_flight.take_duplicate (f));
+	BOOST_CHECK (in_flight.contains (f));
+
+	/* Local copy wins */
+	BOOST_CHECK (in_flight.finish (f));
+	/* Server fails afterwards */
+	BOOST_CHECK (!in_flight.fail (f));
+	BOOST_CHECK (in_flight.empty ());
+	BOOST_CHECK_EQUAL (scheduler.size(), 0U);
+}
+
+/** A late frame whose server fails while the local copy is being encoded is left to the local copy */
+BOOST_AUTO_TEST_CASE (in_flight_frames_test3)
+{
+	InFlightFrames in_flight;
+	EncodeScheduler scheduler;
+	int const local = scheduler.add_worker (true);
+	shared_ptr<DCPVideo> f = frame (0);
+
+	in_flight.start (f, "server", 10);
+	duplicate_late (in_flight, scheduler, 11);
+	BOOST_REQUIRE_EQUAL (scheduler.pop(local, 1).size(), 1U);
+	BOOST_CHECK (in_flight.take_duplicate (f));
+
+	BOOST_CHECK (!in_flight.fail (f));
+	BOOST_CHECK (in_flight.finish (f));
+	BOOST_CHECK (in_flight.empty ());
+}
+
+/** A late frame which comes back from the server first is not encoded by the local thread */
+BOOST_AUTO_TEST_CASE (in_flight_frames_test4)
+{
+	InFlightFrames in_flight;
+	EncodeScheduler scheduler;
+	int const local = scheduler.add_worker (true);
+	shared_ptr<DCPVideo> f = frame (0);
+
+	in_flight.start (f, "server", 10);
+	duplicate_late (in_flight, scheduler, 11);
+	BOOST_CHECK (in_flight.finish (f));
+
+	BOOST_REQUIRE_EQUAL (scheduler.pop(local, 1).size(), 1U);
+	BOOST_CHECK (in_flight.take_duplicate (f));
+	BOOST_CHECK (!in_flight.contains (f));
+	BOOST_CHECK (!in_flight.finish (f));
+}
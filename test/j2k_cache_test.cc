@@ -0,0 +1,101 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/j2k_cache_test.cc
+ *  @brief Test J2KCache.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/j2k_cache.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <cstring>
+
+using std::string;
+using boost::optional;
+using dcp::Data;
+
+static Data
+frame (int value)
+{
+	Data d (1000);
+	memset (d.data().get(), value, d.size());
+	return d;
+}
+
+static bool
+same (Data a, Data b)
+{
+	return a.size() == b.size() && memcmp (a.data().get(), b.data().get(), a.size()) == 0;
+}
+
+/** Wait for the cache's eviction thread to find that the cache is a given size */
+static void
+wait_for_size (J2KCache& cache, uint64_t size)
+{
+	for (int i = 0; i < 100 && cache.size() != size; ++i) {
+		boost::this_thread::sleep (boost::posix_time::milliseconds (100));
+	}
+}
+
+/** Frames come back as they went in, and the least recently used are deleted when the cache is full */
+BOOST_AUTO_TEST_CASE (j2k_cache_test)
+{
+	boost::filesystem::path const dir = "build/test/j2k_cache_test";
+	boost::filesystem::remove_all (dir);
+
+	string const a = "0123456789abcdef0123456789abcdef";
+	string const b = "1123456789abcdef0123456789abcdef";
+	string const c = "2123456789abcdef0123456789abcdef";
+
+	J2KCache cache (dir, 2500);
+	BOOST_CHECK (!cache.get (a));
+	/* Let the cache look at its (empty) directory before we put anything in it */
+	boost::this_thread::sleep (boost::posix_time::milliseconds (200));
+
+	cache.put (a, frame (1));
+	/* Putting the same frame again does not make the cache any bigger */
+	cache.put (a, frame (1));
+	BOOST_CHECK_EQUAL (cache.size(), 1000U);
+	/* Modification times only have a resolution of a second */
+	boost::this_thread::sleep (boost::posix_time::milliseconds (1100));
+	cache.put (b, frame (2));
+	boost::this_thread::sleep (boost::posix_time::milliseconds (1100));
+
+	optional<Data> got = cache.get (a);
+	BOOST_REQUIRE (got);
+	BOOST_CHECK (same (*got, frame (1)));
+
+	/* That takes us over the limit, and b is the oldest now */
+	cache.put (c, frame (3));
+	wait_for_size (cache, 2000);
+	BOOST_CHECK_EQUAL (cache.size(), 2000U);
+	BOOST_CHECK (cache.get (a));
+	BOOST_CHECK (!cache.get (b));
+	got = cache.get (c);
+	BOOST_REQUIRE (got);
+	BOOST_CHECK (same (*got, frame (3)));
+
+	/* Another cache using the same directory sees the same frames */
+	J2KCache other (dir, 2500);
+	wait_for_size (other, 2000);
+	BOOST_CHECK_EQUAL (other.size(), 2000U);
+	BOOST_CHECK (other.get (a));
+}
@@ -0,0 +1,129 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/recent_frames_test.cc
+ *  @brief Test RecentFrames.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/recent_frames.h"
+#include "lib/dcp_video.h"
+#include "lib/player_video.h"
+#include "lib/raw_image_proxy.h"
+#include "lib/image.h"
+#include <boost/test/unit_test.hpp>
+
+using std::list;
+using boost::shared_ptr;
+using boost::optional;
+using boost::weak_ptr;
+using dcp::Data;
+
+static shared_ptr<DCPVideo>
+frame (int index)
+{
+	shared_ptr<Image> image (new Image (AV_PIX_FMT_RGB24, dcp::Size (64, 64), true));
+	image->make_black ();
+
+	shared_ptr<PlayerVideo> pv (
+		new PlayerVideo (
+			shared_ptr<ImageProxy> (new RawImageProxy (image)),
+			Crop (),
+			optional<double> (),
+			dcp::Size (64, 64),
+			dcp::Size (64, 64),
+			EYES_BOTH,
+			PART_WHOLE,
+			optional<ColourConversion> (),
+			weak_ptr<Content> (),
+			optional<Frame> ()
+			)
+		);
+
+	return shared_ptr<DCPVideo> (new DCPVideo (pv, index, 24, 200000000, RESOLUTION_2K));
+}
+
+/** Frames which arrive while an identical one is being encoded wait for it, and later ones are found */
+BOOST_AUTO_TEST_CASE (recent_frames_test1)
+{
+	RecentFrames recent (1000);
+
+	shared_ptr<DCPVideo> a = frame (0);
+	shared_ptr<DCPVideo> b = frame (1);
+	shared_ptr<DCPVideo> c = frame (2);
+	shared_ptr<DCPVideo> d = frame (3);
+
+	Data data;
+	BOOST_CHECK_EQUAL (recent.get ("x", a, data), RecentFrames::ENCODE);
+	/* a again, as if it had failed and been put back on the queue */
+	BOOST_CHECK_EQUAL (recent.get ("x", a, data), RecentFrames::ENCODE);
+	BOOST_CHECK_EQUAL (recent.get ("x", b, data), RecentFrames::WAIT);
+	BOOST_CHECK_EQUAL (recent.get ("x", c, data), RecentFrames::WAIT);
+
+	list<shared_ptr<DCPVideo> > waiting = recent.put ("x", Data (100));
+	BOOST_REQUIRE_EQUAL (waiting.size(), 2U);
+	BOOST_CHECK (waiting.front() == b);
+	BOOST_CHECK (waiting.back() == c);
+
+	BOOST_CHECK_EQUAL (recent.get ("x", d, data), RecentFrames::FOUND);
+	BOOST_CHECK_EQUAL (data.size(), 100);
+	BOOST_CHECK (recent.put("x", Data (100)).empty());
+	BOOST_CHECK_EQUAL (recent.size(), 100U);
+}
+
+/** The least recently used frames are forgotten when we go over the maximum size */
+BOOST_AUTO_TEST_CASE (recent_frames_test2)
+{
+	RecentFrames recent (1000);
+	shared_ptr<DCPVideo> f = frame (0);
+	Data data;
+
+	recent.put ("a", Data (400));
+	recent.put ("b", Data (400));
+	BOOST_CHECK_EQUAL (recent.get ("a", f, data), RecentFrames::FOUND);
+	recent.put ("c", Data (400));
+	BOOST_CHECK_EQUAL (recent.size(), 800U);
+
+	BOOST_CHECK_EQUAL (recent.get ("a", f, data), RecentFrames::FOUND);
+	BOOST_CHECK_EQUAL (recent.get ("c", f, data), RecentFrames::FOUND);
+	BOOST_CHECK_EQUAL (recent.get ("b", f, data), RecentFrames::ENCODE);
+
+	/* Things that are too big are never kept */
+	recent.put ("d", Data (2000));
+	BOOST_CHECK_EQUAL (recent.get ("d", f, data), RecentFrames::ENCODE);
+	BOOST_CHECK_EQUAL (recent.size(), 800U);
+}
+
+/** Frames which are still waiting at the end can be taken */
+BOOST_AUTO_TEST_CASE (recent_frames_test3)
+{
+	RecentFrames recent (1000);
+	shared_ptr<DCPVideo> a = frame (0);
+	shared_ptr<DCPVideo> b = frame (1);
+	Data data;
+
+	BOOST_CHECK_EQUAL (recent.get ("x", a, data), RecentFrames::ENCODE);
+	BOOST_CHECK_EQUAL (recent.get ("x", b, data), RecentFrames::WAIT);
+
+	list<shared_ptr<DCPVideo> > waiting = recent.take_waiting ();
+	BOOST_REQUIRE_EQUAL (waiting.size(), 1U);
+	BOOST_CHECK (waiting.front() == b);
+	BOOST_CHECK (recent.put("x", Data (100)).empty());
+}
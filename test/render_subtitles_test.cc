@@ -24,6 +24,8 @@
  */
 
 #include "lib/render_text.h"
+#include "lib/rendered_text_cache.h"
+#include "lib/image.h"
 #include <dcp/subtitle_string.h>
 #include <boost/test/unit_test.hpp>
 
@@ -109,3 +111,38 @@ BOOST_AUTO_TEST_CASE (render_markup_test6)
 	add (s, "we are bold.", false, true, false);
 	BOOST_CHECK_EQUAL (marked_up (s, 1024, 1), "<span style=\"italic\" size=\"41472\" alpha=\"65535\" color=\"#FFFFFF\">Hello</span><span size=\"41472\" alpha=\"65535\" color=\"#FFFFFF\"> world </span><span weight=\"bold\" size=\"41472\" alpha=\"65535\" color=\"#FFFFFF\">we are bold.</span>");
 }
+
+/** Test that render_text() re-uses what it rendered last time for the same text, and only for the same text */
+BOOST_AUTO_TEST_CASE (render_text_cache_test)
+{
+	RenderedTextCache* cache = RenderedTextCache::instance ();
+	cache->clear ();
+
+	std::list<StringText> s;
+	add (s, "Hello", false, false, false);
+	std::list<PositionImage> a = render_text (s, std::list<boost::shared_ptr<Font> >(), dcp::Size(1998, 1080), DCPTime(), 24);
+	BOOST_REQUIRE_EQUAL (a.size(), 1U);
+
+	uint64_t const hits = cache->hits ();
+	std::list<PositionImage> b = render_text (s, std::list<boost::shared_ptr<Font> >(), dcp::Size(1998, 1080), DCPTime(), 24);
+	BOOST_REQUIRE_EQUAL (b.size(), 1U);
+	BOOST_CHECK_EQUAL (cache->hits(), hits + 1);
+	BOOST_CHECK (a.front().image == b.front().image);
+	BOOST_CHECK (a.front().position == b.front().position);
+
+	std::list<StringText> t;
+	add (t, "Hello", false, true, false);
+	std::list<PositionImage> c = render_text (t, std::list<boost::shared_ptr<Font> >(), dcp::Size(1998, 1080), DCPTime(), 24);
+	BOOST_REQUIRE_EQUAL (c.size(), 1U);
+	BOOST_CHECK_EQUAL (cache->hits(), hits + 1);
+	BOOST_CHECK (a.front().image != c.front().image);
+
+	std::list<PositionImage> d = render_text (s, std::list<boost::shared_ptr<Font> >(), dcp::Size(1920, 1080), DCPTime(), 24);
+	BOOST_REQUIRE_EQUAL (d.size(), 1U);
+	BOOST_CHECK_EQUAL (cache->hits(), hits + 1);
+	BOOST_CHECK (a.front().image != d.front().image);
+
+	BOOST_CHECK (cache->held() > 0);
+	cache->clear ();
+	BOOST_CHECK_EQUAL (cache->held(), 0U);
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/spill_file_test.cc
+ *  @brief Test SpillFile.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/spill_file.h"
+#include <dcp/data.h>
+#include <boost/test/unit_test.hpp>
+
+using dcp::Data;
+
+/** @return Some data for a frame whose size and contents depend on the frame */
+static Data
+frame_data (Frame frame, Eyes eyes)
+{
+	Data d (1000 + frame * 37 + eyes);
+	for (int i = 0; i < d.size(); ++i) {
+		d.data()[i] = frame * 7 + eyes * 3 + i;
+	}
+	return d;
+}
+
+static void
+check (SpillFile& spill, Frame frame, Eyes eyes)
+{
+	Data const ref = frame_data (frame, eyes);
+	Data const d = spill.get (frame, eyes);
+	BOOST_REQUIRE_EQUAL (d.size(), ref.size());
+	BOOST_CHECK_EQUAL (memcmp (d.data().get(), ref.data().get(), ref.size()), 0);
+}
+
+/** Put frames into a SpillFile and get them back, some straight away (so that they will
+ *  probably still be in memory) and some after lots of others have been put in.
+ */
+BOOST_AUTO_TEST_CASE (spill_file_test)
+{
+	boost::filesystem::path const path = "build/test/spill_file_test.spill";
+
+	{
+		SpillFile spill (path, 4);
+
+		for (Frame i = 0; i < 100; ++i) {
+			spill.put (i, EYES_LEFT, frame_data (i, EYES_LEFT));
+			spill.put (i, EYES_RIGHT, frame_data (i, EYES_RIGHT));
+			if ((i % 10) == 0) {
+				check (spill, i, EYES_RIGHT);
+			}
+		}
+
+		for (Frame i = 99; i >= 0; --i) {
+			check (spill, i, EYES_LEFT);
+			if ((i % 10) != 0) {
+				check (spill, i, EYES_RIGHT);
+			}
+		}
+
+		/* Everything has been taken out so the file should have been emptied */
+		BOOST_CHECK_EQUAL (boost::filesystem::file_size (path), 0U);
+
+		spill.put (4, EYES_BOTH, frame_data (4, EYES_BOTH));
+		check (spill, 4, EYES_BOTH);
+	}
+
+	BOOST_CHECK (!boost::filesystem::exists (path));
+}
@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2019 Carl Hetherington <cth@carlh.net>
+
+    This file is part of DCP-o-matic.
+
+    DCP-o-matic is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DCP-o-matic is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DCP-o-matic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/** @file  test/xyz_converter_test.cc
+ *  @brief Test XYZConverter.
+ *  @ingroup selfcontained
+ */
+
+#include "lib/xyz_converter.h"
+#include "lib/colour_conversion.h"
+#include "lib/image.h"
+#include <dcp/openjpeg_image.h>
+#include <dcp/rgb_xyz.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/bind.hpp>
+#include <cstdlib>
+
+using boost::shared_ptr;
+
+static void
+note (dcp::NoteType, std::string, int* count)
+{
+	++(*count);
+}
+
+/** Check that every kernel gives exactly the same output as libdcp for each of the preset conversions,
+ *  using a width which is not a multiple of the SIMD kernels' step so that the ends of rows are tested.
+ */
+BOOST_AUTO_TEST_CASE (xyz_converter_test)
+{
+	dcp::Size const size (1023, 64);
+	shared_ptr<Image> rgb (new Image (AV_PIX_FMT_RGB48LE, size, false));
+	srand (1);
+	for (int y = 0; y < size.height; ++y) {
+		uint16_t* p = reinterpret_cast<uint16_t*> (rgb->data()[0] + y * rgb->stride()[0]);
+		for (int x = 0; x < size.width * 3; ++x) {
+			*p++ = rand () & 0xffff;
+		}
+	}
+
+	XYZConverter::Kernel const kernels[] = { XYZConverter::KERNEL_SCALAR, XYZConverter::KERNEL_SSE2, XYZConverter::KERNEL_AVX2 };
+
+	BOOST_FOREACH (PresetColourConversion i, PresetColourConversion::all ()) {
+		int ref_notes = 0;
+		shared_ptr<dcp::OpenJPEGImage> ref = dcp::rgb_to_xyz (
+			rgb->data()[0], size, rgb->stride()[0], i.conversion, boost::bind (&note, _1, _2, &ref_notes)
+			);
+
+		for (size_t j = 0; j < sizeof (kernels) / sizeof (kernels[0]); ++j) {
+			if (!XYZConverter::supported (kernels[j])) {
+				continue;
+			}
+
+			int notes = 0;
+			shared_ptr<dcp::OpenJPEGImage> xyz = XYZConverter::get(i.conversion)->convert (
+				rgb->data()[0], size, rgb->stride()[0], boost::bind (&note, _1, _2, &notes), kernels[j]
+				);
+
+			BOOST_CHECK_EQUAL (notes, ref_notes);
+			for (int c = 0; c < 3; ++c) {
+				BOOST_CHECK_EQUAL (memcmp (xyz->data(c), ref->data(c), size.width * size.height * sizeof (int)), 0);
+			}
+		}
+	}
+}